@@ -0,0 +1,39 @@
+/*
+ * Benchmark for the lookup of values along deep paths of the Tracer-X tree.
+ *
+ * Every iteration branches on a symbolic input, so each path is DEPTH tree
+ * nodes deep, while the straight-line code of an iteration keeps using the
+ * values computed before the loop. Run, e.g., with
+ *
+ *   clang -emit-llvm -c -g deep_path.c -I../../include
+ *   time klee deep_path.bc
+ *
+ * and compare the TxTree method execution times in klee-last/info for
+ * increasing DEPTH (-DDEPTH=...).
+ */
+
+#include <klee/klee.h>
+
+#ifndef DEPTH
+#define DEPTH 200
+#endif
+
+int main() {
+  int input[DEPTH];
+  int x, y;
+  int i, sum = 0;
+
+  klee_make_symbolic(input, sizeof(input), "input");
+  klee_make_symbolic(&x, sizeof(x), "x");
+  y = x * 3 + 1;
+
+  for (i = 0; i < DEPTH; ++i) {
+    if (input[i] > 0)
+      sum += x + y;
+    else
+      sum -= x - y;
+    sum ^= (x << 1) + (y >> 1);
+  }
+
+  return sum == 0;
+}
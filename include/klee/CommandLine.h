@@ -67,6 +67,10 @@ extern llvm::cl::opt<CoreSolverType> CoreSolverToUse;
 
 extern llvm::cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith;
 
+extern llvm::cl::list<CoreSolverType> SolverPortfolio;
+
+extern llvm::cl::opt<double> PortfolioThreshold;
+
 // We should compile in this option even when ENABLE_Z3
 // was undefined to avoid regression test failure.
 extern llvm::cl::opt<bool> NoInterpolation;
@@ -81,6 +85,14 @@ extern llvm::cl::opt<bool> NoExistential;
 
 extern llvm::cl::opt<int> MaxFailSubsumption;
 
+extern llvm::cl::opt<double> SubsumptionBackoffRatio;
+
+extern llvm::cl::opt<bool> SubsumptionCheckLoopHeads;
+
+extern llvm::cl::opt<bool> FunctionSummaries;
+
+extern llvm::cl::opt<bool> StoreRelevanceAnalysis;
+
 extern llvm::cl::opt<int> DebugState;
 
 extern llvm::cl::opt<int> DebugSubsumption;
@@ -91,6 +103,24 @@ extern llvm::cl::opt<bool> SpecialFunctionBoundInterpolation;
 
 extern llvm::cl::opt<bool> TracerXPointerError;
 
+extern llvm::cl::opt<bool> Z3Incremental;
+
+extern llvm::cl::opt<unsigned> Z3ConstructCacheSize;
+
+extern llvm::cl::opt<unsigned> SubsumptionThreads;
+
+extern llvm::cl::opt<unsigned> MaxSubsumptionTableMB;
+
+extern llvm::cl::opt<std::string> ReadSubsumptionTable;
+
+extern llvm::cl::opt<std::string> WriteSubsumptionTable;
+
+extern llvm::cl::opt<bool> SubsumptionProfile;
+
+extern llvm::cl::opt<unsigned> Z3Workers;
+
+extern llvm::cl::opt<unsigned> Z3WorkerMemoryMB;
+
 #endif
 
 #ifdef ENABLE_METASMT
@@ -11,6 +11,10 @@
 #define KLEE_CONSTRAINTS_H
 
 #include "klee/Expr.h"
+#include "klee/util/IndependentElementSet.h"
+
+#include <cstddef>
+#include <iterator>
 
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
@@ -19,23 +23,153 @@
 namespace klee {
 
 class ExprVisitor;
-  
+
+/// ConstraintNode - A node of the persistent list of constraints, holding
+/// the last constraint and the node of the constraints before it. The nodes
+/// are shared by the copies of a constraint set, e.g., of forked states.
+class ConstraintNode {
+public:
+  unsigned refCount;
+
+  ref<ConstraintNode> parent;
+
+  const ref<Expr> constraint;
+
+  /// size - The number of constraints up to this node
+  const size_t size;
+
+  /// hash - The hash of the constraints up to this node, in order
+  const unsigned hash;
+
+  ConstraintNode(const ref<ConstraintNode> &_parent, ref<Expr> _constraint)
+      : refCount(0), parent(_parent), constraint(_constraint),
+        size(_parent.isNull() ? 1 : _parent->size + 1),
+        hash(_parent.isNull()
+                 ? _constraint->hash()
+                 : (_parent->hash * Expr::MAGIC_HASH_CONSTANT) ^
+                       _constraint->hash()) {}
+
+  ~ConstraintNode();
+};
+
+/// ConstraintSegment - A segment of the constraints of a set in order,
+/// following the first offset constraints of its prefix segments. The
+/// segments are only appended to, and are shared by the copies of a set: a
+/// copy extending a segment already extended by another copy starts a new
+/// segment instead, so that no copy flattens the constraints again.
+class ConstraintSegment {
+public:
+  unsigned refCount;
+
+  /// prefix - The segment of the constraints before this one, null for the
+  /// first segment
+  ref<ConstraintSegment> prefix;
+
+  /// offset - The number of constraints before this segment
+  const size_t offset;
+
+  std::vector< ref<Expr> > constraints;
+
+  ConstraintSegment(const ref<ConstraintSegment> &_prefix, size_t _offset)
+      : refCount(0), prefix(_prefix), offset(_offset) {}
+
+  ~ConstraintSegment();
+};
+
+/// ConstraintSegmentPath - The segments of a set from the first one, as
+/// walked by the iterators of the set.
+class ConstraintSegmentPath {
+public:
+  unsigned refCount;
+
+  std::vector<const ConstraintSegment *> segments;
+
+  ConstraintSegmentPath() : refCount(0) {}
+};
+
+/// IndependentFactors - The independent factors of the constraints of a set,
+/// pairwise not intersecting, shared by the copies of the set until one of
+/// them is extended.
+class IndependentFactors {
+public:
+  unsigned refCount;
+
+  std::vector<ref<IndependentFactor> > factors;
+
+  IndependentFactors() : refCount(0) {}
+};
+
 class ConstraintManager {
 public:
-  typedef std::vector< ref<Expr> > constraints_ty;
-  typedef constraints_ty::iterator iterator;
-  typedef constraints_ty::const_iterator const_iterator;
+  /// const_iterator - Walks the constraints of a set in order, across the
+  /// segments shared with its copies.
+  class const_iterator {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef ref<Expr> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const ref<Expr> *pointer;
+    typedef const ref<Expr> &reference;
+
+    const_iterator() : index(0), segment(0), position(0), segmentIndex(0) {}
+
+    reference operator*() const { return segment->constraints[position]; }
+    pointer operator->() const { return &segment->constraints[position]; }
+
+    const_iterator &operator++() {
+      ++index;
+      ++position;
+      if (!path.isNull() && segmentIndex + 1 < path->segments.size() &&
+          index == path->segments[segmentIndex + 1]->offset) {
+        segment = path->segments[++segmentIndex];
+        position = 0;
+      }
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator it(*this);
+      ++*this;
+      return it;
+    }
+
+    bool operator==(const const_iterator &other) const {
+      return index == other.index;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return index != other.index;
+    }
+
+  private:
+    friend class ConstraintManager;
+
+    /// index - The number of constraints before this one in the set
+    size_t index;
+
+    /// path - The segments of the set, null when it has only one
+    ref<ConstraintSegmentPath> path;
+
+    const ConstraintSegment *segment;
+
+    /// position - The index of the constraint in its segment
+    size_t position;
+
+    /// segmentIndex - The index of the segment in the path
+    size_t segmentIndex;
+  };
+
+  typedef const_iterator iterator;
+  typedef const_iterator constraint_iterator;
 
   ConstraintManager() {}
 
   // create from constraints with no optimization
   explicit
-  ConstraintManager(const std::vector< ref<Expr> > &_constraints) :
-    constraints(_constraints) {}
+  ConstraintManager(const std::vector< ref<Expr> > &_constraints);
 
-  ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {}
-
-  typedef std::vector< ref<Expr> >::const_iterator constraint_iterator;
+  // copying is constant-time, as the constraints and factors are shared
+  ConstraintManager(const ConstraintManager &cs)
+      : last(cs.last), segment(cs.segment), factors(cs.factors) {}
 
   // given a constraint which is known to be valid, attempt to 
   // simplify the existing constraint set
@@ -46,33 +180,54 @@ public:
   ref<Expr> simplifyExpr(ref<Expr> e, std::vector<ref<Expr> > &core) const;
 
   void addConstraint(ref<Expr> e);
+
+  /// getIndependentConstraints - Appends to result the constraints that
+  /// transitively share array elements with the given expression, in the
+  /// order of the constraint set. The independent factors of the set are
+  /// computed on the first call and then maintained as constraints are
+  /// added, and copies of the set share them.
+  void getIndependentConstraints(ref<Expr> e,
+                                 std::vector<ref<Expr> > &result) const;
   
   bool empty() const {
-    return constraints.empty();
+    return last.isNull();
   }
   ref<Expr> back() const {
-    return constraints.back();
+    return last->constraint;
   }
-  constraint_iterator begin() const {
-    return constraints.begin();
-  }
-  constraint_iterator end() const {
-    return constraints.end();
+  const_iterator begin() const;
+  const_iterator end() const {
+    const_iterator it;
+    it.index = size();
+    return it;
   }
   size_t size() const {
-    return constraints.size();
+    return last.isNull() ? 0 : last->size;
   }
 
-  bool operator==(const ConstraintManager &other) const {
-    return constraints == other.constraints;
-  }
-  
-  constraints_ty getConstraints() const{
-	  return constraints;
-  }
+  bool operator==(const ConstraintManager &other) const;
 
+  /// getLastNode - The node of the last constraint, null for the empty set,
+  /// which identifies the constraints in constant time
+  const ref<ConstraintNode> &getLastNode() const { return last; }
+  
 private:
-  std::vector< ref<Expr> > constraints;
+  /// last - The node of the last constraint, null for the empty set
+  ref<ConstraintNode> last;
+
+  /// segment - The segment of the last constraint, null for the empty set
+  ref<ConstraintSegment> segment;
+
+  /// factors - The independent factors of the constraints, null when not
+  /// yet computed
+  mutable ref<IndependentFactors> factors;
+
+  /// append - Appends a constraint to the list, without simplification.
+  void append(ref<Expr> e);
+
+  /// addToFactors - Merges the constraint at the given position of the set
+  /// with the factors it intersects.
+  void addToFactors(ref<Expr> e, size_t position) const;
 
   // returns true iff the constraints were modified
   bool rewriteConstraints(ExprVisitor &visitor);
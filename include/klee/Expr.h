@@ -35,6 +35,7 @@ class Array;
 class ArrayCache;
 class ConstantExpr;
 class ObjectState;
+class UpdateList;
 
 template<class T> class ref;
 
@@ -169,14 +170,111 @@ public:
     CmpKindLast = Sge
   };
 
-  unsigned refCount;
+  unsigned refCount : 31;
+
+  /// isUnique - Whether the expression is in the hash-consing table
+  unsigned isUnique : 1;
 
 protected:  
   unsigned hashValue;
+
+  /// ConsKey - What identifies an expression in the hash-consing table,
+  /// known before the expression is allocated: its kind, its kids by
+  /// pointer, as they are unique themselves, and its other contents. The
+  /// hash is the one the expression would compute, so that the table can
+  /// be keyed by it.
+  struct ConsKey {
+    Kind kind;
+
+    /// width - The width, 0 when implied by the kind and the kids
+    Width width;
+
+    unsigned numKids;
+    const Expr *kids[3];
+
+    /// The contents of constants, reads and extracts
+    const llvm::APInt *value;
+    const UpdateList *updates;
+    unsigned offset;
+
+    unsigned hash;
+
+    ConsKey(Kind _kind, const ref<Expr> &kid0,
+            const ref<Expr> &kid1 = ref<Expr>(),
+            const ref<Expr> &kid2 = ref<Expr>())
+        : kind(_kind), width(0), numKids(0), value(0), updates(0),
+          offset(0) {
+      addKid(kid0);
+      addKid(kid1);
+      addKid(kid2);
+      computeHash();
+    }
+
+    ConsKey(Kind _kind, const ref<Expr> &kid, Width _width,
+            unsigned _offset = 0)
+        : kind(_kind), width(_width), numKids(0), value(0), updates(0),
+          offset(_offset) {
+      addKid(kid);
+      computeHash();
+    }
+
+    ConsKey(const llvm::APInt &_value)
+        : kind(Constant), width(_value.getBitWidth()), numKids(0),
+          value(&_value), updates(0), offset(0) {
+      computeHash();
+    }
+
+    ConsKey(const UpdateList &_updates, const ref<Expr> &index)
+        : kind(Read), width(0), numKids(0), value(0), updates(&_updates),
+          offset(0) {
+      addKid(index);
+      computeHash();
+    }
+
+    /// matches - Whether the expression is the one identified by the key
+    bool matches(const Expr &e) const;
+
+  private:
+    void addKid(const ref<Expr> &kid) {
+      if (!kid.isNull())
+        kids[numKids++] = kid.get();
+    }
+
+    void computeHash();
+  };
+
+  /// findUnique - Returns the expression of the hash-consing table
+  /// identified by the key, if any, so that it is not allocated again.
+  static Expr *findUnique(const ConsKey &key);
+
+  /// hashCons - Inserts the newly allocated expression, not found by
+  /// findUnique, in the hash-consing table when hash-consing.
+  template <class T> static ref<T> hashCons(const ref<T> &e) {
+    if (hashConsing)
+      insertUnique(e.get());
+    return e;
+  }
+
+  static void insertUnique(Expr *e);
+  static void removeUnique(Expr *e);
   
 public:
-  Expr() : refCount(0) { Expr::count++; }
-  virtual ~Expr() { Expr::count--; } 
+  /// hashConsing - Whether the allocated expressions are hash-consed: an
+  /// expression structurally equal to an existing one is not allocated
+  /// again, the existing one is shared instead, so that equal expressions
+  /// compare equal by pointer. Like the reference counts, the table of the
+  /// unique expressions is not thread safe.
+  static bool hashConsing;
+
+  /// uniqueCount - The number of expressions in the hash-consing table.
+  static unsigned uniqueCount;
+
+  Expr() : refCount(0), isUnique(0) { Expr::count++; }
+  virtual ~Expr() {
+    Expr::count--;
+    if (isUnique)
+      removeUnique(this);
+  }
 
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
@@ -422,9 +520,12 @@ public:
   ref<Expr> src;
 
   static ref<Expr> alloc(const ref<Expr> &src) {
+    if (hashConsing)
+      if (Expr *e = findUnique(ConsKey(NotOptimized, src)))
+        return e;
     ref<Expr> r(new NotOptimizedExpr(src));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(ref<Expr> src);
@@ -576,9 +677,12 @@ public:
 
 public:
   static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index) {
+    if (hashConsing)
+      if (Expr *e = findUnique(ConsKey(updates, index)))
+        return e;
     ref<Expr> r(new ReadExpr(updates, index));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(const UpdateList &updates, ref<Expr> i);
@@ -621,9 +725,12 @@ public:
 public:
   static ref<Expr> alloc(const ref<Expr> &c, const ref<Expr> &t, 
                          const ref<Expr> &f) {
+    if (hashConsing)
+      if (Expr *e = findUnique(ConsKey(Select, c, t, f)))
+        return e;
     ref<Expr> r(new SelectExpr(c, t, f));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(ref<Expr> c, ref<Expr> t, ref<Expr> f);
@@ -678,9 +785,12 @@ private:
 
 public:
   static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {
+    if (hashConsing)
+      if (Expr *e = findUnique(ConsKey(Concat, l, r)))
+        return e;
     ref<Expr> c(new ConcatExpr(l, r));
     c->computeHash();
-    return c;
+    return hashCons(c);
   }
   
   static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);
@@ -737,9 +847,12 @@ public:
 
 public:  
   static ref<Expr> alloc(const ref<Expr> &e, unsigned o, Width w) {
+    if (hashConsing)
+      if (Expr *u = findUnique(ConsKey(Extract, e, w, o)))
+        return u;
     ref<Expr> r(new ExtractExpr(e, o, w));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   /// Creates an ExtractExpr with the given bit offset and width
@@ -788,9 +901,12 @@ public:
 
 public:  
   static ref<Expr> alloc(const ref<Expr> &e) {
+    if (hashConsing)
+      if (Expr *u = findUnique(ConsKey(Not, e)))
+        return u;
     ref<Expr> r(new NotExpr(e));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(const ref<Expr> &e);
@@ -865,9 +981,12 @@ public:                                                          \
 public:                                                          \
     _class_kind ## Expr(ref<Expr> e, Width w) : CastExpr(e,w) {} \
     static ref<Expr> alloc(const ref<Expr> &e, Width w) {        \
+      if (hashConsing)                                           \
+        if (Expr *u = findUnique(ConsKey(_class_kind, e, w)))    \
+          return u;                                              \
       ref<Expr> r(new _class_kind ## Expr(e, w));                \
       r->computeHash();                                          \
-      return r;                                                  \
+      return hashCons(r);                                        \
     }                                                            \
     static ref<Expr> create(const ref<Expr> &e, Width w);        \
     Kind getKind() const { return _class_kind; }                 \
@@ -897,9 +1016,12 @@ public:                                                              \
     _class_kind ## Expr(const ref<Expr> &l,                          \
                         const ref<Expr> &r) : BinaryExpr(l,r) {}     \
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) { \
+      if (hashConsing)                                               \
+        if (Expr *e = findUnique(ConsKey(_class_kind, l, r)))        \
+          return e;                                                  \
       ref<Expr> res(new _class_kind ## Expr (l, r));                 \
       res->computeHash();                                            \
-      return res;                                                    \
+      return hashCons(res);                                          \
     }                                                                \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r); \
     Width getWidth() const { return left->getWidth(); }              \
@@ -941,9 +1063,12 @@ public:                                                              \
     _class_kind ## Expr(const ref<Expr> &l,                          \
                         const ref<Expr> &r) : CmpExpr(l,r) {}        \
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) { \
+      if (hashConsing)                                               \
+        if (Expr *e = findUnique(ConsKey(_class_kind, l, r)))        \
+          return e;                                                  \
       ref<Expr> res(new _class_kind ## Expr (l, r));                 \
       res->computeHash();                                            \
-      return res;                                                    \
+      return hashCons(res);                                          \
     }                                                                \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r); \
     Kind getKind() const { return _class_kind; }                     \
@@ -1042,9 +1167,12 @@ public:
   void toMemory(void *address);
 
   static ref<ConstantExpr> alloc(const llvm::APInt &v) {
+    if (hashConsing)
+      if (Expr *e = findUnique(ConsKey(v)))
+        return static_cast<ConstantExpr *>(e);
     ref<ConstantExpr> r(new ConstantExpr(v));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
 
   static ref<ConstantExpr> alloc(const llvm::APFloat &f) {
@@ -29,6 +29,7 @@ namespace klee {
 
     typedef ImmutableTree<K, value_type, _Select1st<value_type,key_type>, CMP> Tree;
     typedef typename Tree::iterator iterator;
+    typedef typename Tree::iterator const_iterator;
 
   private:
     Tree elts;
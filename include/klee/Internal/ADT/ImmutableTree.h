@@ -11,6 +11,7 @@
 #define __UTIL_IMMUTABLETREE_H__
 
 #include <cassert>
+#include <cstddef>
 #include <vector>
 
 namespace klee {
@@ -273,7 +274,9 @@ namespace klee {
   template<class K, class V, class KOV, class CMP>
   inline void ImmutableTree<K,V,KOV,CMP>::Node::decref() {
     --references;
-    if (references==0) delete this;
+    // The terminator is static; it may still be referenced from the
+    // terminator of an enclosing tree whose values are themselves trees.
+    if (references==0 && !isTerminator()) delete this;
   }
 
   template<class K, class V, class KOV, class CMP>
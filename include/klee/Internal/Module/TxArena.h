@@ -0,0 +1,125 @@
+//===-- TxArena.h - Allocator of Tracer-X tree objects ----------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the declarations of the allocator of the objects of the
+/// Tracer-X tree: the tree nodes, their dependency, store and path condition
+/// managers, and the values, store entries and path-condition constraints.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_TXARENA_H
+#define KLEE_TXARENA_H
+
+#include <map>
+#include <set>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace klee {
+
+/// \brief An allocator of fixed-size blocks for one type of objects of the
+/// Tracer-X tree.
+///
+/// Blocks are carved out of large chunks, so that objects allocated one after
+/// another, e.g., the store entries of a path, are adjacent in memory, and a
+/// freed block is recycled for the next object of the type instead of being
+/// returned to malloc. New blocks are taken from the chunk of lowest address
+/// that has one, so that the other chunks empty as the tree shrinks. A chunk
+/// whose blocks are all freed is returned to malloc, except for one kept for
+/// the tree nodes to come, so that the malloc usage checked by -max-memory
+/// goes down with the tree.
+///
+/// The classes allocated in arenas define operator new and operator delete
+/// using TxArena::get. The arenas are not thread safe, hence the objects must
+/// only be created and destroyed by the main thread.
+class TxArena {
+public:
+  /// \brief The types of objects allocated in arenas
+  enum Kind {
+    TreeNode,
+    Dependency,
+    Store,
+    PathCondition,
+    StateValue,
+    StoreEntry,
+    PCConstraint,
+    NumKinds
+  };
+
+private:
+  /// \brief The number of blocks of a chunk
+  static const unsigned blocksPerChunk = 256;
+
+  /// \brief The arenas, created on first use and never deleted, as
+  /// reference-counted objects may still be released during the static
+  /// destruction at exit
+  static TxArena *arenas[NumKinds];
+
+  const char *name;
+
+  /// \brief A chunk of blocks
+  struct Chunk {
+    /// \brief The freed blocks of the chunk, each holding the address of the
+    /// next one
+    void *freeList;
+
+    /// \brief The number of blocks carved out of the chunk so far
+    unsigned carvedBlocks;
+
+    /// \brief The number of allocated blocks of the chunk
+    unsigned liveBlocks;
+
+    Chunk() : freeList(0), carvedBlocks(0), liveBlocks(0) {}
+  };
+
+  /// \brief The size of a block, set by the first allocation
+  size_t blockSize;
+
+  /// \brief The chunks by address, so that a block is found in the chunk of
+  /// the greatest address not above it
+  std::map<char *, Chunk> chunks;
+
+  /// \brief The chunks that have a block to allocate
+  std::set<char *> availableChunks;
+
+  /// \brief The chunk without allocated blocks that is kept, or null
+  char *spareChunk;
+
+  uint64_t liveBytes;
+
+  uint64_t peakBytes;
+
+  TxArena(const char *_name)
+      : name(_name), blockSize(0), spareChunk(0), liveBytes(0), peakBytes(0) {}
+
+public:
+  static TxArena &get(Kind kind);
+
+  void *allocate(size_t size);
+
+  void deallocate(void *block, size_t size);
+
+  /// \brief The name of the type of objects, used in the statistics
+  const char *getName() const { return name; }
+
+  /// \brief The number of bytes of the objects currently allocated
+  uint64_t getLiveBytes() const { return liveBytes; }
+
+  /// \brief The maximum number of bytes of the objects allocated at once
+  uint64_t getPeakBytes() const { return peakBytes; }
+
+  /// \brief The number of bytes of the chunks currently allocated
+  uint64_t getChunkBytes() const {
+    return chunks.size() * blockSize * blocksPerChunk;
+  }
+};
+}
+
+#endif
@@ -21,6 +21,7 @@
 
 #include "klee/Config/Version.h"
 #include "klee/Expr.h"
+#include "klee/Internal/Module/TxArena.h"
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
 #include <llvm/IR/BasicBlock.h>
@@ -34,6 +35,9 @@
 #include <llvm/Value.h>
 #endif
 
+#include <map>
+#include <set>
+#include <string>
 #include <vector>
 
 namespace klee {
@@ -48,6 +52,107 @@ class TxStore;
 
 const uint64_t symbolicBoundId = ULONG_MAX;
 
+/// \brief Maps a key onto a single bit of a 64-bit signature. Signatures are
+/// unions of such bits, used as cheap over-approximations of sets: if a bit
+/// of one signature is missing from another, the corresponding set cannot be
+/// included in the other.
+inline uint64_t getSignatureBit(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return ((uint64_t)1) << (key & 63);
+}
+
+/// \brief An interned call history: the sequence of call sites by which a
+/// value or an allocation is reached.
+///
+/// A call history is linked to its parent, the call history without its last
+/// call site, and there is only one object per (parent, call site) pair.
+/// Call histories are therefore equal if and only if they are the same
+/// object, and can be compared and hashed by pointer. The objects are never
+/// deleted before the end of the execution.
+class TxCallHistory {
+  const TxCallHistory *parent;
+
+  llvm::Instruction *callSite;
+
+  unsigned length;
+
+  /// \brief The call histories extending this one by a call site
+  mutable std::map<llvm::Instruction *, TxCallHistory *> children;
+
+  TxCallHistory(const TxCallHistory *_parent, llvm::Instruction *_callSite)
+      : parent(_parent), callSite(_callSite),
+        length(_parent ? _parent->length + 1 : 0) {}
+
+  ~TxCallHistory();
+
+public:
+  /// \brief The call history of no call site
+  static const TxCallHistory *getEmpty();
+
+  /// \brief The call history extending this one with a call site
+  const TxCallHistory *push(llvm::Instruction *site) const;
+
+  /// \brief The call history without the last call site, or the empty call
+  /// history itself
+  const TxCallHistory *pop() const { return parent ? parent : this; }
+
+  /// \brief The last call site, or null for the empty call history
+  llvm::Instruction *getCallSite() const { return callSite; }
+
+  const TxCallHistory *getParent() const { return parent; }
+
+  unsigned size() const { return length; }
+
+  bool empty() const { return length == 0; }
+
+  /// \brief The call sites, from the first to the last
+  std::vector<llvm::Instruction *> getCallSites() const;
+
+  /// \brief The call history of the call sites of this one after the given
+  /// prefix, starting from the empty call history.
+  ///
+  /// \return The suffix, or null if prefix is not a prefix of this call
+  /// history.
+  const TxCallHistory *getSuffix(const TxCallHistory *prefix) const;
+
+  /// \brief The call history of the call sites of this one followed by those
+  /// of the given suffix
+  const TxCallHistory *append(const TxCallHistory *suffix) const;
+};
+
+/// \brief A set of reasons for interpolant marking, used for debugging.
+///
+/// The reason texts are interned into a table shared by all sets, and a set
+/// only keeps the identifiers of its reasons in increasing order. Marking a
+/// value again with the same reason therefore neither copies nor compares
+/// the text.
+class TxCoreReasons {
+  /// \brief The identifiers of the reasons, in increasing order
+  std::vector<unsigned> reasons;
+
+  /// \brief The texts of the interned reasons, indexed by identifier
+  static std::vector<std::string> &getTable();
+
+public:
+  /// \brief The identifier of the empty reason, which is never inserted
+  static const unsigned noReason = 0;
+
+  /// \brief Retrieves the identifier of a reason text, interning it when
+  /// first seen. The empty text is noReason.
+  static unsigned intern(const std::string &text);
+
+  static const std::string &getText(unsigned id) { return getTable()[id]; }
+
+  void insert(unsigned id);
+
+  bool empty() const { return reasons.empty(); }
+
+  /// \brief The texts of the reasons, in lexicographic order
+  std::set<std::string> getTexts() const;
+};
+
 class TxAllocationContext {
 
 public:
@@ -58,52 +163,49 @@ private:
   llvm::Value *value;
 
   /// \brief The call history by which the allocation is reached
-  std::vector<llvm::Instruction *> callHistory;
-
-  TxAllocationContext(llvm::Value *_value,
-                      const std::vector<llvm::Instruction *> &_callHistory)
-      : refCount(0), value(_value), callHistory(_callHistory) {}
+  const TxCallHistory *callHistory;
+
+  /// \brief Whether the call history is relative to the entry of the
+  /// function of a table entry, as in the generalized stores of the function
+  /// summaries, instead of starting from the program entry
+  bool relative;
+
+  /// \brief The signature bit of this context, equal for contexts that
+  /// compare equal
+  uint64_t signature;
+
+  TxAllocationContext(llvm::Value *_value, const TxCallHistory *_callHistory,
+                      bool _relative)
+      : refCount(0), value(_value), callHistory(_callHistory),
+        relative(_relative) {
+    signature = getSignatureBit(reinterpret_cast<uintptr_t>(value) * 31 +
+                                reinterpret_cast<uintptr_t>(callHistory) * 2 +
+                                relative);
+  }
 
 public:
-  ~TxAllocationContext() { callHistory.clear(); }
+  ~TxAllocationContext() {}
 
   static ref<TxAllocationContext>
   create(llvm::Value *_value,
-         const std::vector<llvm::Instruction *> &_callHistory);
+         const TxCallHistory *_callHistory, bool _relative = false);
 
   llvm::Value *getValue() const { return value; }
 
-  const std::vector<llvm::Instruction *> &getCallHistory() const {
-    return callHistory;
-  }
+  const TxCallHistory *getCallHistory() const { return callHistory; }
+
+  bool isRelative() const { return relative; }
+
+  uint64_t getSignature() const { return signature; }
 
   int compare(const TxAllocationContext &other) const {
     if (value == other.value) {
-      // Please note the use of reverse iterator here, which improves
-      // performance.
-      for (std::vector<llvm::Instruction *>::const_reverse_iterator
-               it1 = callHistory.rbegin(),
-               ie1 = callHistory.rend(), it2 = other.callHistory.rbegin(),
-               ie2 = other.callHistory.rend();
-           ; ++it1, ++it2) {
-        if (it1 == ie1) {
-          if (it2 == ie2) {
-            break;
-          } else
-            return -1;
-        }
-        if (it2 == ie2)
-          return 1;
-        if (it1 == ie1)
-          return 1;
-        if ((*it1) > (*it2))
-          return 2;
-        if (it2 == ie2)
-          return -1;
-        if ((*it1) < (*it2))
-          return -2;
-      }
-      return 0;
+      if (relative != other.relative)
+        return relative ? 1 : -1;
+      // Call histories are interned, hence compared by pointer
+      if (callHistory == other.callHistory)
+        return 0;
+      return callHistory < other.callHistory ? -1 : 1;
     } else if (value < other.value) {
       return -3;
     }
@@ -331,21 +433,21 @@ private:
   bool doNotUseBound;
 
   /// \brief Reason this was stored as needed value
-  std::set<std::string> coreReasons;
+  TxCoreReasons coreReasons;
 
   /// \brief The original state value, which is used in subsumption check
   /// interpolation to propagate this value to interpolation marking
   ref<TxStateValue> originalValue;
 
   void init(llvm::Value *_value, ref<Expr> _expr, bool canInterpolateBound,
-            const std::set<std::string> &_coreReasons,
+            const TxCoreReasons &_coreReasons,
             ref<TxStateAddress> _locations,
             const std::map<ref<Expr>, ref<Expr> > &substitution,
             std::set<const Array *> &replacements, bool shadowing = false);
 
   TxInterpolantValue(llvm::Value *value, ref<Expr> expr,
                      bool canInterpolateBound,
-                     const std::set<std::string> &coreReasons,
+                     const TxCoreReasons &coreReasons,
                      ref<TxStateAddress> location,
                      const std::map<ref<Expr>, ref<Expr> > &substitution,
                      std::set<const Array *> &replacements) {
@@ -355,7 +457,7 @@ private:
 
   TxInterpolantValue(llvm::Value *value, ref<Expr> expr,
                      bool canInterpolateBound,
-                     const std::set<std::string> &coreReasons,
+                     const TxCoreReasons &coreReasons,
                      ref<TxStateAddress> location) {
     const std::map<ref<Expr>, ref<Expr> > dummySubstitution;
     std::set<const Array *> dummyReplacements;
@@ -363,10 +465,21 @@ private:
          dummySubstitution, dummyReplacements);
   }
 
+  TxInterpolantValue(
+      llvm::Value *_value, ref<Expr> _expr, bool canInterpolateBound,
+      const std::map<ref<TxAllocationInfo>, std::set<uint64_t> > &
+          _allocationBounds,
+      const std::map<ref<TxAllocationInfo>, std::set<ref<Expr> > > &
+          _allocationOffsets)
+      : refCount(0), expr(_expr), allocationBounds(_allocationBounds),
+        allocationOffsets(_allocationOffsets),
+        id(reinterpret_cast<uintptr_t>(this)), value(_value),
+        doNotUseBound(!canInterpolateBound) {}
+
 public:
   static ref<TxInterpolantValue>
   create(llvm::Value *value, ref<Expr> expr, bool canInterpolateBound,
-         const std::set<std::string> &coreReasons, ref<TxStateAddress> location,
+         const TxCoreReasons &coreReasons, ref<TxStateAddress> location,
          const std::map<ref<Expr>, ref<Expr> > &substitution,
          std::set<const Array *> &replacements) {
     ref<TxInterpolantValue> sv(
@@ -377,12 +490,26 @@ public:
 
   static ref<TxInterpolantValue> create(llvm::Value *value, ref<Expr> expr,
                                         ref<TxStateAddress> location) {
-    std::set<std::string> dummyCoreReasons;
+    TxCoreReasons dummyCoreReasons;
     ref<TxInterpolantValue> sv(
         new TxInterpolantValue(value, expr, false, dummyCoreReasons, location));
     return sv;
   }
 
+  /// \brief Creates a value read from a table file, with the bounds and
+  /// offsets of the value written to it. The LLVM value may be null, as it is
+  /// only printed.
+  static ref<TxInterpolantValue> create(
+      llvm::Value *value, ref<Expr> expr, bool canInterpolateBound,
+      const std::map<ref<TxAllocationInfo>, std::set<uint64_t> > &
+          allocationBounds,
+      const std::map<ref<TxAllocationInfo>, std::set<ref<Expr> > > &
+          allocationOffsets) {
+    ref<TxInterpolantValue> sv(new TxInterpolantValue(
+        value, expr, canInterpolateBound, allocationBounds, allocationOffsets));
+    return sv;
+  }
+
   ~TxInterpolantValue() {}
 
   int compare(const TxInterpolantValue other) const {
@@ -421,6 +548,16 @@ public:
 
   ref<Expr> getExpression() const { return expr; }
 
+  const std::map<ref<TxAllocationInfo>, std::set<uint64_t> > &
+  getAllocationBounds() const {
+    return allocationBounds;
+  }
+
+  const std::map<ref<TxAllocationInfo>, std::set<ref<Expr> > > &
+  getAllocationOffsets() const {
+    return allocationOffsets;
+  }
+
   llvm::Value *getValue() const { return value; }
 
   void setOriginalValue(ref<TxStateValue> value) { originalValue = value; }
@@ -526,7 +663,7 @@ public:
 
   static ref<TxStateAddress>
   create(llvm::Value *value,
-         const std::vector<llvm::Instruction *> &_callHistory,
+         const TxCallHistory *_callHistory,
          ref<Expr> &address, uint64_t size) {
     ref<Expr> zeroPointer = Expr::createPointer(0);
     ref<TxStateAddress> ret(
@@ -635,6 +772,14 @@ class TxStateValue {
 public:
   unsigned refCount;
 
+  static void *operator new(size_t size) {
+    return TxArena::get(TxArena::StateValue).allocate(size);
+  }
+
+  static void operator delete(void *block, size_t size) {
+    TxArena::get(TxArena::StateValue).deallocate(block, size);
+  }
+
 private:
   llvm::Value *value;
 
@@ -647,7 +792,7 @@ private:
   uint64_t id;
 
   /// \brief The context of this value
-  std::vector<llvm::Instruction *> callHistory;
+  const TxCallHistory *callHistory;
 
   /// \brief Store entries this value is dependent upon, on which memory bound
   /// interpolation may be enabled.
@@ -661,7 +806,7 @@ private:
   uint64_t depth;
 
   TxStateValue(llvm::Value *value,
-               const std::vector<llvm::Instruction *> &_callHistory,
+               const TxCallHistory *_callHistory,
                ref<Expr> _valueExpr, uint64_t _depth)
       : refCount(0), value(value), valueExpr(_valueExpr),
         id(reinterpret_cast<uint64_t>(this)), callHistory(_callHistory),
@@ -672,7 +817,7 @@ public:
 
   static ref<TxStateValue>
   create(uint64_t depth, llvm::Value *value,
-         const std::vector<llvm::Instruction *> &_callHistory,
+         const TxCallHistory *_callHistory,
          ref<Expr> valueExpr) {
     ref<TxStateValue> vvalue(
         new TxStateValue(value, _callHistory, valueExpr, depth));
@@ -737,9 +882,7 @@ public:
 
   llvm::Value *getValue() const { return value; }
 
-  const std::vector<llvm::Instruction *> &getCallHistory() const {
-    return callHistory;
-  }
+  const TxCallHistory *getCallHistory() const { return callHistory; }
 
   /// \brief Print minimal information about this object.
   ///
@@ -788,6 +931,14 @@ class TxStoreEntry {
 public:
   unsigned refCount;
 
+  static void *operator new(size_t size) {
+    return TxArena::get(TxArena::StoreEntry).allocate(size);
+  }
+
+  static void operator delete(void *block, size_t size) {
+    TxArena::get(TxArena::StoreEntry).deallocate(block, size);
+  }
+
 private:
   ref<TxStateAddress> address;
 
@@ -833,11 +984,11 @@ private:
 
   /// \brief Reasons for the interpolant marking, from the subtree of the
   /// immediate left child. This is used for debugging.
-  std::set<std::string> leftCoreReasons;
+  TxCoreReasons leftCoreReasons;
 
   /// \brief Reasons for the interpolant marking, from the subtree of the
   /// immediate right child. This is used for debugging.
-  std::set<std::string> rightCoreReasons;
+  TxCoreReasons rightCoreReasons;
 
   /// \brief Cached interpolant-style value for left querying in subsumption
   /// check.
@@ -847,6 +998,12 @@ private:
   /// check.
   ref<TxInterpolantValue> rightInterpolantStyleValue;
 
+  /// \brief The epochs of the latest dependency markings that visited this
+  /// entry, indexed by the subtree side of the marking and by whether it was
+  /// the pointer flow marking (see TxStore#markFlow and
+  /// TxStore#markPointerFlow).
+  uint64_t markingEpoch[2][2];
+
 public:
   TxStoreEntry(ref<TxStateAddress> _address, ref<TxStateValue> _addressValue,
                ref<TxStateValue> _content, const TxStore *store,
@@ -866,6 +1023,16 @@ public:
 
   ref<Expr> getExpression() const { return valueExpr; }
 
+  /// \brief Stamp this entry with the epoch of a dependency marking. Returns
+  /// false if the marking has already visited this entry in the same mode.
+  bool stampMarkingEpoch(bool leftMarking, bool pointerFlow, uint64_t epoch) {
+    uint64_t &stamp = markingEpoch[leftMarking ? 0 : 1][pointerFlow ? 1 : 0];
+    if (stamp == epoch)
+      return false;
+    stamp = epoch;
+    return true;
+  }
+
   std::map<ref<TxStoreEntry>, bool> &getAllowBoundEntryList() {
     return allowBoundEntryList;
   }
@@ -894,16 +1061,16 @@ public:
     rightDoNotInterpolateBound = true;
   }
 
-  void setAsCore(bool leftMarking, const std::string &reason) {
+  /// \brief Marks this entry as core, with the reason interned by
+  /// TxCoreReasons::intern
+  void setAsCore(bool leftMarking, unsigned reason) {
     if (leftMarking) {
       leftCore = true;
-      if (!reason.empty())
-        leftCoreReasons.insert(reason);
+      leftCoreReasons.insert(reason);
       return;
     }
     rightCore = true;
-    if (!reason.empty())
-      rightCoreReasons.insert(reason);
+    rightCoreReasons.insert(reason);
   }
 
   bool isCore(bool leftMarking) const {
@@ -242,7 +242,10 @@ namespace klee {
     static bool subsumptionCheck;
 
     /// Z3Solver - Construct a new Z3Solver.
-    Z3Solver();
+    ///
+    /// \param keepConstructCache - Whether the Z3 ASTs of the expressions
+    /// are kept across queries, instead of translated anew for every query.
+    Z3Solver(bool keepConstructCache = false);
 
     /// Get the query in SMT-LIBv2 format.
     /// \return A C-style string. The caller is responsible for freeing this.
@@ -258,6 +261,50 @@ namespace klee {
     bool directComputeValidity(const Query &query, Solver::Validity &result,
                                std::vector<ref<Expr> > &unsatCore);
   };
+
+  /// Z3WorkerSolver - A solver based on Z3 running in a pool of worker
+  /// processes, so that a crash or a memory blow-up of Z3 does not take
+  /// KLEE down.
+  class Z3WorkerSolver : public Solver {
+  public:
+    /// Z3WorkerSolver - Construct a new Z3WorkerSolver.
+    ///
+    /// \param workers - The number of worker processes kept running.
+    /// \param memoryLimitMB - The memory a worker may allocate on top of the
+    /// memory of KLEE when it was forked, in megabytes, 0 for no limit.
+    Z3WorkerSolver(unsigned workers, unsigned memoryLimitMB);
+
+    virtual char *getConstraintLog(const Query &);
+
+    virtual void setCoreSolverTimeout(double timeout);
+  };
+
+  class Z3ParallelSolverImpl;
+
+  /// Z3ParallelSolver - A pool of threads, each with its own Z3 context, for
+  /// finding the first valid query of a sequence of queries under the same
+  /// constraints.
+  class Z3ParallelSolver {
+    Z3ParallelSolverImpl *impl;
+
+  public:
+    /// Z3ParallelSolver - Construct a pool of the given number of threads.
+    Z3ParallelSolver(unsigned threads);
+    ~Z3ParallelSolver();
+
+    /// computeFirstValid - Return the position of the first of the query
+    /// expressions that is valid under the constraints, or the number of
+    /// expressions if there is none. The result does not depend on the
+    /// thread schedule.
+    ///
+    /// \param success - Whether the solver decided each query, for the
+    /// queries up to the returned position.
+    /// \param unsatCore - The unsatisfiability core of the valid query.
+    unsigned computeFirstValid(const ConstraintManager &constraints,
+                               const std::vector<ref<Expr> > &exprs,
+                               double timeout, std::vector<bool> &success,
+                               std::vector<ref<Expr> > &unsatCore);
+  };
   #endif // ENABLE_Z3
 
   #ifdef ENABLE_METASMT
@@ -330,6 +377,18 @@ namespace klee {
 
   // Create a solver based on the supplied ``CoreSolverType``.
   Solver *createCoreSolver(CoreSolverType cst);
+
+  /// createPortfolioSolver - Create a solver which answers with the main core
+  /// solver in KLEE's process, and runs the core solvers of the given types
+  /// in parallel processes on the queries it does not answer within
+  /// -solver-portfolio-threshold, answering with the first result. When
+  /// interpolation is enabled, unsatisfiable results are only taken from Z3,
+  /// for their unsatisfiability cores.
+  ///
+  /// \param cst - The type of the main core solver.
+  /// \param others - The types of the core solvers racing it.
+  Solver *createPortfolioSolver(CoreSolverType cst,
+                                const std::vector<CoreSolverType> &others);
 }
 
 #endif
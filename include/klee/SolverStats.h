@@ -30,6 +30,22 @@ namespace stats {
   extern Statistic subsumptionQueryTime;
   extern Statistic subsumptionQueryCount;
   extern Statistic subsumptionQueryFailureCount;
+  extern Statistic incrementalAssertions;
+  extern Statistic incrementalReusedAssertions;
+  extern Statistic portfolioSTPWins;
+  extern Statistic portfolioMetaSMTWins;
+  extern Statistic portfolioZ3Wins;
+  extern Statistic portfolioRaces;
+  extern Statistic z3ConstructCacheHits;
+  extern Statistic z3ConstructCacheMisses;
+  extern Statistic z3ConstructCacheEvictions;
+
+  /// z3ConstructCacheSize, z3ConstructCachePeakSize - The number of
+  /// translations currently kept by the construct caches of all Z3 builders,
+  /// and its maximum. Unlike the statistics, which only count up, the size
+  /// also goes down when entries are evicted.
+  extern uint64_t z3ConstructCacheSize;
+  extern uint64_t z3ConstructCachePeakSize;
 
 #ifdef DEBUG
   extern Statistic arrayHashTime;
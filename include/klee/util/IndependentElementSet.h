@@ -0,0 +1,328 @@
+//===-- IndependentElementSet.h ---------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_INDEPENDENTELEMENTSET_H
+#define KLEE_INDEPENDENTELEMENTSET_H
+
+#include "klee/Expr.h"
+#include "klee/util/ExprUtil.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+namespace klee {
+
+template<class T>
+class DenseSet {
+  typedef std::set<T> set_ty;
+  set_ty s;
+
+public:
+  DenseSet() {}
+
+  void add(T x) {
+    s.insert(x);
+  }
+  void add(T start, T end) {
+    for (; start<end; start++)
+      s.insert(start);
+  }
+
+  // returns true iff set is changed by addition
+  bool add(const DenseSet &b) {
+    bool modified = false;
+    for (typename set_ty::const_iterator it = b.s.begin(), ie = b.s.end(); 
+         it != ie; ++it) {
+      if (modified || !s.count(*it)) {
+        modified = true;
+        s.insert(*it);
+      }
+    }
+    return modified;
+  }
+
+  bool intersects(const DenseSet &b) const {
+    for (typename set_ty::const_iterator it = s.begin(), ie = s.end(); 
+         it != ie; ++it)
+      if (b.s.count(*it))
+        return true;
+    return false;
+  }
+
+  std::set<unsigned>::iterator begin(){
+    return s.begin();
+  }
+
+  std::set<unsigned>::iterator end(){
+    return s.end();
+  }
+
+  void print(llvm::raw_ostream &os) const {
+    bool first = true;
+    os << "{";
+    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
+         it != ie; ++it) {
+      if (first) {
+        first = false;
+      } else {
+        os << ",";
+      }
+      os << *it;
+    }
+    os << "}";
+  }
+};
+
+template <class T>
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
+                                     const DenseSet<T> &dis) {
+  dis.print(os);
+  return os;
+}
+
+class IndependentElementSet {
+public:
+  typedef std::map<const Array*, DenseSet<unsigned> > elements_ty;
+  elements_ty elements;                 // Represents individual elements of array accesses (arr[1])
+  std::set<const Array*> wholeObjects;  // Represents symbolically accessed arrays (arr[x])
+  std::vector<ref<Expr> > exprs;        // All expressions that are associated with this factor
+                                        // Although order doesn't matter, we use a vector to match
+                                        // the ConstraintManager constructor that will eventually
+                                        // be invoked.
+
+  IndependentElementSet() {}
+  IndependentElementSet(ref<Expr> e) {
+    exprs.push_back(e);
+    // Track all reads in the program.  Determines whether reads are
+    // concrete or symbolic.  If they are symbolic, "collapses" array
+    // by adding it to wholeObjects.  Otherwise, creates a mapping of
+    // the form Map<array, set<index>> which tracks which parts of the
+    // array are being accessed.
+    std::vector< ref<ReadExpr> > reads;
+    findReads(e, /* visitUpdates= */ true, reads);
+    for (unsigned i = 0; i != reads.size(); ++i) {
+      ReadExpr *re = reads[i].get();
+      const Array *array = re->updates.root;
+      
+      // Reads of a constant array don't alias.
+      if (re->updates.root->isConstantArray() &&
+          !re->updates.head)
+        continue;
+
+      if (!wholeObjects.count(array)) {
+        if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
+          // if index constant, then add to set of constraints operating
+          // on that array (actually, don't add constraint, just set index)
+          DenseSet<unsigned> &dis = elements[array];
+          dis.add((unsigned) CE->getZExtValue(32));
+        } else {
+          elements_ty::iterator it2 = elements.find(array);
+          if (it2!=elements.end())
+            elements.erase(it2);
+          wholeObjects.insert(array);
+        }
+      }
+    }
+  }
+  IndependentElementSet(const IndependentElementSet &ies) : 
+    elements(ies.elements),
+    wholeObjects(ies.wholeObjects),
+    exprs(ies.exprs) {}
+
+  IndependentElementSet &operator=(const IndependentElementSet &ies) {
+    elements = ies.elements;
+    wholeObjects = ies.wholeObjects;
+    exprs = ies.exprs;
+    return *this;
+  }
+
+  void print(llvm::raw_ostream &os) const {
+    os << "{";
+    bool first = true;
+    for (std::set<const Array*>::iterator it = wholeObjects.begin(), 
+           ie = wholeObjects.end(); it != ie; ++it) {
+      const Array *array = *it;
+
+      if (first) {
+        first = false;
+      } else {
+        os << ", ";
+      }
+
+      os << "MO" << array->name;
+    }
+    for (elements_ty::const_iterator it = elements.begin(), ie = elements.end();
+         it != ie; ++it) {
+      const Array *array = it->first;
+      const DenseSet<unsigned> &dis = it->second;
+
+      if (first) {
+        first = false;
+      } else {
+        os << ", ";
+      }
+
+      os << "MO" << array->name << " : " << dis;
+    }
+    os << "}";
+  }
+
+  // more efficient when this is the smaller set
+  bool intersects(const IndependentElementSet &b) const {
+    // If there are any symbolic arrays in our query that b accesses
+    for (std::set<const Array*>::iterator it = wholeObjects.begin(), 
+           ie = wholeObjects.end(); it != ie; ++it) {
+      const Array *array = *it;
+      if (b.wholeObjects.count(array) || 
+          b.elements.find(array) != b.elements.end())
+        return true;
+    }
+    for (elements_ty::const_iterator it = elements.begin(), ie = elements.end();
+         it != ie; ++it) {
+      const Array *array = it->first;
+      // if the array we access is symbolic in b
+      if (b.wholeObjects.count(array))
+        return true;
+      elements_ty::const_iterator it2 = b.elements.find(array);
+      // if any of the elements we access are also accessed by b
+      if (it2 != b.elements.end()) {
+        if (it->second.intersects(it2->second))
+          return true;
+      }
+    }
+    return false;
+  }
+
+  // returns true iff set is changed by addition
+  bool add(const IndependentElementSet &b) {
+    for(unsigned i = 0; i < b.exprs.size(); i ++){
+      ref<Expr> expr = b.exprs[i];
+      exprs.push_back(expr);
+    }
+
+    bool modified = false;
+    for (std::set<const Array*>::const_iterator it = b.wholeObjects.begin(), 
+           ie = b.wholeObjects.end(); it != ie; ++it) {
+      const Array *array = *it;
+      elements_ty::iterator it2 = elements.find(array);
+      if (it2!=elements.end()) {
+        modified = true;
+        elements.erase(it2);
+        wholeObjects.insert(array);
+      } else {
+        if (!wholeObjects.count(array)) {
+          modified = true;
+          wholeObjects.insert(array);
+        }
+      }
+    }
+    for (elements_ty::const_iterator it = b.elements.begin(), 
+           ie = b.elements.end(); it != ie; ++it) {
+      const Array *array = it->first;
+      if (!wholeObjects.count(array)) {
+        elements_ty::iterator it2 = elements.find(array);
+        if (it2==elements.end()) {
+          modified = true;
+          elements.insert(*it);
+        } else {
+          // Now need to see if there are any (z=?)'s
+          if (it2->second.add(it->second))
+            modified = true;
+        }
+      }
+    }
+    return modified;
+  }
+};
+
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
+                                     const IndependentElementSet &ies) {
+  ies.print(os);
+  return os;
+}
+
+/// IndependentFactorNode - A node of the constraints of an independent
+/// factor: a constraint with its position in the constraint set, after the
+/// constraints of the factors merged with it. The nodes are shared by the
+/// factors they were merged into, and by the copies of the set, so that a
+/// merge never copies the constraints.
+class IndependentFactorNode {
+public:
+  unsigned refCount;
+
+  const ref<Expr> constraint;
+
+  /// position - The index of the constraint in the constraint set
+  const size_t position;
+
+  /// merged - The constraints of the factors merged with this constraint
+  std::vector<ref<IndependentFactorNode> > merged;
+
+  /// size - The number of constraints up to this node
+  size_t size;
+
+  IndependentFactorNode(ref<Expr> _constraint, size_t _position)
+      : refCount(0), constraint(_constraint), position(_position), size(1) {}
+
+  ~IndependentFactorNode() {
+    // The merged nodes only referred to by this one are released in a loop,
+    // as the recursive destruction of a long path would overflow the stack.
+    std::vector<ref<IndependentFactorNode> > released;
+    released.swap(merged);
+    while (!released.empty()) {
+      ref<IndependentFactorNode> node = released.back();
+      released.pop_back();
+      if (node->refCount == 1) {
+        released.insert(released.end(), node->merged.begin(),
+                        node->merged.end());
+        node->merged.clear();
+      }
+    }
+  }
+
+  /// getConstraints - Appends the constraints with their positions in the
+  /// set, in no particular order.
+  void getConstraints(
+      std::vector<std::pair<size_t, ref<Expr> > > &result) const {
+    std::vector<const IndependentFactorNode *> worklist(1, this);
+    while (!worklist.empty()) {
+      const IndependentFactorNode *node = worklist.back();
+      worklist.pop_back();
+      result.push_back(std::make_pair(node->position, node->constraint));
+      for (std::vector<ref<IndependentFactorNode> >::const_iterator
+               it = node->merged.begin(), ie = node->merged.end();
+           it != ie; ++it)
+        worklist.push_back(it->get());
+    }
+  }
+};
+
+/// IndependentFactor - A reference-counted independent factor of a
+/// constraint set, shared by the copies of the set. A factor is only
+/// extended in place while no copy shares it.
+class IndependentFactor {
+public:
+  unsigned refCount;
+
+  /// elements - The array elements of the factor, without its expressions
+  IndependentElementSet elements;
+
+  /// constraints - The last constraint merged into the factor
+  ref<IndependentFactorNode> constraints;
+
+  IndependentFactor(const IndependentElementSet &_elements,
+                    const ref<IndependentFactorNode> &_constraints)
+      : refCount(0), elements(_elements), constraints(_constraints) {}
+};
+}
+
+#endif /* KLEE_INDEPENDENTELEMENTSET_H */
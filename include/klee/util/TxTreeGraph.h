@@ -190,6 +190,8 @@ public:
   static void addTableEntryMapping(TxTreeNode *txTreeNode,
                                    TxSubsumptionTableEntry *entry);
 
+  static void removeTableEntryMapping(TxSubsumptionTableEntry *entry);
+
   static void setAsCore(TxPCConstraint *pathCondition);
 
   static void setError(const ExecutionState &state,
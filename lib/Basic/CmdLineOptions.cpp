@@ -124,12 +124,46 @@ llvm::cl::opt<bool> NoExistential(
 
 llvm::cl::opt<int> MaxFailSubsumption(
     "max-subsumption-failure",
-    llvm::cl::desc("To set the maximum number of failed subsumption check. "
-                   "When this options is specified and the number of "
-                   "subsumption table entries is more than the specified "
-                   "value, the oldest entry will be deleted (default=0 (off))"),
+    llvm::cl::desc("Number of subsumption checks at a program point after "
+                   "which, when their failure ratio is at least "
+                   "-subsumption-backoff-ratio, the checks there back off "
+                   "exponentially until one succeeds (default=0 (off))"),
     llvm::cl::init(0));
 
+llvm::cl::opt<double> SubsumptionBackoffRatio(
+    "subsumption-backoff-ratio",
+    llvm::cl::desc("Failure ratio of the subsumption checks at a program "
+                   "point from which they back off, with "
+                   "-max-subsumption-failure (default=0.9)"),
+    llvm::cl::init(0.9));
+
+llvm::cl::opt<bool> FunctionSummaries(
+    "function-summaries",
+    llvm::cl::desc("Also check a state for subsumption against the table "
+                   "entries of its program point tabled under other call "
+                   "histories, when their subtrees never returned to the "
+                   "caller. The tabled cells of the frames of the function "
+                   "and its callees are matched relative to the call history "
+                   "of the state (default=off)."),
+    llvm::cl::init(false));
+
+llvm::cl::opt<bool> StoreRelevanceAnalysis(
+    "store-relevance-analysis",
+    llvm::cl::desc("Analyze statically the local variables that may still be "
+                   "read after each basic block, and drop from the "
+                   "subsumption table entries the stored values of those that "
+                   "cannot (default=off)."),
+    llvm::cl::init(false));
+
+llvm::cl::opt<bool> SubsumptionCheckLoopHeads(
+    "subsumption-check-loop-heads",
+    llvm::cl::desc("Check for subsumption only at the start of loop "
+                   "iterations, i.e., at loop headers and their successors, "
+                   "and at function entries. Table entries are only built "
+                   "there as well, unless the table is written to a file "
+                   "(default=off)."),
+    llvm::cl::init(false));
+
 llvm::cl::opt<int>
 DebugState("debug-state",
            llvm::cl::desc("Dump information on symbolic execution state when "
@@ -160,6 +194,79 @@ llvm::cl::opt<bool> TracerXPointerError(
     llvm::cl::desc("Enables detection of more memory errors by interpolation "
                    "shadow memory (may be false positives)."),
     llvm::cl::init(false));
+
+llvm::cl::opt<bool> Z3Incremental(
+    "z3-incremental",
+    llvm::cl::desc("Keep the path constraints asserted in a single Z3 solver "
+                   "across queries, popping and pushing only the constraints "
+                   "that differ from the previous query (default=off)."),
+    llvm::cl::init(false));
+
+llvm::cl::opt<unsigned> Z3ConstructCacheSize(
+    "z3-construct-cache-size",
+    llvm::cl::desc("Maximum number of translated expressions the Z3 builder "
+                   "keeps across queries. Expressions not used for two "
+                   "generations of half this size are evicted. 0 clears the "
+                   "translations after every query (default=65536)."),
+    llvm::cl::init(65536));
+
+llvm::cl::opt<unsigned> SubsumptionThreads(
+    "subsumption-threads",
+    llvm::cl::desc("Number of threads, each with its own Z3 context, for "
+                   "solving the queries of the subsumption checks of a state "
+                   "against the table entries of a program point. The entry "
+                   "chosen is the same as with sequential checking "
+                   "(default=0 (sequential))."),
+    llvm::cl::init(0));
+
+llvm::cl::opt<unsigned> MaxSubsumptionTableMB(
+    "max-subsumption-table-mb",
+    llvm::cl::desc("Memory budget of the subsumption table in megabytes. When "
+                   "exceeded, the least useful table entries are evicted, "
+                   "judged by their successful subsumptions, failed checks "
+                   "and age (default=0 (unlimited))."),
+    llvm::cl::init(0));
+
+llvm::cl::opt<std::string> ReadSubsumptionTable(
+    "read-subsumption-table",
+    llvm::cl::desc("Start with the subsumption table entries in the given "
+                   "file, written by an earlier run on the same module with "
+                   "-write-subsumption-table. A file written for another "
+                   "module is ignored."),
+    llvm::cl::init(""));
+
+llvm::cl::opt<std::string> WriteSubsumptionTable(
+    "write-subsumption-table",
+    llvm::cl::desc("At the end of the run, write the subsumption table "
+                   "entries to the given file, to be read by later runs. "
+                   "Entries with memory allocated at sites other than "
+                   "instructions, globals and arguments are not written."),
+    llvm::cl::init(""));
+
+llvm::cl::opt<bool> SubsumptionProfile(
+    "subsumption-profile",
+    llvm::cl::desc("Record the subsumption checks, successes, table entries "
+                   "scanned, solver calls and time of each program point and "
+                   "call history, and write them to subsumption-profile.csv "
+                   "in the output directory, the most expensive first "
+                   "(default=off)."),
+    llvm::cl::init(false));
+
+llvm::cl::opt<unsigned> Z3Workers(
+    "z3-workers",
+    llvm::cl::desc("Number of worker processes running the Z3 core solver "
+                   "outside of KLEE's process, so that a crash or a memory "
+                   "blow-up of Z3 only fails the query. The queries are "
+                   "solved one at a time, sent to the workers in turn "
+                   "(default=0 (Z3 runs in KLEE's process))."),
+    llvm::cl::init(0));
+
+llvm::cl::opt<unsigned> Z3WorkerMemoryMB(
+    "z3-worker-memory-mb",
+    llvm::cl::desc("Memory limit of a Z3 worker process in megabytes, on top "
+                   "of the memory it shares with KLEE. A worker exceeding it "
+                   "is restarted (default=0 (unlimited))."),
+    llvm::cl::init(0));
 #endif // ENABLE_Z3
 
 #ifdef ENABLE_METASMT
@@ -234,6 +341,24 @@ llvm::cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith(
                                 "Do not cross check (default)"),
                      clEnumValEnd),
     llvm::cl::init(NO_SOLVER));
+
+llvm::cl::list<CoreSolverType> SolverPortfolio(
+    "solver-portfolio", llvm::cl::CommaSeparated,
+    llvm::cl::desc("Comma-separated list of core solver backends to race "
+                   "against the one of -solver-backend on the queries it "
+                   "does not answer within -solver-portfolio-threshold, "
+                   "each in its own process. The first answer is used."),
+    llvm::cl::values(clEnumValN(STP_SOLVER, "stp", "stp"),
+                     clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
+                     clEnumValN(Z3_SOLVER, "z3", "Z3"), clEnumValEnd));
+
+llvm::cl::opt<double> PortfolioThreshold(
+    "solver-portfolio-threshold",
+    llvm::cl::desc("Seconds given to the -solver-backend core solver, in "
+                   "KLEE's process, before a query is raced with "
+                   "-solver-portfolio. 0 races every query in forked "
+                   "processes only (default=1.0)"),
+    llvm::cl::init(1.0));
 }
 #undef STP_IS_DEFAULT_STR
 #undef METASMT_IS_DEFAULT_STR
@@ -147,8 +147,7 @@ void ExecutionState::pushFrame(KInstIterator caller, KFunction *kf) {
 
 void ExecutionState::popFrame(KInstruction *ki, ref<Expr> returnValue) {
   StackFrame &sf = stack.back();
-  llvm::CallInst *site =
-      (sf.caller ? llvm::dyn_cast<CallInst>(sf.caller->inst) : 0);
+  llvm::Instruction *site = (sf.caller ? sf.caller->inst : 0);
   for (std::vector<const MemoryObject*>::iterator it = sf.allocas.begin(), 
          ie = sf.allocas.end(); it != ie; ++it)
     addressSpace.unbindObject(*it);
@@ -47,6 +47,7 @@
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/System/MemoryUsage.h"
 #include "klee/SolverStats.h"
+#include "TxRelevanceAnalysis.h"
 #include "TxShadowArray.h"
 #include "TxTree.h"
 
@@ -338,7 +339,10 @@ Executor::Executor(const InterpreterOptions &opts, InterpreterHandler *ih)
       debugInstFile(0), debugLogBuffer(debugBufferString) {
 
   if (coreSolverTimeout) UseForkedCoreSolver = true;
-  Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
+  Solver *coreSolver =
+      SolverPortfolio.empty()
+          ? klee::createCoreSolver(CoreSolverToUse)
+          : klee::createPortfolioSolver(CoreSolverToUse, SolverPortfolio);
   if (!coreSolver) {
     klee_error("Failed to create core solver\n");
   }
@@ -4037,6 +4041,12 @@ void Executor::runFunctionAsMain(Function *f,
     txTree = new TxTree(state, kmodule->targetData, &globalAddresses);
     state->txTreeNode = txTree->root;
     TxTreeGraph::initialize(txTree->root);
+#ifdef ENABLE_Z3
+    TxSubsumptionSchedule::initialize(kmodule);
+    TxRelevanceAnalysis::initialize(kmodule);
+    if (!ReadSubsumptionTable.empty())
+      TxSubsumptionTable::load(ReadSubsumptionTable, kmodule, arrayCache);
+#endif
   }
 
   run(*state);
@@ -4047,6 +4057,14 @@ void Executor::runFunctionAsMain(Function *f,
     TxTreeGraph::save(interpreterHandler->getOutputFilename("tree.dot"));
     TxTreeGraph::deallocate();
 
+#ifdef ENABLE_Z3
+    if (!WriteSubsumptionTable.empty())
+      TxSubsumptionTable::save(WriteSubsumptionTable, kmodule);
+    if (SubsumptionProfile)
+      TxSubsumptionTable::saveProfile(
+          interpreterHandler->getOutputFilename("subsumption-profile.csv"),
+          kmodule);
+#endif
     delete txTree;
     txTree = 0;
 
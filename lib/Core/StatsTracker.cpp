@@ -15,6 +15,7 @@
 #include "klee/Internal/Module/InstructionInfoTable.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/TxArena.h"
 #include "klee/Internal/Support/ModuleUtil.h"
 #include "klee/Internal/System/MemoryUsage.h"
 #include "klee/Internal/System/Time.h"
@@ -419,7 +420,14 @@ void StatsTracker::writeStatsHeader() {
 #ifdef DEBUG
 	     << "'ArrayHashTime',"
 #endif
-             << ")\n";
+      ;
+  // The memory of the objects of the Tracer-X tree, by type
+  for (unsigned i = 0; i < TxArena::NumKinds; ++i) {
+    const char *name = TxArena::get(TxArena::Kind(i)).getName();
+    *statsFile << "'" << name << "LiveBytes',"
+               << "'" << name << "PeakBytes',";
+  }
+  *statsFile << ")\n";
   statsFile->flush();
 }
 
@@ -445,7 +453,12 @@ void StatsTracker::writeStatsLine() {
 #ifdef DEBUG
              << "," << stats::arrayHashTime / 1000000.
 #endif
-             << ")\n";
+      ;
+  for (unsigned i = 0; i < TxArena::NumKinds; ++i) {
+    TxArena &arena = TxArena::get(TxArena::Kind(i));
+    *statsFile << "," << arena.getLiveBytes() << "," << arena.getPeakBytes();
+  }
+  *statsFile << ")\n";
   statsFile->flush();
 }
 
@@ -0,0 +1,116 @@
+//===-- TxArena.cpp - Allocator of Tracer-X tree objects --------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementation of the allocator of the objects of
+/// the Tracer-X tree.
+///
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Module/TxArena.h"
+
+#include <cassert>
+#include <new>
+
+using namespace klee;
+
+namespace klee {
+
+TxArena *TxArena::arenas[TxArena::NumKinds];
+
+TxArena &TxArena::get(Kind kind) {
+  static const char *names[NumKinds] = {
+    "TxTreeNode",   "TxDependency", "TxStore",       "TxPathCondition",
+    "TxStateValue", "TxStoreEntry", "TxPCConstraint"
+  };
+
+  assert(kind < NumKinds && "invalid arena");
+  if (!arenas[kind])
+    arenas[kind] = new TxArena(names[kind]);
+  return *arenas[kind];
+}
+
+void *TxArena::allocate(size_t size) {
+  // Blocks are aligned as the results of malloc
+  const size_t alignment = 2 * sizeof(void *);
+  size_t alignedSize = (size + alignment - 1) & ~(alignment - 1);
+  if (!blockSize)
+    blockSize = alignedSize;
+
+  liveBytes += size;
+  if (liveBytes > peakBytes)
+    peakBytes = liveBytes;
+
+  // Objects of another size, e.g., of derived classes, are not pooled
+  if (alignedSize != blockSize)
+    return ::operator new(size);
+
+  if (availableChunks.empty()) {
+    char *start =
+        static_cast<char *>(::operator new(blockSize * blocksPerChunk));
+    chunks.insert(std::make_pair(start, Chunk()));
+    availableChunks.insert(start);
+  }
+
+  char *start = *availableChunks.begin();
+  Chunk &chunk = chunks[start];
+  if (start == spareChunk)
+    spareChunk = 0;
+
+  void *block;
+  if (chunk.freeList) {
+    block = chunk.freeList;
+    chunk.freeList = *static_cast<void **>(block);
+  } else {
+    block = start + blockSize * chunk.carvedBlocks++;
+  }
+  ++chunk.liveBlocks;
+
+  if (!chunk.freeList && chunk.carvedBlocks == blocksPerChunk)
+    availableChunks.erase(start);
+  return block;
+}
+
+void TxArena::deallocate(void *block, size_t size) {
+  if (!block)
+    return;
+
+  assert(liveBytes >= size && "releasing more than allocated");
+  liveBytes -= size;
+
+  const size_t alignment = 2 * sizeof(void *);
+  if (((size + alignment - 1) & ~(alignment - 1)) != blockSize) {
+    ::operator delete(block);
+    return;
+  }
+
+  std::map<char *, Chunk>::iterator it =
+      chunks.upper_bound(static_cast<char *>(block));
+  assert(it != chunks.begin() && "block not allocated by the arena");
+  --it;
+  char *start = it->first;
+  Chunk &chunk = it->second;
+
+  *static_cast<void **>(block) = chunk.freeList;
+  chunk.freeList = block;
+  availableChunks.insert(start);
+  if (--chunk.liveBlocks)
+    return;
+
+  // One empty chunk is kept, so that a tree growing and shrinking around a
+  // chunk boundary does not allocate and release it repeatedly
+  if (!spareChunk) {
+    spareChunk = start;
+    return;
+  }
+  availableChunks.erase(start);
+  chunks.erase(it);
+  ::operator delete(start);
+}
+}
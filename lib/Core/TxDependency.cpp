@@ -65,7 +65,7 @@ TxDependency::registerNewTxStateValue(llvm::Value *value,
 }
 
 ref<TxStateValue> TxDependency::getLatestValue(
-    llvm::Value *value, const std::vector<llvm::Instruction *> &callHistory,
+    llvm::Value *value, const TxCallHistory *callHistory,
     ref<Expr> valueExpr, bool allowInconsistency) {
   assert(value && !valueExpr.isNull() && "value cannot be null");
 
@@ -117,11 +117,27 @@ ref<TxStateValue> TxDependency::getLatestValueNoConstantCheck(
     }
   }
 
-  if (parent)
-    return parent->getLatestValueNoConstantCheck(value, valueExpr,
-                                                 allowInconsistency);
+  if (!parent)
+    return 0;
+
+  // Here the value has no version in this node, or none with the expression
+  bool byExpression = !valueExpr.isNull() && !allowInconsistency;
+  InheritedValue &inherited = inheritedValues[value];
+  if (byExpression) {
+    if (!inherited.lastMatch.isNull() &&
+        inherited.lastMatch->getExpression() == valueExpr)
+      return inherited.lastMatch;
+  } else if (!inherited.latest.isNull()) {
+    return inherited.latest;
+  }
 
-  return 0;
+  ref<TxStateValue> ret = parent->getLatestValueNoConstantCheck(
+      value, valueExpr, allowInconsistency);
+  if (byExpression)
+    inherited.lastMatch = ret;
+  else
+    inherited.latest = ret;
+  return ret;
 }
 
 ref<TxStateValue> TxDependency::getLatestValueForMarking(llvm::Value *val,
@@ -234,7 +250,7 @@ void TxDependency::addDependencyWithOffset(ref<TxStateValue> source,
 }
 
 void TxDependency::addDependencyViaExternalFunction(
-    const std::vector<llvm::Instruction *> &callHistory,
+    const TxCallHistory *callHistory,
     ref<TxStateValue> source, ref<TxStateValue> target) {
   if (source.isNull() || target.isNull())
     return;
@@ -280,7 +296,7 @@ void TxDependency::addDependencyToNonPointer(ref<TxStateValue> source,
 }
 
 void TxDependency::populateArgumentValuesList(
-    llvm::CallInst *site, const std::vector<llvm::Instruction *> &callHistory,
+    llvm::CallInst *site, const TxCallHistory *callHistory,
     std::vector<ref<Expr> > &arguments,
     std::vector<ref<TxStateValue> > &argumentValuesList) {
   unsigned numArgs = site->getCalledFunction()->arg_size();
@@ -339,7 +355,7 @@ TxDependency::~TxDependency() {
 TxDependency *TxDependency::cdr() const { return parent; }
 
 void TxDependency::execute(llvm::Instruction *instr,
-                           const std::vector<llvm::Instruction *> &callHistory,
+                           const TxCallHistory *callHistory,
                            std::vector<ref<Expr> > &args,
                            bool symbolicExecutionError) {
   // The basic design principle that we need to be careful here
@@ -925,7 +941,7 @@ void TxDependency::execute(llvm::Instruction *instr,
 
 void TxDependency::executeMakeSymbolic(
     llvm::Instruction *instr,
-    const std::vector<llvm::Instruction *> &callHistory, ref<Expr> address,
+    const TxCallHistory *callHistory, ref<Expr> address,
     const Array *array) {
   llvm::Value *pointer = instr->getOperand(0);
 
@@ -952,7 +968,7 @@ void TxDependency::executeMakeSymbolic(
 
 void
 TxDependency::executePHI(llvm::Instruction *instr, unsigned int incomingBlock,
-                         const std::vector<llvm::Instruction *> &callHistory,
+                         const TxCallHistory *callHistory,
                          ref<Expr> valueExpr, bool symbolicExecutionError) {
   llvm::PHINode *node = llvm::dyn_cast<llvm::PHINode>(instr);
   llvm::Value *llvmArgValue = node->getIncomingValue(incomingBlock);
@@ -970,7 +986,7 @@ TxDependency::executePHI(llvm::Instruction *instr, unsigned int incomingBlock,
 
 bool TxDependency::executeMemoryOperation(
     llvm::Instruction *instr,
-    const std::vector<llvm::Instruction *> &callHistory,
+    const TxCallHistory *callHistory,
     std::vector<ref<Expr> > &args, bool inBounds, bool symbolicExecutionError) {
   bool ret = false;
   if (inBounds)
@@ -1027,7 +1043,7 @@ bool TxDependency::executeMemoryOperation(
 
 void
 TxDependency::bindCallArguments(llvm::Instruction *i,
-                                std::vector<llvm::Instruction *> &callHistory,
+                                const TxCallHistory *&callHistory,
                                 std::vector<ref<Expr> > &arguments) {
   llvm::CallInst *site = llvm::dyn_cast<llvm::CallInst>(i);
 
@@ -1045,7 +1061,7 @@ TxDependency::bindCallArguments(llvm::Instruction *i,
   populateArgumentValuesList(site, callHistory, arguments, argumentValuesList);
 
   unsigned index = 0;
-  callHistory.push_back(i);
+  callHistory = callHistory->push(i);
   for (llvm::Function::ArgumentListType::iterator
            it = callee->getArgumentList().begin(),
            ie = callee->getArgumentList().end();
@@ -1064,7 +1080,7 @@ TxDependency::bindCallArguments(llvm::Instruction *i,
 
 void
 TxDependency::bindReturnValue(llvm::CallInst *site,
-                              std::vector<llvm::Instruction *> &callHistory,
+                              const TxCallHistory *&callHistory,
                               llvm::Instruction *i, ref<Expr> returnValue) {
   llvm::ReturnInst *retInst = llvm::dyn_cast<llvm::ReturnInst>(i);
   if (site && retInst &&
@@ -1072,9 +1088,7 @@ TxDependency::bindReturnValue(llvm::CallInst *site,
       ) {
     ref<TxStateValue> value =
         getLatestValue(retInst->getReturnValue(), callHistory, returnValue);
-    if (!callHistory.empty()) {
-      callHistory.pop_back();
-    }
+    callHistory = callHistory->pop();
     if (!value.isNull())
       addDependency(value, getNewTxStateValue(site, callHistory, returnValue));
   }
@@ -1166,7 +1180,7 @@ void TxDependency::memoryBoundViolationInterpolation(llvm::Instruction *inst,
 }
 
 inline ref<TxStateValue> TxDependency::createConstantValue(
-    llvm::Value *value, const std::vector<llvm::Instruction *> &callHistory,
+    llvm::Value *value, const TxCallHistory *callHistory,
     ref<Expr> expr) {
   if (value->getType()->isPointerTy()) {
     llvm::Type *ty = value->getType()->getPointerElementType();
@@ -1177,12 +1191,12 @@ inline ref<TxStateValue> TxDependency::createConstantValue(
 }
 
 ref<TxStateValue> TxDependency::evalConstant(
-    llvm::Constant *c, const std::vector<llvm::Instruction *> &callHistory) {
+    llvm::Constant *c, const TxCallHistory *callHistory) {
   if (llvm::ConstantExpr *ce = llvm::dyn_cast<llvm::ConstantExpr>(c)) {
     return evalConstantExpr(ce, callHistory);
   } else {
     // We use empty call history for constants, since they are in a sense global
-    const std::vector<llvm::Instruction *> emptyCallHistory;
+    const TxCallHistory *emptyCallHistory = TxCallHistory::getEmpty();
 
     if (const llvm::ConstantInt *ci = llvm::dyn_cast<llvm::ConstantInt>(c)) {
       return createConstantValue(c, emptyCallHistory,
@@ -1260,7 +1274,7 @@ ref<TxStateValue> TxDependency::evalConstant(
 
 ref<TxStateValue> TxDependency::evalConstantExpr(
     llvm::ConstantExpr *ce,
-    const std::vector<llvm::Instruction *> &callHistory) {
+    const TxCallHistory *callHistory) {
   LLVM_TYPE_Q llvm::Type *type = ce->getType();
 
   ref<TxStateValue> op1(0), op2(0), op3(0);
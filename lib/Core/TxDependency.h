@@ -183,6 +183,22 @@ class TxDependency {
   /// \brief The store of the versioned values
   std::map<llvm::Value *, std::vector<ref<TxStateValue> > > valuesMap;
 
+  /// \brief The results of the lookups of a value in the ancestors
+  struct InheritedValue {
+    /// \brief The latest version in the nearest ancestor that has one
+    ref<TxStateValue> latest;
+
+    /// \brief The result of the last lookup by expression
+    ref<TxStateValue> lastMatch;
+  };
+
+  /// \brief The lookups of the values not in valuesMap, found in the
+  /// ancestors. The ancestors no longer change once this node is created, so
+  /// that a value found once is found again without walking the parent
+  /// chain, and a lookup from a descendant stops at the first ancestor that
+  /// remembers it.
+  mutable std::map<llvm::Value *, InheritedValue> inheritedValues;
+
   /// \brief The data layout of the analysis target program
   llvm::DataLayout *targetData;
 
@@ -203,7 +219,7 @@ class TxDependency {
   /// new instruction, as a value for the instruction.
   ref<TxStateValue>
   getNewTxStateValue(llvm::Value *value,
-                     const std::vector<llvm::Instruction *> &callHistory,
+                     const TxCallHistory *callHistory,
                      ref<Expr> valueExpr) {
     return registerNewTxStateValue(
         value,
@@ -214,7 +230,7 @@ class TxDependency {
   /// absolute address
   ref<TxStateValue>
   getNewPointerValue(llvm::Value *loc,
-                     const std::vector<llvm::Instruction *> &callHistory,
+                     const TxCallHistory *callHistory,
                      ref<Expr> address, uint64_t size) {
     ref<TxStateValue> vvalue =
         TxStateValue::create(store->getDepth(), loc, callHistory, address);
@@ -227,13 +243,13 @@ class TxDependency {
   /// copied from Executor::evalConstant.
   ref<TxStateValue>
   evalConstant(llvm::Constant *c,
-               const std::vector<llvm::Instruction *> &callHistory);
+               const TxCallHistory *callHistory);
 
   /// \brief Get a KLEE expression from a constant expression. This was
   /// shamelessly copied from Executor::evalConstantExpr.
   ref<TxStateValue>
   evalConstantExpr(llvm::ConstantExpr *ce,
-                   const std::vector<llvm::Instruction *> &callHistory);
+                   const TxCallHistory *callHistory);
 
   /// \brief Gets the latest version of the location, but without checking
   /// for whether the value is constant or not.
@@ -245,7 +261,7 @@ class TxDependency {
   /// one.
   inline ref<TxStateValue>
   createConstantValue(llvm::Value *value,
-                      const std::vector<llvm::Instruction *> &callHistory,
+                      const TxCallHistory *callHistory,
                       ref<Expr> expr);
 
   /// \brief Gets the latest pointer value for marking
@@ -273,7 +289,7 @@ class TxDependency {
   /// is checked for memory access validity at the current index, meaning that
   /// we assumed all memory access within the external function is valid.
   void addDependencyViaExternalFunction(
-      const std::vector<llvm::Instruction *> &callHistory,
+      const TxCallHistory *callHistory,
       ref<TxStateValue> source, ref<TxStateValue> target);
 
   /// \brief Add a flow dependency from a pointer value to a non-pointer
@@ -283,27 +299,13 @@ class TxDependency {
 
   /// \brief Record the expressions of a call's arguments
   void populateArgumentValuesList(
-      llvm::CallInst *site, const std::vector<llvm::Instruction *> &callHistory,
+      llvm::CallInst *site, const TxCallHistory *callHistory,
       std::vector<ref<Expr> > &arguments,
       std::vector<ref<TxStateValue> > &argumentValuesList);
 
-  void getStoredExpressions(
-      const TxStore *referenceStore,
-      const std::vector<llvm::Instruction *> &callHistory,
-      const std::map<ref<Expr>, ref<Expr> > &substitution,
-      std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
-      TxStore::TopStateStore &__internalStore,
-      TxStore::LowerStateStore &__concretelyAddressedHistoricalStore,
-      TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore) {
-    store->getStoredExpressions(
-        referenceStore, callHistory, substitution, replacements, coreOnly,
-        leftRetrieval, __internalStore, __concretelyAddressedHistoricalStore,
-        __symbolicallyAddressedHistoricalStore);
-  }
-
   void getStoredCoreExpressions(
       const TxStore *referenceStore,
-      const std::vector<llvm::Instruction *> &callHistory,
+      const TxCallHistory *callHistory,
       const std::map<ref<Expr>, ref<Expr> > &substitution,
       std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
       TxStore::TopInterpolantStore &concretelyAddressedStore,
@@ -324,6 +326,14 @@ public:
   /// \brief Flag to display debug information on the state.
   uint64_t debugStateLevel;
 
+  static void *operator new(size_t size) {
+    return TxArena::get(TxArena::Dependency).allocate(size);
+  }
+
+  static void operator delete(void *block, size_t size) {
+    TxArena::get(TxArena::Dependency).deallocate(block, size);
+  }
+
   TxDependency(TxDependency *parent, llvm::DataLayout *_targetData,
                std::map<const llvm::GlobalValue *, ref<ConstantExpr> > *
                    _globalAddresses);
@@ -332,52 +342,16 @@ public:
 
   TxDependency *cdr() const;
 
-  /// \brief This retrieves the locations known at this state, and the
-  /// expressions stored in the locations. Returns as the last argument a pair
-  /// of the store part indexed by constants, and the store part indexed by
-  /// symbolic expressions.
-  ///
-  /// \param callHistory The current call history context of the state
-  /// \param replacements The replacement bound variables when
-  /// retrieving state for creating subsumption table entry: As the
-  /// resulting expression will be used for storing in the
-  /// subsumption table, the variables need to be replaced with the
-  /// bound ones.
-  /// \param coreOnly Indicates whether we are retrieving only data
-  /// for locations relevant to an unsatisfiability core.
-  /// \param leftRetrieval Whether the retrieval is requested by the left
-  /// child of the store, otherwise, we assume it is requested by the right
-  /// child of the store.
-  /// \param [out] concretelyAddressedStore The output concretely-addressed
-  /// store.
-  /// \param [out] symbolicallyAddressedStore The output
-  /// symbolically-addressed store.
-  /// \param [out] concretelyAddressedHistoricalStore The output
-  /// concretely-addressed historical store, whose domain consists of
-  /// historical concrete addresses that are no longer valid due to exiting of
-  /// scope.
-  /// \param [out] symbolicallyAddressedHistoricalStore The output
-  /// symbolically-addressed historical store, whose domain consists of
-  /// historical symbolic addresses that are no longer valid due to exiting of
-  /// scope.
+  /// \brief A view of the store of the parent, seen from this node, for the
+  /// subsumption checks of the state at the start of this node: the
+  /// allocations to be checked are those of the parent, as the program point
+  /// of a node is the first instruction of a basic block.
   ///
-  /// \sa TxStore#getStoredExpressions()
-  void getParentStoredExpressions(
-      const std::vector<llvm::Instruction *> &callHistory,
-      const std::map<ref<Expr>, ref<Expr> > &substitution,
-      std::set<const Array *> &replacements, bool coreOnly, bool &leftRetrieval,
-      TxStore::TopStateStore &__internalStore,
-      TxStore::LowerStateStore &__concretelyAddressedHistoricalStore,
-      TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore) {
-    if (parent->left == this)
-      leftRetrieval = true;
-    else
-      assert(parent->right == this && "mismatched tree edge");
-
-    parent->getStoredExpressions(store, callHistory, substitution, replacements,
-                                 coreOnly, leftRetrieval, __internalStore,
-                                 __concretelyAddressedHistoricalStore,
-                                 __symbolicallyAddressedHistoricalStore);
+  /// \sa TxStore::StateView
+  TxStore::StateView getParentStoreView() const {
+    assert((parent->left == this || parent->right == this) &&
+           "mismatched tree edge");
+    return TxStore::StateView(parent->store, store);
   }
 
   /// \brief This retrieves the locations known at this state, and the
@@ -409,9 +383,9 @@ public:
   /// historical symbolic addresses that are no longer valid due to exiting of
   /// scope.
   ///
-  /// \sa TxStore#getStoredExpressions()
+  /// \sa TxStore#getStoredCoreExpressions()
   void getParentStoredCoreExpressions(
-      const std::vector<llvm::Instruction *> &callHistory,
+      const TxCallHistory *callHistory,
       const std::map<ref<Expr>, ref<Expr> > &substitution,
       std::set<const Array *> &replacements, bool coreOnly,
       TxStore::TopInterpolantStore &concretelyAddressedStore,
@@ -434,22 +408,22 @@ public:
 
   ref<TxStateValue>
   getLatestValue(llvm::Value *value,
-                 const std::vector<llvm::Instruction *> &callHistory,
+                 const TxCallHistory *callHistory,
                  ref<Expr> valueExpr, bool allowInconsistency = false);
 
   /// \brief Abstract dependency state transition with argument(s)
   void execute(llvm::Instruction *instr,
-               const std::vector<llvm::Instruction *> &callHistory,
+               const TxCallHistory *callHistory,
                std::vector<ref<Expr> > &args, bool symbolicExecutionError);
 
   /// \brief Execution of klee_make_symbolic
   void executeMakeSymbolic(llvm::Instruction *instr,
-                           const std::vector<llvm::Instruction *> &callHistory,
+                           const TxCallHistory *callHistory,
                            ref<Expr> address, const Array *array);
 
   /// \brief Build dependencies from PHI node
   void executePHI(llvm::Instruction *instr, unsigned int incomingBlock,
-                  const std::vector<llvm::Instruction *> &callHistory,
+                  const TxCallHistory *callHistory,
                   ref<Expr> valueExpr, bool symbolicExecutionError);
 
   /// \brief Execute memory operation (load/store). Returns true if memory
@@ -460,18 +434,18 @@ public:
   /// load / store instruction is processed.
   bool
   executeMemoryOperation(llvm::Instruction *instr,
-                         const std::vector<llvm::Instruction *> &callHistory,
+                         const TxCallHistory *callHistory,
                          std::vector<ref<Expr> > &args, bool inBounds,
                          bool symbolicExecutionError);
 
   /// \brief Record call arguments in a function call
   void bindCallArguments(llvm::Instruction *instr,
-                         std::vector<llvm::Instruction *> &callHistory,
+                         const TxCallHistory *&callHistory,
                          std::vector<ref<Expr> > &arguments);
 
   /// \brief This propagates the dependency due to the return value of a call
   void bindReturnValue(llvm::CallInst *site,
-                       std::vector<llvm::Instruction *> &callHistory,
+                       const TxCallHistory *&callHistory,
                        llvm::Instruction *inst, ref<Expr> returnValue);
 
   /// \brief Given an LLVM value and the expression it is associated with,
@@ -521,7 +495,7 @@ public:
   /// \brief Add constraint onto the path condition
   ref<TxPCConstraint>
   addConstraint(ref<Expr> constraint, llvm::Value *condition,
-                std::vector<llvm::Instruction *> &callHistory) {
+                const TxCallHistory *&callHistory) {
     return pathCondition->addConstraint(
         constraint, getLatestValue(condition, callHistory, constraint, true));
   }
@@ -545,6 +519,8 @@ public:
 
   TxStore *getStore() const { return store; }
 
+  TxPathCondition *getPathCondition() const { return pathCondition; }
+
   /// \brief Print the content of the object to the LLVM error stream
   void dump() const {
     this->print(llvm::errs());
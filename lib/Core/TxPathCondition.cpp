@@ -77,14 +77,16 @@ TxPathCondition::addConstraint(ref<Expr> constraint,
                                ref<TxStateValue> condition) {
   ref<TxPCConstraint> pcConstraint(
       new TxPCConstraint(constraint, condition, depth));
-  pcDepth[constraint] = pcConstraint;
+  pcDepth = pcDepth.replace(std::make_pair(constraint, pcConstraint));
   if (llvm::isa<OrExpr>(constraint)) {
     // FIXME: Break up disjunction into its components, because each disjunct is
     // solved separately. The or constraint was due to state merge. Hence, the
     // following is just a makeshift for when state merge is properly
     // implemented.
-    pcDepth[constraint->getKid(0)] = pcConstraint;
-    pcDepth[constraint->getKid(1)] = pcConstraint;
+    pcDepth =
+        pcDepth.replace(std::make_pair(constraint->getKid(0), pcConstraint));
+    pcDepth =
+        pcDepth.replace(std::make_pair(constraint->getKid(1), pcConstraint));
   }
   return pcConstraint;
 }
@@ -98,12 +100,11 @@ void TxPathCondition::unsatCoreInterpolation(
   for (std::vector<ref<Expr> >::const_iterator it = unsatCore.begin(),
                                                ie = unsatCore.end();
        it != ie; ++it) {
-    std::map<ref<Expr>, ref<TxPCConstraint> >::iterator pcDepthIter =
-        pcDepth.find(*it);
+    const PCDepthMap::value_type *pcDepthEntry = pcDepth.lookup(*it);
     // FIXME: Sometimes some constraints are not in the PC. This is
     // because constraints are not properly added at state merge.
-    if (pcDepthIter != pcDepth.end()) {
-      ref<TxPCConstraint> &pcConstraint = pcDepthIter->second;
+    if (pcDepthEntry) {
+      const ref<TxPCConstraint> &pcConstraint = pcDepthEntry->second;
       depthToConstraintSet[pcConstraint->getDepth()].insert(pcConstraint);
       keySet.insert(pcConstraint->getDepth());
 
@@ -206,9 +207,8 @@ void TxPathCondition::print(llvm::raw_ostream &stream,
   std::string tabsNext = appendTab(tabs);
 
   stream << tabs << "path condition = [";
-  for (std::map<ref<Expr>, ref<TxPCConstraint> >::const_iterator
-           is = pcDepth.begin(),
-           it = is, ie = pcDepth.end();
+  for (PCDepthMap::const_iterator is = pcDepth.begin(), it = is,
+                                  ie = pcDepth.end();
        it != ie; ++it) {
     if (it != is)
       stream << ",";
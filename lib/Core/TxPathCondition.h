@@ -18,6 +18,8 @@
 
 #include "klee/Constraints.h"
 #include "klee/util/TxPrintUtil.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+#include "klee/Internal/Module/TxArena.h"
 #include "klee/Internal/Module/TxValues.h"
 
 namespace klee {
@@ -27,6 +29,14 @@ class TxPCConstraint {
 public:
   unsigned refCount;
 
+  static void *operator new(size_t size) {
+    return TxArena::get(TxArena::PCConstraint).allocate(size);
+  }
+
+  static void operator delete(void *block, size_t size) {
+    TxArena::get(TxArena::PCConstraint).deallocate(block, size);
+  }
+
 private:
   /// \brief KLEE expression
   ref<Expr> constraint;
@@ -66,8 +76,22 @@ public:
 };
 
 class TxPathCondition {
+public:
+  static void *operator new(size_t size) {
+    return TxArena::get(TxArena::PathCondition).allocate(size);
+  }
+
+  static void operator delete(void *block, size_t size) {
+    TxArena::get(TxArena::PathCondition).deallocate(block, size);
+  }
+
+  /// \brief The type of the map from constraints to their depth records. The
+  /// map is persistent, so that a child shares its parent's constraints.
+  typedef ImmutableMap<ref<Expr>, ref<TxPCConstraint> > PCDepthMap;
+
+private:
   /// \brief The path condition, with the levels each one is introduced
-  std::map<ref<Expr>, ref<TxPCConstraint> > pcDepth;
+  PCDepthMap pcDepth;
 
   /// \brief Store elements used by left path
   std::set<ref<TxPCConstraint> > usedByLeftPath;
@@ -93,6 +117,7 @@ public:
       return ret;
     }
     ret->depth = src->depth + 1;
+    // Shares the root of the parent's persistent map; no copying is done
     ret->pcDepth = src->pcDepth;
     ret->parent = src;
     return ret;
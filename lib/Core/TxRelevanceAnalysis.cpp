@@ -0,0 +1,173 @@
+//===-- TxRelevanceAnalysis.cpp ---------------------------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementations for the static analysis of the
+/// allocations that may still be read downstream of a program point, with
+/// which the store cells that can no longer be read are dropped from the
+/// subsumption table entries.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TxRelevanceAnalysis.h"
+
+#include "klee/CommandLine.h"
+#include "klee/Internal/Module/KModule.h"
+
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+#include <llvm/Support/CFG.h>
+#else
+#include <llvm/IR/CFG.h>
+#endif
+
+#include <vector>
+
+using namespace klee;
+
+namespace klee {
+
+std::map<const llvm::BasicBlock *, std::set<const llvm::Value *> >
+TxRelevanceAnalysis::irrelevantAllocations;
+
+uint64_t TxRelevanceAnalysis::allocaCount = 0;
+
+uint64_t TxRelevanceAnalysis::nonEscapingAllocaCount = 0;
+
+uint64_t TxRelevanceAnalysis::droppedCellCount = 0;
+
+bool
+TxRelevanceAnalysis::getUseBlocks(llvm::AllocaInst *alloca,
+                                  std::set<llvm::BasicBlock *> &useBlocks) {
+  std::vector<llvm::Value *> addresses(1, alloca);
+  std::vector<llvm::Instruction *> loadedValues;
+
+  // The address and the pointers derived from it may only be dereferenced
+  while (!addresses.empty()) {
+    llvm::Value *address = addresses.back();
+    addresses.pop_back();
+
+    for (llvm::Value::use_iterator it = address->use_begin(),
+                                   ie = address->use_end();
+         it != ie; ++it) {
+      if (llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(*it)) {
+        loadedValues.push_back(load);
+      } else if (llvm::StoreInst *store =
+                     llvm::dyn_cast<llvm::StoreInst>(*it)) {
+        if (store->getValueOperand() == address)
+          return false;
+      } else if (llvm::isa<llvm::GetElementPtrInst>(*it) ||
+                 llvm::isa<llvm::BitCastInst>(*it)) {
+        addresses.push_back(*it);
+      } else {
+        return false;
+      }
+    }
+  }
+
+  // The loaded values are read wherever they are used, transitively, until
+  // they are stored to memory, whose store cells are analyzed on their own
+  std::set<llvm::Instruction *> visited;
+  while (!loadedValues.empty()) {
+    llvm::Instruction *value = loadedValues.back();
+    loadedValues.pop_back();
+
+    if (!visited.insert(value).second)
+      continue;
+
+    useBlocks.insert(value->getParent());
+
+    if (llvm::isa<llvm::StoreInst>(value))
+      continue;
+
+    for (llvm::Value::use_iterator it = value->use_begin(),
+                                   ie = value->use_end();
+         it != ie; ++it) {
+      if (llvm::Instruction *user = llvm::dyn_cast<llvm::Instruction>(*it))
+        loadedValues.push_back(user);
+    }
+  }
+
+  return true;
+}
+
+void TxRelevanceAnalysis::analyze(llvm::Function *f) {
+  for (llvm::Function::iterator bbit = f->begin(), bbie = f->end();
+       bbit != bbie; ++bbit) {
+    for (llvm::BasicBlock::iterator it = bbit->begin(), ie = bbit->end();
+         it != ie; ++it) {
+      llvm::AllocaInst *alloca = llvm::dyn_cast<llvm::AllocaInst>(&*it);
+      if (!alloca)
+        continue;
+
+      ++allocaCount;
+
+      std::set<llvm::BasicBlock *> useBlocks;
+      if (!getUseBlocks(alloca, useBlocks))
+        continue;
+
+      ++nonEscapingAllocaCount;
+
+      // The blocks from which a use of the alloca is reachable
+      std::set<llvm::BasicBlock *> relevantBlocks;
+      std::vector<llvm::BasicBlock *> worklist(useBlocks.begin(),
+                                               useBlocks.end());
+      while (!worklist.empty()) {
+        llvm::BasicBlock *bb = worklist.back();
+        worklist.pop_back();
+
+        if (!relevantBlocks.insert(bb).second)
+          continue;
+
+        for (llvm::pred_iterator predIt = llvm::pred_begin(bb),
+                                 predIe = llvm::pred_end(bb);
+             predIt != predIe; ++predIt) {
+          worklist.push_back(*predIt);
+        }
+      }
+
+      for (llvm::Function::iterator bbit1 = f->begin(), bbie1 = f->end();
+           bbit1 != bbie1; ++bbit1) {
+        if (!relevantBlocks.count(&*bbit1))
+          irrelevantAllocations[&*bbit1].insert(alloca);
+      }
+    }
+  }
+}
+
+void TxRelevanceAnalysis::initialize(KModule *kmodule) {
+#ifdef ENABLE_Z3
+  if (!StoreRelevanceAnalysis)
+    return;
+
+  for (std::vector<KFunction *>::iterator it = kmodule->functions.begin(),
+                                          ie = kmodule->functions.end();
+       it != ie; ++it) {
+    analyze((*it)->function);
+  }
+#endif
+}
+
+bool TxRelevanceAnalysis::isIrrelevant(uintptr_t programPoint,
+                                       const llvm::Value *allocation) {
+  const llvm::BasicBlock *bb =
+      reinterpret_cast<llvm::Instruction *>(programPoint)->getParent();
+
+  std::map<const llvm::BasicBlock *,
+           std::set<const llvm::Value *> >::const_iterator it =
+      irrelevantAllocations.find(bb);
+  return it != irrelevantAllocations.end() && it->second.count(allocation);
+}
+
+void TxRelevanceAnalysis::printStat(std::stringstream &stream) {
+  stream << "KLEE: done:     Allocas without escaping address (analyzed) = "
+         << nonEscapingAllocaCount << " (" << allocaCount << ")\n";
+  stream << "KLEE: done:     Store cells dropped from table entries as never "
+            "read again = " << droppedCellCount << "\n";
+}
+}
@@ -0,0 +1,86 @@
+//===--- TxRelevanceAnalysis.h ----------------------------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the declarations for the static analysis of the
+/// allocations that may still be read downstream of a program point, with
+/// which the store cells that can no longer be read are dropped from the
+/// subsumption table entries.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_TXRELEVANCEANALYSIS_H
+#define KLEE_TXRELEVANCEANALYSIS_H
+
+#include "klee/Config/Version.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#else
+#include <llvm/BasicBlock.h>
+#include <llvm/Function.h>
+#include <llvm/Instructions.h>
+#endif
+
+#include <map>
+#include <set>
+#include <sstream>
+
+namespace klee {
+
+class KModule;
+
+/// \brief The allocations of the module that may still be read downstream of
+/// each basic block.
+///
+/// The analysis is restricted to the allocas whose address does not escape
+/// their function: they are read only by the loads on their address in the
+/// function, and the loaded values are carried in registers to their uses,
+/// or stored to other memory. An alloca is irrelevant at a basic block when
+/// none of its loads, nor any transitive use of the loaded values, is
+/// reachable from the block. The store cells of an irrelevant alloca, in the
+/// frame of the program point, cannot influence the rest of the execution,
+/// hence they are dropped from the tabled stores with
+/// -store-relevance-analysis. All other allocations are kept.
+class TxRelevanceAnalysis {
+  /// \brief The allocas that cannot be read downstream of each basic block
+  static std::map<const llvm::BasicBlock *, std::set<const llvm::Value *> >
+  irrelevantAllocations;
+
+  /// \brief Collects the blocks of the loads on the address of the alloca,
+  /// and of the transitive uses of the loaded values.
+  ///
+  /// \return false if the address escapes, true otherwise.
+  static bool getUseBlocks(llvm::AllocaInst *alloca,
+                           std::set<llvm::BasicBlock *> &useBlocks);
+
+  static void analyze(llvm::Function *f);
+
+public:
+  /// \brief Numbers of the allocas analyzed, of those whose address does not
+  /// escape, and of the store cells dropped from the tabled stores
+  static uint64_t allocaCount;
+  static uint64_t nonEscapingAllocaCount;
+  static uint64_t droppedCellCount;
+
+  /// \brief Analyzes the functions of the module
+  static void initialize(KModule *kmodule);
+
+  /// \brief Returns true if the allocation, in the stack frame of the program
+  /// point, cannot be read downstream of the program point
+  static bool isIrrelevant(uintptr_t programPoint,
+                           const llvm::Value *allocation);
+
+  static void printStat(std::stringstream &stream);
+};
+}
+
+#endif
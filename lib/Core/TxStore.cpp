@@ -17,6 +17,7 @@
 #include "TxStore.h"
 
 #include "klee/CommandLine.h"
+#include "klee/TimerStatIncrementer.h"
 #include "klee/Internal/Module/TxValues.h"
 #include "klee/util/TxPrintUtil.h"
 
@@ -29,33 +30,40 @@ TxStore::MiddleStateStore::find(ref<TxStateAddress> loc) const {
   ref<TxStoreEntry> ret;
 
   if (loc->hasConstantAddress()) {
-    TxStore::LowerStateStore::const_iterator lowerStoreIter =
-        concretelyAddressedStore.find(loc->getAsVariable());
+    const TxStore::LowerStateStore::value_type *lowerStoreEntry =
+        concretelyAddressedStore.lookup(loc->getAsVariable());
 
-    if (lowerStoreIter != concretelyAddressedStore.end()) {
-      ret = lowerStoreIter->second;
+    if (lowerStoreEntry) {
+      ret = lowerStoreEntry->second;
     }
   } else {
-    TxStore::LowerStateStore::const_iterator lowerStoreIter =
-        symbolicallyAddressedStore.find(loc->getAsVariable());
-    if (lowerStoreIter != symbolicallyAddressedStore.end()) {
-      ret = lowerStoreIter->second;
+    const TxStore::LowerStateStore::value_type *lowerStoreEntry =
+        symbolicallyAddressedStore.lookup(loc->getAsVariable());
+    if (lowerStoreEntry) {
+      ret = lowerStoreEntry->second;
     }
   }
 
   return ret;
 }
 
+ref<TxStoreEntry>
+TxStore::MiddleStateStore::findConcrete(ref<TxVariable> var) const {
+  ref<TxStoreEntry> ret;
+  const TxStore::LowerStateStore::value_type *lowerStoreEntry =
+      concretelyAddressedStore.lookup(var);
+  if (lowerStoreEntry) {
+    ret = lowerStoreEntry->second;
+  }
+  return ret;
+}
+
 ref<TxStoreEntry> TxStore::MiddleStateStore::findConcrete(
     ref<TxVariable> var,
     std::map<ref<TxAllocationInfo>, ref<TxAllocationInfo> > &unifiedBases)
     const {
-  ref<TxStoreEntry> ret;
-  TxStore::LowerStateStore::const_iterator lowerStoreIter =
-      concretelyAddressedStore.find(var);
-  if (lowerStoreIter != concretelyAddressedStore.end()) {
-    ret = lowerStoreIter->second;
-  } else {
+  ref<TxStoreEntry> ret = findConcrete(var);
+  if (ret.isNull()) {
     for (TxStore::LowerStateStore::const_iterator
              it = concretelyAddressedStore.begin(),
              ie = concretelyAddressedStore.end();
@@ -75,10 +83,10 @@ ref<TxStoreEntry> TxStore::MiddleStateStore::findConcrete(
 ref<TxStoreEntry>
 TxStore::MiddleStateStore::findSymbolic(ref<TxVariable> var) const {
   ref<TxStoreEntry> ret;
-  TxStore::LowerStateStore::const_iterator lowerStoreIter =
-      symbolicallyAddressedStore.find(var);
-  if (lowerStoreIter != symbolicallyAddressedStore.end()) {
-    ret = lowerStoreIter->second;
+  const TxStore::LowerStateStore::value_type *lowerStoreEntry =
+      symbolicallyAddressedStore.lookup(var);
+  if (lowerStoreEntry) {
+    ret = lowerStoreEntry->second;
   }
   return ret;
 }
@@ -94,9 +102,11 @@ ref<TxStoreEntry> TxStore::MiddleStateStore::updateStore(
 
   ret = ref<TxStoreEntry>(new TxStoreEntry(loc, address, value, store, _depth));
   if (loc->hasConstantAddress()) {
-    concretelyAddressedStore[loc->getAsVariable()] = ret;
+    concretelyAddressedStore = concretelyAddressedStore.replace(
+        std::make_pair(loc->getAsVariable(), ret));
   } else {
-    symbolicallyAddressedStore[loc->getAsVariable()] = ret;
+    symbolicallyAddressedStore = symbolicallyAddressedStore.replace(
+        std::make_pair(loc->getAsVariable(), ret));
   }
   return ret;
 }
@@ -151,6 +161,53 @@ void TxStore::MiddleStateStore::print(llvm::raw_ostream &stream,
 
 /**/
 
+const TxStore::MiddleStateStore *
+TxStore::StateView::find(ref<TxAllocationContext> context) const {
+  if (!contents)
+    return 0;
+  const TopStateStore::value_type *entry =
+      contents->internalStore.lookup(context);
+  return entry ? &entry->second : 0;
+}
+
+ref<TxStoreEntry>
+TxStore::StateView::findConcreteHistorical(ref<TxVariable> variable) const {
+  if (!contents)
+    return ref<TxStoreEntry>();
+  const LowerStateStore::value_type *entry =
+      contents->concretelyAddressedHistoricalStore.lookup(variable);
+  return entry ? entry->second : ref<TxStoreEntry>();
+}
+
+ref<TxStoreEntry>
+TxStore::StateView::findSymbolicHistorical(ref<TxVariable> variable) const {
+  if (!contents)
+    return ref<TxStoreEntry>();
+  const LowerStateStore::value_type *entry =
+      contents->symbolicallyAddressedHistoricalStore.lookup(variable);
+  return entry ? entry->second : ref<TxStoreEntry>();
+}
+
+bool TxStore::StateView::isInLeftSubtree(uint64_t targetDepth) const {
+  if (reference->depth == targetDepth)
+    return false;
+
+  assert(reference->depth > targetDepth &&
+         "entry should have been defined in an ancestor node");
+
+  if (leftAtDepth.size() < reference->depth)
+    leftAtDepth.resize(reference->depth);
+
+  // The side of the child at each depth up to the target is recorded, as in
+  // TxStore::isInLeftSubtree, which returns the side of the child at the
+  // depth of the target.
+  while (cursor->depth > targetDepth) {
+    leftAtDepth[cursor->depth - 1] = (cursor == cursor->parent->left);
+    cursor = cursor->parent;
+  }
+  return leftAtDepth[targetDepth];
+}
+
 bool TxStore::isInLeftSubtree(uint64_t targetDepth) const {
   const TxStore *current = this;
   bool inLeftSubtree = false;
@@ -175,8 +232,8 @@ bool TxStore::isInLeftSubtree(uint64_t targetDepth) const {
 
 bool TxStore::adjustOffsetBound(ref<TxStoreEntry> entry, bool leftMarking,
                                 ref<TxStateValue> checkedAddress,
-                                std::set<uint64_t> &bounds,
-                                const std::string &reason, bool &boundUpdated) {
+                                std::set<uint64_t> &bounds, unsigned reason,
+                                bool &boundUpdated) {
   bool memoryError = false;
   if (entry->canInterpolateBound(leftMarking)) {
     memoryError = entry->getPointerInfo(leftMarking)
@@ -194,32 +251,19 @@ bool TxStore::adjustOffsetBound(ref<TxStoreEntry> entry, bool leftMarking,
 }
 
 ref<TxStoreEntry> TxStore::find(ref<TxStateAddress> loc) const {
-  TopStateStore::const_iterator storeIter =
-      internalStore.find(loc->getContext());
-  if (storeIter != internalStore.end()) {
-    return storeIter->second.find(loc);
+  const TopStateStore::value_type *middleStoreEntry =
+      internalStore.lookup(loc->getContext());
+  if (middleStoreEntry) {
+    return middleStoreEntry->second.find(loc);
   }
 
   ref<TxStoreEntry> nullEntry;
   return nullEntry;
 }
 
-void TxStore::getStoredExpressions(
-    const TxStore *referenceStore,
-    const std::vector<llvm::Instruction *> &callHistory,
-    const std::map<ref<Expr>, ref<Expr> > &substitution,
-    std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
-    TopStateStore &__internalStore,
-    LowerStateStore &__concretelyAddressedHistoricalStore,
-    LowerStateStore &__symbolicallyAddressedHistoricalStore) const {
-  __internalStore = internalStore;
-  __concretelyAddressedHistoricalStore = concretelyAddressedHistoricalStore;
-  __symbolicallyAddressedHistoricalStore = symbolicallyAddressedHistoricalStore;
-}
-
 void TxStore::getStoredCoreExpressions(
     const TxStore *referenceStore,
-    const std::vector<llvm::Instruction *> &callHistory,
+    const TxCallHistory *callHistory,
     const std::map<ref<Expr>, ref<Expr> > &substitution,
     std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
     TopInterpolantStore &_concretelyAddressedStore,
@@ -306,7 +350,7 @@ inline void TxStore::symbolicToInterpolant(
 
 void TxStore::getConcreteStore(
     const TxStore *referenceStore,
-    const std::vector<llvm::Instruction *> &callHistory,
+    const TxCallHistory *callHistory,
     const std::map<ref<Expr>, ref<Expr> > &substitution,
     std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
     TopInterpolantStore &_concretelyAddressedStore,
@@ -361,7 +405,7 @@ void TxStore::getConcreteStore(
 
 void TxStore::getSymbolicStore(
     const TxStore *referenceStore,
-    const std::vector<llvm::Instruction *> &callHistory,
+    const TxCallHistory *callHistory,
     const std::map<ref<Expr>, ref<Expr> > &substitution,
     std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
     TopInterpolantStore &_symbolicallyAddressedStore,
@@ -433,11 +477,13 @@ void TxStore::updateStore(
   markUsed(value->getAllowBoundEntryList());
   markUsed(value->getDisableBoundEntryList());
 
-  TopStateStore::iterator middleStoreIter =
-      internalStore.find(location->getContext());
+  const TopStateStore::value_type *middleStoreEntry =
+      internalStore.lookup(location->getContext());
 
-  if (middleStoreIter != internalStore.end()) {
-    MiddleStateStore &middleStore = middleStoreIter->second;
+  if (middleStoreEntry) {
+    // The middle store is copied, as the one in the map may be shared with
+    // the ancestor stores. The copy only shares the roots of the lower maps.
+    MiddleStateStore middleStore(middleStoreEntry->second);
     if (middleStore.hasAllocationInfo(location->getAllocationInfo())) {
       if (value->getDepth() < depth) {
         value = value->copy(depth);
@@ -446,6 +492,9 @@ void TxStore::updateStore(
       ref<TxStoreEntry> entry =
           middleStore.updateStore(this, location, address, value, depth);
       if (!entry.isNull()) {
+        internalStore = internalStore.replace(
+            std::make_pair(location->getContext(), middleStore));
+
         // We want to renew the table entry list, so we first remove the old
         // ones
         value->resetStoreEntryList();
@@ -458,22 +507,32 @@ void TxStore::updateStore(
       return;
     }
 
-    // Here we save the old store
-    concretelyAddressedHistoricalStore.insert(middleStore.concreteBegin(),
-                                              middleStore.concreteEnd());
-    symbolicallyAddressedHistoricalStore.insert(middleStore.symbolicBegin(),
-                                                middleStore.symbolicEnd());
+    // Here we save the old store. As with std::map::insert, existing
+    // historical entries are not overwritten.
+    for (LowerStateStore::const_iterator it = middleStore.concreteBegin(),
+                                         ie = middleStore.concreteEnd();
+         it != ie; ++it) {
+      concretelyAddressedHistoricalStore =
+          concretelyAddressedHistoricalStore.insert(*it);
+    }
+    for (LowerStateStore::const_iterator it = middleStore.symbolicBegin(),
+                                         ie = middleStore.symbolicEnd();
+         it != ie; ++it) {
+      symbolicallyAddressedHistoricalStore =
+          symbolicallyAddressedHistoricalStore.insert(*it);
+    }
   }
 
-  MiddleStateStore newMiddleStateStore(location->getAllocationInfo());
-  internalStore[location->getContext()] = newMiddleStateStore;
-  MiddleStateStore &middleStateStore = internalStore[location->getContext()];
+  MiddleStateStore middleStateStore(location->getAllocationInfo());
   if (value->getDepth() < depth) {
     value = value->copy(depth);
     valuesMap[value->getValue()].push_back(value);
   }
   ref<TxStoreEntry> entry =
       middleStateStore.updateStore(this, location, address, value, depth);
+  internalStore = internalStore.replace(
+      std::make_pair(location->getContext(), middleStateStore));
+  contextSignature |= location->getContext()->getSignature();
   if (!entry.isNull()) {
     // We associate this value with the store entry, signifying that the entry
     // is important whenever the value is used. This is used for computing the
@@ -528,168 +587,150 @@ void TxStore::markUsed(const std::set<ref<TxStoreEntry> > &entryList) {
   }
 }
 
-void TxStore::recursivelyMarkFlow(ref<TxStoreEntry> entry, bool leftMarking,
-                                  const std::string &reason) const {
-  if (entry.isNull())
-    return;
+uint64_t TxStore::markingEpoch = 0;
 
-  if (entry->isCore(leftMarking)) {
-    if (!entry->canInterpolateBound(leftMarking))
-      return;
-  }
+uint64_t TxStore::markingVisitCount = 0;
 
-  entry->setAsCore(leftMarking, reason);
-  entry->disableBoundInterpolation(leftMarking);
+Statistic TxStore::markingTime("MarkingTime", "MarkingTime");
 
-  std::map<ref<TxStoreEntry>, bool> &allowBoundEntryList(
-      entry->getAllowBoundEntryList());
-  for (std::map<ref<TxStoreEntry>, bool>::iterator
-           it = allowBoundEntryList.begin(),
-           ie = allowBoundEntryList.end();
+void
+TxStore::pushMarkingItems(std::vector<MarkingItem> &worklist,
+                          const std::map<ref<TxStoreEntry>, bool> &entries,
+                          bool pointerFlow) {
+  for (std::map<ref<TxStoreEntry>, bool>::const_reverse_iterator
+           it = entries.rbegin(),
+           ie = entries.rend();
        it != ie; ++it) {
-    recursivelyMarkFlow(it->first, it->second, reason);
+    worklist.push_back(MarkingItem(
+        it->first, it->second, pointerFlow && it->first->isPointer()));
   }
+}
 
-  std::map<ref<TxStoreEntry>, bool> &disableBoundEntryList(
-      entry->getDisableBoundEntryList());
-  for (std::map<ref<TxStoreEntry>, bool>::iterator
-           it = disableBoundEntryList.begin(),
-           ie = disableBoundEntryList.end();
-       it != ie; ++it) {
-    recursivelyMarkFlow(it->first, it->second, reason);
+bool TxStore::markEntries(std::vector<MarkingItem> &worklist,
+                          ref<TxStateValue> checkedAddress,
+                          std::set<uint64_t> &bounds, unsigned reason) const {
+  TimerStatIncrementer t(markingTime);
+  bool memoryError = false;
+  uint64_t epoch = ++markingEpoch;
+
+  while (!worklist.empty()) {
+    MarkingItem item = worklist.back();
+    worklist.pop_back();
+
+    ref<TxStoreEntry> entry = item.entry;
+    if (entry.isNull() ||
+        !entry->stampMarkingEpoch(item.leftMarking, item.pointerFlow, epoch))
+      continue;
+
+    ++markingVisitCount;
+
+    if (!item.pointerFlow) {
+      if (entry->isCore(item.leftMarking) &&
+          !entry->canInterpolateBound(item.leftMarking))
+        continue;
+
+      entry->setAsCore(item.leftMarking, reason);
+      entry->disableBoundInterpolation(item.leftMarking);
+
+      pushMarkingItems(worklist, entry->getDisableBoundEntryList(), false);
+      pushMarkingItems(worklist, entry->getAllowBoundEntryList(), false);
+      continue;
+    }
+
+    bool entryMemoryError = false;
+    bool boundUpdated = false;
+
+    if (entry->getDepth() == depth) {
+      if (adjustOffsetBound(entry, true, checkedAddress, bounds, reason,
+                            boundUpdated))
+        entryMemoryError = true;
+      if (adjustOffsetBound(entry, false, checkedAddress, bounds, reason,
+                            boundUpdated))
+        entryMemoryError = true;
+    } else if (adjustOffsetBound(entry, item.leftMarking, checkedAddress,
+                                 bounds, reason, boundUpdated)) {
+      entryMemoryError = true;
+    }
+
+    // The entries of the disable list are visited after those of the allow
+    // list, hence they are pushed first.
+    pushMarkingItems(worklist, entry->getDisableBoundEntryList(), false);
+    if (entryMemoryError) {
+      memoryError = true;
+      pushMarkingItems(worklist, entry->getAllowBoundEntryList(), false);
+    } else if (boundUpdated) {
+      pushMarkingItems(worklist, entry->getAllowBoundEntryList(), true);
+    }
   }
+
+  return memoryError;
 }
 
 void TxStore::markFlow(ref<TxStateValue> target,
-                       const std::string &reason) const {
+                       const std::string &reasonText) const {
   if (target.isNull())
     return;
 
-  const std::set<ref<TxStoreEntry> > &allowBoundEntryList(
-      target->getAllowBoundEntryList());
-  for (std::set<ref<TxStoreEntry> >::const_iterator
-           it = allowBoundEntryList.begin(),
-           ie = allowBoundEntryList.end();
-       it != ie; ++it) {
-    recursivelyMarkFlow(*it, isInLeftSubtree((*it)->getDepth()), reason);
-  }
+  unsigned reason = TxCoreReasons::intern(reasonText);
+
+  std::vector<MarkingItem> worklist;
 
   const std::set<ref<TxStoreEntry> > &disableBoundEntryList(
       target->getDisableBoundEntryList());
-  for (std::set<ref<TxStoreEntry> >::const_iterator
-           it = disableBoundEntryList.begin(),
-           ie = disableBoundEntryList.end();
+  for (std::set<ref<TxStoreEntry> >::const_reverse_iterator
+           it = disableBoundEntryList.rbegin(),
+           ie = disableBoundEntryList.rend();
        it != ie; ++it) {
-    recursivelyMarkFlow(*it, isInLeftSubtree((*it)->getDepth()), reason);
-  }
-}
-
-bool TxStore::recursivelyMarkPointerFlow(ref<TxStoreEntry> entry,
-                                         bool leftMarking,
-                                         ref<TxStateValue> checkedAddress,
-                                         std::set<uint64_t> &bounds,
-                                         const std::string &reason,
-                                         uint64_t startingDepth) const {
-  bool memoryError = false;
-  bool boundUpdated = false;
-
-  if (entry.isNull())
-    return memoryError;
-
-  if (entry->getDepth() == startingDepth) {
-    memoryError = adjustOffsetBound(entry, true, checkedAddress, bounds, reason,
-                                    boundUpdated)
-                      ? true
-                      : memoryError;
-    memoryError = adjustOffsetBound(entry, false, checkedAddress, bounds,
-                                    reason, boundUpdated)
-                      ? true
-                      : memoryError;
-  } else {
-    memoryError = adjustOffsetBound(entry, leftMarking, checkedAddress, bounds,
-                                    reason, boundUpdated)
-                      ? true
-                      : memoryError;
+    worklist.push_back(
+        MarkingItem(*it, isInLeftSubtree((*it)->getDepth()), false));
   }
 
-  if (memoryError) {
-    std::map<ref<TxStoreEntry>, bool> &allowBoundEntryList(
-        entry->getAllowBoundEntryList());
-    for (std::map<ref<TxStoreEntry>, bool>::iterator
-             it = allowBoundEntryList.begin(),
-             ie = allowBoundEntryList.end();
-         it != ie; ++it) {
-      recursivelyMarkFlow(it->first, it->second, reason);
-    }
-  } else {
-    if (boundUpdated) {
-      std::map<ref<TxStoreEntry>, bool> &allowBoundEntryList(
-          entry->getAllowBoundEntryList());
-      for (std::map<ref<TxStoreEntry>, bool>::iterator
-               it = allowBoundEntryList.begin(),
-               ie = allowBoundEntryList.end();
-           it != ie; ++it) {
-        if (!it->first->isPointer()) {
-          recursivelyMarkFlow(it->first, it->second, reason);
-        } else {
-          memoryError =
-              recursivelyMarkPointerFlow(it->first, it->second, checkedAddress,
-                                         bounds, reason, startingDepth)
-                  ? true
-                  : memoryError;
-        }
-      }
-    }
-  }
-
-  std::map<ref<TxStoreEntry>, bool> &disableBoundEntryList(
-      entry->getDisableBoundEntryList());
-  for (std::map<ref<TxStoreEntry>, bool>::iterator
-           it = disableBoundEntryList.begin(),
-           ie = disableBoundEntryList.end();
+  const std::set<ref<TxStoreEntry> > &allowBoundEntryList(
+      target->getAllowBoundEntryList());
+  for (std::set<ref<TxStoreEntry> >::const_reverse_iterator
+           it = allowBoundEntryList.rbegin(),
+           ie = allowBoundEntryList.rend();
        it != ie; ++it) {
-    recursivelyMarkFlow(it->first, it->second, reason);
+    worklist.push_back(
+        MarkingItem(*it, isInLeftSubtree((*it)->getDepth()), false));
   }
 
-  return memoryError;
+  std::set<uint64_t> bounds;
+  markEntries(worklist, ref<TxStateValue>(), bounds, reason);
 }
 
 bool TxStore::markPointerFlow(ref<TxStateValue> target,
                               ref<TxStateValue> checkedAddress,
                               std::set<uint64_t> &bounds,
-                              const std::string &reason) const {
-  bool memoryError = false;
-
+                              const std::string &reasonText) const {
   if (target.isNull())
-    return memoryError;
+    return false;
 
-  const std::set<ref<TxStoreEntry> > &allowBoundEntryList(
-      target->getAllowBoundEntryList());
-  for (std::set<ref<TxStoreEntry> >::const_iterator
-           it = allowBoundEntryList.begin(),
-           ie = allowBoundEntryList.end();
-       it != ie; ++it) {
-    if (!(*it)->isPointer()) {
-      recursivelyMarkFlow(*it, isInLeftSubtree((*it)->getDepth()), reason);
-    } else {
-      memoryError =
-          recursivelyMarkPointerFlow(*it, isInLeftSubtree((*it)->getDepth()),
-                                     checkedAddress, bounds, reason, depth)
-              ? true
-              : memoryError;
-    }
-  }
+  unsigned reason = TxCoreReasons::intern(reasonText);
+
+  std::vector<MarkingItem> worklist;
 
   const std::set<ref<TxStoreEntry> > &disableBoundEntryList(
       target->getDisableBoundEntryList());
-  for (std::set<ref<TxStoreEntry> >::const_iterator
-           it = disableBoundEntryList.begin(),
-           ie = disableBoundEntryList.end();
+  for (std::set<ref<TxStoreEntry> >::const_reverse_iterator
+           it = disableBoundEntryList.rbegin(),
+           ie = disableBoundEntryList.rend();
        it != ie; ++it) {
-    recursivelyMarkFlow(*it, isInLeftSubtree((*it)->getDepth()), reason);
+    worklist.push_back(
+        MarkingItem(*it, isInLeftSubtree((*it)->getDepth()), false));
   }
 
-  return memoryError;
+  const std::set<ref<TxStoreEntry> > &allowBoundEntryList(
+      target->getAllowBoundEntryList());
+  for (std::set<ref<TxStoreEntry> >::const_reverse_iterator
+           it = allowBoundEntryList.rbegin(),
+           ie = allowBoundEntryList.rend();
+       it != ie; ++it) {
+    worklist.push_back(MarkingItem(*it, isInLeftSubtree((*it)->getDepth()),
+                                   (*it)->isPointer()));
+  }
+
+  return markEntries(worklist, checkedAddress, bounds, reason);
 }
 
 /// \brief Print the content of the object to the LLVM error stream
@@ -17,10 +17,13 @@
 #ifndef KLEE_TXSTORE_H
 #define KLEE_TXSTORE_H
 
+#include "klee/Internal/ADT/ImmutableMap.h"
 #include "klee/Internal/Module/TxValues.h"
+#include "klee/Statistic.h"
 #include "klee/util/Ref.h"
 
 #include <map>
+#include <vector>
 
 namespace klee {
 
@@ -28,12 +31,21 @@ class TxStore {
 public:
   class MiddleStateStore;
 
+  class StateView;
+
+  friend class StateView;
+
   typedef std::map<ref<TxVariable>, ref<TxInterpolantValue> >
   LowerInterpolantStore;
   typedef std::map<ref<TxAllocationContext>, LowerInterpolantStore>
   TopInterpolantStore;
-  typedef std::map<ref<TxVariable>, ref<TxStoreEntry> > LowerStateStore;
-  typedef std::map<ref<TxAllocationContext>, MiddleStateStore> TopStateStore;
+
+  /// \brief The state stores are persistent (immutable) maps, so that a store
+  /// created for a child node shares all unchanged entries with the store of
+  /// its parent, and a split costs constant time regardless of store size.
+  typedef ImmutableMap<ref<TxVariable>, ref<TxStoreEntry> > LowerStateStore;
+  typedef ImmutableMap<ref<TxAllocationContext>, MiddleStateStore>
+  TopStateStore;
 
   class MiddleStateStore {
   private:
@@ -78,6 +90,10 @@ public:
 
     ref<TxStoreEntry> find(ref<TxStateAddress> loc) const;
 
+    /// \brief Finds the concretely-addressed entry of exactly the given
+    /// variable, without translating allocation bases.
+    ref<TxStoreEntry> findConcrete(ref<TxVariable> var) const;
+
     ref<TxStoreEntry> findConcrete(
         ref<TxVariable> var,
         std::map<ref<TxAllocationInfo>, ref<TxAllocationInfo> > &unifiedBases)
@@ -108,6 +124,51 @@ public:
     void print(llvm::raw_ostream &stream, const std::string &prefix) const;
   };
 
+  /// \brief A read-only view of the store of a node, for the subsumption
+  /// checks of a state, in place of copies of the store maps.
+  ///
+  /// The allocation contexts and the variables are looked up on demand, and
+  /// whether an entry is seen from the left or the right subtree of the node
+  /// that defined it is computed once per depth, by a single walk up from the
+  /// store of the state that goes only as high as the entries looked up. The
+  /// cost of a check is thus in the number of table entry cells examined,
+  /// rather than in the size of the state store.
+  class StateView {
+    /// \brief The store whose entries are viewed, null for none
+    const TxStore *contents;
+
+    /// \brief The store of the state, from which the entries are seen
+    const TxStore *reference;
+
+    /// \brief The highest ancestor of the reference store whose side is
+    /// known
+    mutable const TxStore *cursor;
+
+    /// \brief Whether the path to the reference store goes to the left
+    /// child at each depth from that of the cursor
+    mutable std::vector<bool> leftAtDepth;
+
+  public:
+    StateView(const TxStore *_contents, const TxStore *_reference)
+        : contents(_contents), reference(_reference), cursor(_reference) {}
+
+    /// \brief The entries of an allocation context, or null if the context
+    /// is not in the store
+    const MiddleStateStore *find(ref<TxAllocationContext> context) const;
+
+    /// \brief The historical concretely-addressed entry of a variable, or
+    /// null if none
+    ref<TxStoreEntry> findConcreteHistorical(ref<TxVariable> variable) const;
+
+    /// \brief The historical symbolically-addressed entry of a variable, or
+    /// null if none
+    ref<TxStoreEntry> findSymbolicHistorical(ref<TxVariable> variable) const;
+
+    /// \brief As TxStore#isInLeftSubtree of the reference store, with the
+    /// answers for all depths remembered
+    bool isInLeftSubtree(uint64_t targetDepth) const;
+  };
+
 private:
   /// \brief A concretely-addressed store of the earlier versions of all
   /// addresses
@@ -126,6 +187,10 @@ private:
   /// \brief Store elements used by right path
   std::set<ref<TxStoreEntry> > usedByRightPath;
 
+  /// \brief The union of the signature bits of the allocation contexts in
+  /// the internal store
+  uint64_t contextSignature;
+
   /// \brief The depth level of this store
   uint64_t depth;
 
@@ -146,7 +211,7 @@ private:
 
   void getConcreteStore(
       const TxStore *referenceStore,
-      const std::vector<llvm::Instruction *> &callHistory,
+      const TxCallHistory *callHistory,
       const std::map<ref<Expr>, ref<Expr> > &substitution,
       std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
       TopInterpolantStore &_concretelyAddressedStore,
@@ -154,32 +219,73 @@ private:
 
   void getSymbolicStore(
       const TxStore *referenceStore,
-      const std::vector<llvm::Instruction *> &callHistory,
+      const TxCallHistory *callHistory,
       const std::map<ref<Expr>, ref<Expr> > &substitution,
       std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
       TopInterpolantStore &_symbolicallyAddressedStore,
       LowerInterpolantStore &_symbolicallyAddressedHistoricalStore) const;
 
-  void recursivelyMarkFlow(ref<TxStoreEntry> entry, bool leftMarking,
-                           const std::string &reason) const;
+  /// \brief A store entry pending a visit by the dependency marking
+  struct MarkingItem {
+    ref<TxStoreEntry> entry;
+
+    /// \brief The subtree side the entry is marked for
+    bool leftMarking;
+
+    /// \brief Whether the entry is to be visited by the pointer flow marking,
+    /// which also adjusts the offset bounds
+    bool pointerFlow;
+
+    MarkingItem(ref<TxStoreEntry> _entry, bool _leftMarking, bool _pointerFlow)
+        : entry(_entry), leftMarking(_leftMarking), pointerFlow(_pointerFlow) {}
+  };
 
-  bool recursivelyMarkPointerFlow(ref<TxStoreEntry> entry, bool leftMarking,
-                                  ref<TxStateValue> checkedAddress,
-                                  std::set<uint64_t> &bounds,
-                                  const std::string &reason,
-                                  uint64_t startingDepth) const;
+  /// \brief The epoch of the latest dependency marking
+  static uint64_t markingEpoch;
+
+  /// \brief Push the entries of a dependency list of a store entry to the
+  /// marking worklist, in reverse order such that they are visited in the
+  /// order of the list.
+  static void pushMarkingItems(std::vector<MarkingItem> &worklist,
+                               const std::map<ref<TxStoreEntry>, bool> &entries,
+                               bool pointerFlow);
+
+  /// \brief Mark the entries of the worklist, and the entries they depend
+  /// upon, as core within a single marking epoch, such that each entry is
+  /// visited at most once per subtree side and marking mode. Returns true if
+  /// memory bounds violation is detected by the pointer flow marking.
+  bool markEntries(std::vector<MarkingItem> &worklist,
+                   ref<TxStateValue> checkedAddress, std::set<uint64_t> &bounds,
+                   unsigned reason) const;
 
   static bool adjustOffsetBound(ref<TxStoreEntry> entry, bool leftMarking,
                                 ref<TxStateValue> checkedAddress,
-                                std::set<uint64_t> &bounds,
-                                const std::string &reason, bool &boundUpdated);
+                                std::set<uint64_t> &bounds, unsigned reason,
+                                bool &boundUpdated);
 
   /// \brief Constructor for an empty store.
-  TxStore() : depth(0), parent(0), left(0), right(0) {}
+  TxStore() : contextSignature(0), depth(0), parent(0), left(0), right(0) {}
 
 public:
+  /// \brief Number of store entry visits by the dependency markings, for
+  /// statistical purposes
+  static uint64_t markingVisitCount;
+
+  /// \brief Timer for the dependency markings
+  static Statistic markingTime;
+
+  static void *operator new(size_t size) {
+    return TxArena::get(TxArena::Store).allocate(size);
+  }
+
+  static void operator delete(void *block, size_t size) {
+    TxArena::get(TxArena::Store).deallocate(block, size);
+  }
+
   ~TxStore() {}
 
+  /// \brief Create a child store of src. The maps are persistent, hence the
+  /// assignments below only share the roots of the parent's maps.
   static TxStore *create(TxStore *src) {
     TxStore *ret = new TxStore();
     if (!src) {
@@ -190,6 +296,7 @@ public:
     ret->symbolicallyAddressedHistoricalStore =
         src->symbolicallyAddressedHistoricalStore;
     ret->internalStore = src->internalStore;
+    ret->contextSignature = src->contextSignature;
     ret->depth = src->depth + 1;
     ret->parent = src;
     return ret;
@@ -207,29 +314,6 @@ public:
   /// \brief Finds a store entry given an address
   ref<TxStoreEntry> find(ref<TxStateAddress> loc) const;
 
-  /// \brief This retrieves the locations known at this state, and the
-  /// expressions stored in the locations. Returns as the last argument a pair
-  /// of the store part indexed by constants, and the store part indexed by
-  /// symbolic expressions.
-  ///
-  /// \param replacements The replacement bound variables when
-  /// retrieving state for creating subsumption table entry: As the
-  /// resulting expression will be used for storing in the
-  /// subsumption table, the variables need to be replaced with the
-  /// bound ones.
-  /// \param coreOnly Indicate whether we are retrieving only data
-  /// for locations relevant to an unsatisfiability core.
-  /// \param leftRetrieval Whether the retrieval is requested by the left child
-  /// of the store, otherwise, we assume it is requested by the right child of
-  /// the store.
-  void getStoredExpressions(
-      const TxStore *store, const std::vector<llvm::Instruction *> &callHistory,
-      const std::map<ref<Expr>, ref<Expr> > &substitution,
-      std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
-      TopStateStore &__internalStore,
-      LowerStateStore &__concretelyAddressedHistoricalStore,
-      LowerStateStore &__symbolicallyAddressedHistoricalStore) const;
-
   /// \brief This retrieves the locations known at this state, and the
   /// expressions stored in the locations. Returns as the last argument a pair
   /// of the store part indexed by constants, and the store part indexed by
@@ -246,7 +330,7 @@ public:
   /// of the store, otherwise, we assume it is requested by the right child of
   /// the store.
   void getStoredCoreExpressions(
-      const TxStore *store, const std::vector<llvm::Instruction *> &callHistory,
+      const TxStore *store, const TxCallHistory *callHistory,
       const std::map<ref<Expr>, ref<Expr> > &substitution,
       std::set<const Array *> &replacements, bool coreOnly, bool leftRetrieval,
       TopInterpolantStore &_concretelyAddressedStore,
@@ -271,7 +355,8 @@ public:
   void markUsed(const std::set<ref<TxStoreEntry> > &entryList);
 
   /// \brief Mark as core all the values and locations that flows to the
-  /// target
+  /// target. The reason is interned once, by TxCoreReasons::intern, for all
+  /// the marked values.
   void markFlow(ref<TxStateValue> target, const std::string &reason) const;
 
   /// \brief Mark as core all the pointer values and that flows to the target;
@@ -295,6 +380,8 @@ public:
 
   uint64_t getDepth() const { return depth; }
 
+  uint64_t getContextSignature() const { return contextSignature; }
+
   /// \brief Print the content of the object to the LLVM error stream
   void dump() const {
     this->print(llvm::errs());
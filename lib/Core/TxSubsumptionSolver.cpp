@@ -0,0 +1,230 @@
+//===-- TxSubsumptionSolver.cpp ---------------------------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementations for the solver dedicated to the
+/// queries of subsumption checks.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TxSubsumptionSolver.h"
+
+#include "TimingSolver.h"
+
+#include "klee/CommandLine.h"
+#include "klee/ExecutionState.h"
+
+using namespace klee;
+
+namespace klee {
+
+uint64_t TxSubsumptionSolver::cacheHitCount = 0;
+
+uint64_t TxSubsumptionSolver::cacheMissCount = 0;
+
+uint64_t TxSubsumptionSolver::cacheEvictionCount = 0;
+
+TxSubsumptionSolver::CacheKey::CacheKey(ref<Expr> _query,
+                                        const ConstraintManager &_constraints)
+    : query(_query), constraints(_constraints.getLastNode()),
+      hash(_query->hash()) {
+  if (!constraints.isNull())
+    hash = (hash * Expr::MAGIC_HASH_CONSTANT) ^ constraints->hash;
+}
+
+bool TxSubsumptionSolver::CacheKey::operator<(const CacheKey &other) const {
+  if (hash != other.hash)
+    return hash < other.hash;
+  size_t size = constraints.isNull() ? 0 : constraints->size;
+  size_t otherSize = other.constraints.isNull() ? 0 : other.constraints->size;
+  if (size != otherSize)
+    return size < otherSize;
+  if (int c = query.compare(other.query))
+    return c < 0;
+
+  // The lists are compared from their last constraints up to the nodes they
+  // share, if any, which are usually reached at once
+  for (ConstraintNode *node = constraints.get(),
+                      *otherNode = other.constraints.get();
+       node != otherNode;
+       node = node->parent.get(), otherNode = otherNode->parent.get()) {
+    if (int c = node->constraint.compare(otherNode->constraint))
+      return c < 0;
+  }
+  return false;
+}
+
+TxSubsumptionSolver::TxSubsumptionSolver(TimingSolver *_solver)
+    : solver(_solver) {
+#ifdef ENABLE_Z3
+  // We use Z3 directly, without pre-solving optimizations, as KLEE's
+  // pre-solving procedure does not handle quantified expressions.
+  quantifiedSolver = new Z3Solver(/*keepConstructCache=*/true);
+  parallelSolver =
+      SubsumptionThreads ? new Z3ParallelSolver(SubsumptionThreads) : 0;
+#endif
+}
+
+TxSubsumptionSolver::~TxSubsumptionSolver() {
+  cache.clear();
+  retiredCache.clear();
+#ifdef ENABLE_Z3
+  delete quantifiedSolver;
+  delete parallelSolver;
+#endif
+}
+
+bool TxSubsumptionSolver::evaluate(ExecutionState &state, ref<Expr> query,
+                                   double timeout, Solver::Validity &result,
+                                   std::vector<ref<Expr> > &unsatCore) {
+  CacheKey key(query, state.constraints);
+  if (lookup(key, result, unsatCore))
+    return true;
+
+  bool success = false;
+#ifdef ENABLE_Z3
+  if (llvm::isa<ExistsExpr>(query)) {
+    quantifiedSolver->setCoreSolverTimeout(timeout);
+    success = quantifiedSolver->directComputeValidity(
+        Query(state.constraints, query), result, unsatCore);
+    quantifiedSolver->setCoreSolverTimeout(0);
+  } else
+#endif
+  {
+    solver->setTimeout(timeout);
+    success = solver->evaluate(state, query, result, unsatCore);
+    solver->setTimeout(0);
+  }
+
+  // Failures, e.g., timeouts, are not cached, as they may not recur
+  if (!success)
+    return false;
+
+  store(key, result, unsatCore);
+  return true;
+}
+
+unsigned TxSubsumptionSolver::evaluateFirstValid(
+    ExecutionState &state, const std::vector<ref<Expr> > &queries,
+    double timeout, std::vector<ref<Expr> > &unsatCore) {
+  unsigned size = queries.size();
+#ifdef ENABLE_Z3
+  assert(parallelSolver && "no thread pool");
+
+  // The queries not in the cache, up to the first one cached as valid, which
+  // is the result unless one of the uncached queries before it is valid
+  unsigned cachedValid = size;
+  std::vector<unsigned> positions;
+  std::vector<ref<Expr> > uncached;
+  std::vector<CacheKey> keys;
+  for (unsigned i = 0; i < size; ++i) {
+    CacheKey key(queries[i], state.constraints);
+    Solver::Validity result;
+    std::vector<ref<Expr> > core;
+    if (lookup(key, result, core)) {
+      if (result == Solver::True) {
+        cachedValid = i;
+        unsatCore = core;
+        break;
+      }
+      continue;
+    }
+    positions.push_back(i);
+    uncached.push_back(queries[i]);
+    keys.push_back(key);
+  }
+
+  if (uncached.empty())
+    return cachedValid;
+
+  std::vector<bool> success;
+  std::vector<ref<Expr> > core;
+  unsigned first = parallelSolver->computeFirstValid(
+      state.constraints, uncached, timeout, success, core);
+
+  // Only the results up to the first valid query are independent of the
+  // thread schedule. The others are cached as not valid, as only validity
+  // matters to subsumption checks.
+  for (unsigned i = 0; i < uncached.size() && i <= first; ++i) {
+    if (!success[i])
+      continue;
+    if (i == first)
+      store(keys[i], Solver::True, core);
+    else
+      store(keys[i], Solver::Unknown, std::vector<ref<Expr> >());
+  }
+
+  if (first < uncached.size()) {
+    unsatCore = core;
+    return positions[first];
+  }
+  return cachedValid;
+#else
+  return size;
+#endif
+}
+
+bool TxSubsumptionSolver::lookup(const CacheKey &key, Solver::Validity &result,
+                                 std::vector<ref<Expr> > &unsatCore) {
+  std::map<CacheKey, CacheValue>::iterator it = cache.find(key);
+  if (it == cache.end()) {
+    it = retiredCache.find(key);
+    if (it == retiredCache.end()) {
+      ++cacheMissCount;
+      return false;
+    }
+
+    // Still in use: move it to the current generation
+    std::map<CacheKey, CacheValue>::iterator retiredIt = it;
+    it = cache.insert(*retiredIt).first;
+    retiredCache.erase(retiredIt);
+  }
+  ++cacheHitCount;
+  result = it->second.result;
+  unsatCore = it->second.unsatCore;
+  return true;
+}
+
+void TxSubsumptionSolver::store(const CacheKey &key, Solver::Validity result,
+                                const std::vector<ref<Expr> > &unsatCore) {
+  if (cache.size() >= maxCacheSize / 2)
+    retire();
+  cache[key] = CacheValue(result, unsatCore);
+}
+
+void TxSubsumptionSolver::retire() {
+  cacheEvictionCount += retiredCache.size();
+  retiredCache.clear();
+  retiredCache.swap(cache);
+
+  // A key pins the list of the state constraints. When the last node of the
+  // list is referenced by the keys only, no state, nor the list of any state,
+  // has it any more, so the results can no longer be used by the same states.
+  std::map<ConstraintNode *, unsigned> keyCount;
+  for (std::map<CacheKey, CacheValue>::const_iterator
+           it = retiredCache.begin(),
+           ie = retiredCache.end();
+       it != ie; ++it) {
+    if (!it->first.constraints.isNull())
+      ++keyCount[it->first.constraints.get()];
+  }
+  for (std::map<CacheKey, CacheValue>::iterator it = retiredCache.begin(),
+                                                ie = retiredCache.end();
+       it != ie;) {
+    ConstraintNode *node = it->first.constraints.get();
+    if (node && node->refCount == keyCount[node]) {
+      ++cacheEvictionCount;
+      --keyCount[node];
+      retiredCache.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+}
@@ -0,0 +1,167 @@
+//===--- TxSubsumptionSolver.h ----------------------------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the declarations for the solver dedicated to the
+/// queries of subsumption checks.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_TXSUBSUMPTIONSOLVER_H
+#define KLEE_TXSUBSUMPTIONSOLVER_H
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/Solver.h"
+
+#include <map>
+#include <vector>
+
+namespace klee {
+
+class ExecutionState;
+class TimingSolver;
+
+/// \brief The solver for the queries of subsumption checks.
+///
+/// A subsumption check asks whether the state constraints imply the
+/// interpolant of a table entry, possibly existentially quantified, conjoined
+/// with the equalities between the state and the entry values. The same entry
+/// is checked against many states, and a state against many entries, hence
+/// this solver keeps:
+///
+/// 1. A cache of the results, including the unsatisfiability cores, indexed
+///    by the query expression and the state constraints. It is bounded by
+///    evicting the least recently used results in generations, together with
+///    the results for constraints that no state has any more.
+///
+/// 2. A Z3 solver of its own for existentially-quantified queries, which
+///    keeps its translation of expressions into Z3 ASTs across queries, so
+///    that the interpolant of a table entry is translated only once.
+///
+/// Unquantified queries are still sent to the main solver chain, to benefit
+/// from its pre-solving optimizations.
+///
+/// With -subsumption-threads, the queries of the entries of a program point
+/// are instead solved together by a pool of Z3 threads.
+///
+/// \see TxSubsumptionTableEntry
+class TxSubsumptionSolver {
+  /// \brief The index of a cached result. The state constraints are held by
+  /// the node of their last constraint, shared with the states, whose hash is
+  /// maintained as the constraints are added.
+  struct CacheKey {
+    ref<Expr> query;
+
+    /// \brief The node of the last state constraint, null for none
+    ref<ConstraintNode> constraints;
+
+    unsigned hash;
+
+    CacheKey(ref<Expr> _query, const ConstraintManager &_constraints);
+
+    bool operator<(const CacheKey &other) const;
+  };
+
+  /// \brief A cached result
+  struct CacheValue {
+    Solver::Validity result;
+
+    std::vector<ref<Expr> > unsatCore;
+
+    CacheValue() : result(Solver::Unknown) {}
+
+    CacheValue(Solver::Validity _result,
+               const std::vector<ref<Expr> > &_unsatCore)
+        : result(_result), unsatCore(_unsatCore) {}
+  };
+
+  /// \brief The number of cached results beyond which the least recently used
+  /// ones are evicted
+  static const size_t maxCacheSize = 16384;
+
+  /// \brief The main solver chain, used for unquantified queries
+  TimingSolver *solver;
+
+#ifdef ENABLE_Z3
+  /// \brief The solver for existentially-quantified queries
+  Z3Solver *quantifiedSolver;
+
+  /// \brief The thread pool with -subsumption-threads, null otherwise
+  Z3ParallelSolver *parallelSolver;
+#endif
+
+  /// \brief Retrieves a cached result, counting the hit or miss
+  bool lookup(const CacheKey &key, Solver::Validity &result,
+              std::vector<ref<Expr> > &unsatCore);
+
+  void store(const CacheKey &key, Solver::Validity result,
+             const std::vector<ref<Expr> > &unsatCore);
+
+  /// \brief Makes the current generation of the cache the retired one,
+  /// evicting the results of the previous retired generation that were not
+  /// used since, and those whose state constraints no state has any more.
+  void retire();
+
+  /// \brief The results stored or used since the cache was last retired
+  std::map<CacheKey, CacheValue> cache;
+
+  /// \brief The previous generation of the cache. A result found here is
+  /// moved back to the current generation, as in Z3Builder.
+  std::map<CacheKey, CacheValue> retiredCache;
+
+public:
+  /// \brief Numbers of queries answered from, and missing from, the cache
+  static uint64_t cacheHitCount;
+  static uint64_t cacheMissCount;
+
+  /// \brief Number of results evicted from the cache
+  static uint64_t cacheEvictionCount;
+
+  TxSubsumptionSolver(TimingSolver *_solver);
+
+  ~TxSubsumptionSolver();
+
+  /// \brief Computes the validity of the query expression under the
+  /// constraints of the state.
+  ///
+  /// \param state The state whose constraints are assumed.
+  /// \param query The query expression.
+  /// \param timeout The solver timeout, 0 for none.
+  /// \param result The validity of the query.
+  /// \param unsatCore The constraints of the state needed for the validity of
+  /// the query.
+  /// \return true if the solver decided, false on failure.
+  bool evaluate(ExecutionState &state, ref<Expr> query, double timeout,
+                Solver::Validity &result, std::vector<ref<Expr> > &unsatCore);
+
+  /// \brief Whether the queries are to be given to evaluateFirstValid
+  bool isParallel() const {
+#ifdef ENABLE_Z3
+    return parallelSolver != 0;
+#else
+    return false;
+#endif
+  }
+
+  /// \brief Finds the first of the query expressions that is valid under the
+  /// constraints of the state, solving them on the thread pool. The result is
+  /// the same as when calling evaluate on each query in order until a valid
+  /// one is found.
+  ///
+  /// \return The position of the first valid query, or the number of queries
+  /// if none is valid or decided.
+  unsigned evaluateFirstValid(ExecutionState &state,
+                              const std::vector<ref<Expr> > &queries,
+                              double timeout,
+                              std::vector<ref<Expr> > &unsatCore);
+};
+}
+
+#endif
@@ -25,11 +25,22 @@
 #include <klee/util/ExprPPrinter.h>
 #include <klee/util/TxExprUtil.h>
 #include <klee/util/TxPrintUtil.h>
+#include <algorithm>
 #include <fstream>
 #include <vector>
 #include "TxDependency.h"
+#include "TxRelevanceAnalysis.h"
 #include "TxShadowArray.h"
 
+#include "expr/Parser.h"
+#include "klee/ExprBuilder.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/util/ArrayCache.h"
+
+#include <llvm/Support/MemoryBuffer.h>
+
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
 #include <llvm/IR/DebugInfo.h>
 #elif LLVM_VERSION_CODE >= LLVM_VERSION(3, 2)
@@ -38,6 +49,25 @@
 #include <llvm/Analysis/DebugInfo.h>
 #endif
 
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include <llvm/IR/Module.h>
+#else
+#include <llvm/Module.h>
+#endif
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
+#include <llvm/IR/Dominators.h>
+#else
+#include <llvm/Analysis/Dominators.h>
+#endif
+#include <llvm/Analysis/LoopInfo.h>
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
+#include <memory>
+#else
+#include <llvm/ADT/OwningPtr.h>
+#endif
+
 using namespace klee;
 
 Statistic TxSubsumptionTableEntry::concretelyAddressedStoreExpressionBuildTime(
@@ -48,9 +78,23 @@ TxSubsumptionTableEntry::symbolicallyAddressedStoreExpressionBuildTime(
 Statistic TxSubsumptionTableEntry::solverAccessTime("solverAccessTime",
                                                     "solverAccessTime");
 
+uint64_t TxSubsumptionTableEntry::prefilterCheckCount = 0;
+
+uint64_t TxSubsumptionTableEntry::contextFilterRejectCount = 0;
+
+
+uint64_t TxSubsumptionTableEntry::constantFilterRejectCount = 0;
+
+uint64_t TxSubsumptionTableEntry::simplificationCacheHitCount = 0;
+
+uint64_t TxSubsumptionTableEntry::simplificationCacheMissCount = 0;
+
 TxSubsumptionTableEntry::TxSubsumptionTableEntry(
-    TxTreeNode *node, const std::vector<llvm::Instruction *> &callHistory)
-    : programPoint(node->getProgramPoint()),
+    TxTreeNode *node, const TxCallHistory *_callHistory)
+    : subsumptionCount(0), failedCheckCount(0), insertionTime(0), size(0),
+      loaded(false), callHistory(_callHistory),
+      leastFrameDepth(node->getLeastFrameDepth()),
+      programPoint(node->getProgramPoint()),
       nodeSequenceNumber(node->getNodeSequenceNumber()) {
   std::map<ref<Expr>, ref<Expr> > substitution;
   existentials.clear();
@@ -60,10 +104,317 @@ TxSubsumptionTableEntry::TxSubsumptionTableEntry(
       callHistory, substitution, existentials, concretelyAddressedStore,
       symbolicallyAddressedStore, concretelyAddressedHistoricalStore,
       symbolicallyAddressedHistoricalStore);
+
+  if (StoreRelevanceAnalysis) {
+    dropIrrelevantAllocations(concretelyAddressedStore);
+    dropIrrelevantAllocations(symbolicallyAddressedStore);
+  }
+
+  if (FunctionSummaries && isContextIndependent())
+    generalizeStores();
+
+  normalizeInterpolant();
+  computeSignatures();
+  computeSize();
+}
+
+TxSubsumptionTableEntry::TxSubsumptionTableEntry(
+    uintptr_t _programPoint, const TxCallHistory *_callHistory,
+    int _leastFrameDepth, ref<Expr> _interpolant,
+    const std::set<const Array *> &_existentials,
+    const TxStore::TopInterpolantStore &_concretelyAddressedStore,
+    const TxStore::TopInterpolantStore &_symbolicallyAddressedStore,
+    const TxStore::LowerInterpolantStore &_concretelyAddressedHistoricalStore,
+    const TxStore::LowerInterpolantStore &
+        _symbolicallyAddressedHistoricalStore)
+    : interpolant(_interpolant),
+      concretelyAddressedHistoricalStore(_concretelyAddressedHistoricalStore),
+      symbolicallyAddressedHistoricalStore(
+          _symbolicallyAddressedHistoricalStore),
+      concretelyAddressedStore(_concretelyAddressedStore),
+      symbolicallyAddressedStore(_symbolicallyAddressedStore),
+      existentials(_existentials), subsumptionCount(0), failedCheckCount(0),
+      insertionTime(0), size(0), loaded(true), callHistory(_callHistory),
+      leastFrameDepth(_leastFrameDepth), programPoint(_programPoint),
+      nodeSequenceNumber(0) {
+  normalizeInterpolant();
+  computeSignatures();
+  computeSize();
 }
 
 TxSubsumptionTableEntry::~TxSubsumptionTableEntry() {}
 
+void TxSubsumptionTableEntry::dropIrrelevantAllocations(
+    TxStore::TopInterpolantStore &store) {
+  for (TxStore::TopInterpolantStore::iterator it = store.begin(),
+                                              ie = store.end();
+       it != ie;) {
+    // Only the allocations of the frame of the program point are analyzed
+    if (it->first->getCallHistory() == callHistory &&
+        TxRelevanceAnalysis::isIrrelevant(programPoint,
+                                          it->first->getValue())) {
+      TxRelevanceAnalysis::droppedCellCount += it->second.size();
+      store.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool TxSubsumptionTableEntry::isContextIndependent() const {
+  return leastFrameDepth >= 0 && !callHistory->empty();
+}
+
+void TxSubsumptionTableEntry::generalizeStores() {
+  // The historical stores are matched by the allocations and offsets of their
+  // cells, which do not include the call history
+  generalizeStore(concretelyAddressedStore);
+  generalizeStore(symbolicallyAddressedStore);
+}
+
+void TxSubsumptionTableEntry::generalizeStore(
+    TxStore::TopInterpolantStore &store) {
+  TxStore::TopInterpolantStore generalized;
+  for (TxStore::TopInterpolantStore::const_iterator it = store.begin(),
+                                                    ie = store.end();
+       it != ie; ++it) {
+    const TxCallHistory *suffix =
+        it->first->getCallHistory()->getSuffix(callHistory);
+    if (!suffix) {
+      generalized.insert(*it);
+      continue;
+    }
+
+    ref<TxAllocationContext> context =
+        TxAllocationContext::create(it->first->getValue(), suffix, true);
+    TxStore::LowerInterpolantStore &cells = generalized[context];
+    for (TxStore::LowerInterpolantStore::const_iterator
+             it1 = it->second.begin(),
+             ie1 = it->second.end();
+         it1 != ie1; ++it1) {
+      ref<TxAllocationInfo> allocInfo = TxAllocationInfo::create(
+          context, it1->first->getBase(),
+          it1->first->getAllocationInfo()->getSize());
+      cells[TxVariable::create(allocInfo, it1->first->getOffset())] =
+          it1->second;
+    }
+  }
+  store.swap(generalized);
+}
+
+void TxSubsumptionTableEntry::rebaseContexts(
+    const TxCallHistory *entryCallHistory) {
+  if (relativeContexts.empty() || entryCallHistory == rebaseCallHistory)
+    return;
+
+  rebaseCallHistory = entryCallHistory;
+  rebasedContexts.clear();
+  rebasedContextSignature = 0;
+  for (std::set<ref<TxAllocationContext> >::const_iterator
+           it = relativeContexts.begin(),
+           ie = relativeContexts.end();
+       it != ie; ++it) {
+    ref<TxAllocationContext> context = TxAllocationContext::create(
+        (*it)->getValue(), entryCallHistory->append((*it)->getCallHistory()));
+    rebasedContexts[*it] = context;
+    rebasedContextSignature |= context->getSignature();
+  }
+}
+
+ref<TxAllocationContext> TxSubsumptionTableEntry::getStateContext(
+    ref<TxAllocationContext> context) const {
+  if (!context->isRelative())
+    return context;
+
+  std::map<ref<TxAllocationContext>,
+           ref<TxAllocationContext> >::const_iterator it =
+      rebasedContexts.find(context);
+  assert(it != rebasedContexts.end() && "relative context not rebased");
+  return it->second;
+}
+
+/// \brief The estimated memory of the expression nodes not yet visited.
+/// Expression nodes are shared, hence the estimate of an entry is an upper
+/// bound of the memory released when the entry is deleted.
+static uint64_t getExprSize(ref<Expr> expr, std::set<const Expr *> &visited) {
+  // A rough average of the sizes of the expression classes
+  const uint64_t exprNodeSize = 64;
+
+  if (expr.isNull() || !visited.insert(expr.get()).second)
+    return 0;
+
+  uint64_t size = exprNodeSize;
+  for (unsigned i = 0, n = expr->getNumKids(); i < n; ++i)
+    size += getExprSize(expr->getKid(i), visited);
+  return size;
+}
+
+void TxSubsumptionTableEntry::computeSize() {
+  // A rough size of a node of a standard map
+  const uint64_t mapNodeSize = 48;
+
+  std::set<const Expr *> visited;
+  size = sizeof(TxSubsumptionTableEntry) + getExprSize(interpolant, visited);
+
+  const TxStore::TopInterpolantStore *stores[2] = {
+    &concretelyAddressedStore, &symbolicallyAddressedStore
+  };
+  for (unsigned i = 0; i < 2; ++i) {
+    for (TxStore::TopInterpolantStore::const_iterator
+             it1 = stores[i]->begin(),
+             ie1 = stores[i]->end();
+         it1 != ie1; ++it1) {
+      size += mapNodeSize;
+      for (TxStore::LowerInterpolantStore::const_iterator
+               it2 = it1->second.begin(),
+               ie2 = it1->second.end();
+           it2 != ie2; ++it2) {
+        size += mapNodeSize + sizeof(TxInterpolantValue) +
+                getExprSize(it2->second->getExpression(), visited);
+      }
+    }
+  }
+
+  const TxStore::LowerInterpolantStore *historicalStores[2] = {
+    &concretelyAddressedHistoricalStore, &symbolicallyAddressedHistoricalStore
+  };
+  for (unsigned i = 0; i < 2; ++i) {
+    for (TxStore::LowerInterpolantStore::const_iterator
+             it = historicalStores[i]->begin(),
+             ie = historicalStores[i]->end();
+         it != ie; ++it) {
+      size += mapNodeSize + sizeof(TxInterpolantValue) +
+              getExprSize(it->second->getExpression(), visited);
+    }
+  }
+
+  size += existentials.size() * mapNodeSize;
+  size += constantCells.size() * sizeof(constantCells[0]);
+}
+
+void TxSubsumptionTableEntry::normalizeInterpolant() {
+  normalizedInterpolant = interpolant;
+  if (interpolant.isNull() || existentials.empty())
+    return;
+
+  std::vector<ref<Expr> > interpolantPack;
+  ref<Expr> normalized = simplifyInterpolantExpr(interpolantPack, interpolant);
+
+  // A constant interpolant would no longer be a conjunct of the query body
+  // after simplification, which simplifyArithmeticBody relies on.
+  if (!llvm::isa<ConstantExpr>(normalized))
+    normalizedInterpolant = normalized;
+}
+
+bool TxSubsumptionTableEntry::insertedBefore(
+    const TxSubsumptionTableEntry *first,
+    const TxSubsumptionTableEntry *second) {
+  return first->insertionTime < second->insertionTime;
+}
+
+bool TxSubsumptionTableEntry::lessUseful(
+    const TxSubsumptionTableEntry *first,
+    const TxSubsumptionTableEntry *second) {
+  // (s1 + 1) / (f1 + 1) < (s2 + 1) / (f2 + 1), without division
+  uint64_t firstScore =
+      (first->subsumptionCount + 1) * (second->failedCheckCount + 1);
+  uint64_t secondScore =
+      (second->subsumptionCount + 1) * (first->failedCheckCount + 1);
+  if (firstScore != secondScore)
+    return firstScore < secondScore;
+  return first->insertionTime < second->insertionTime;
+}
+
+void TxSubsumptionTableEntry::computeSignatures() {
+  contextSignature = 0;
+  rebaseCallHistory = 0;
+  rebasedContextSignature = 0;
+
+  // The signature bits of the relative contexts are those of their rebased
+  // contexts, which depend on the state
+  for (TxStore::TopInterpolantStore::const_iterator
+           it1 = concretelyAddressedStore.begin(),
+           ie1 = concretelyAddressedStore.end();
+       it1 != ie1; ++it1) {
+    if (it1->first->isRelative())
+      relativeContexts.insert(it1->first);
+    else
+      contextSignature |= it1->first->getSignature();
+
+    for (TxStore::LowerInterpolantStore::const_iterator
+             it2 = it1->second.begin(),
+             ie2 = it1->second.end();
+         it2 != ie2; ++it2) {
+      if (!it2->second->isPointer() &&
+          llvm::isa<ConstantExpr>(it2->second->getExpression())) {
+        constantCells.push_back(
+            std::make_pair(it2->first, it2->second->getExpression()));
+      }
+    }
+  }
+
+  for (TxStore::TopInterpolantStore::const_iterator
+           it = symbolicallyAddressedStore.begin(),
+           ie = symbolicallyAddressedStore.end();
+       it != ie; ++it) {
+    if (it->first->isRelative())
+      relativeContexts.insert(it->first);
+    else
+      contextSignature |= it->first->getSignature();
+  }
+}
+
+bool TxSubsumptionTableEntry::prefiltered(ExecutionState &state,
+                                          const TxStore::StateView &stateStore,
+                                          int debugSubsumptionLevel) {
+  ++prefilterCheckCount;
+  rebaseContexts(state.txTreeNode->entryCallHistory);
+
+  // A tabled allocation context missing from the state store fails the check
+  // in subsumed(), hence so does a missing signature bit.
+  if ((contextSignature | rebasedContextSignature) &
+      ~state.txTreeNode->getStore()->getContextSignature()) {
+    ++contextFilterRejectCount;
+    if (debugSubsumptionLevel >= 1) {
+      klee_message("#%lu=>#%lu: Check failure as an allocated memory region "
+                   "in the table does not exist in the state (pre-filter)",
+                   state.txTreeNode->getNodeSequenceNumber(),
+                   nodeSequenceNumber);
+    }
+    return true;
+  }
+
+  // Unequal constants stored at the same concrete address fail the check in
+  // subsumed() without calling the solver.
+  for (std::vector<std::pair<ref<TxVariable>, ref<Expr> > >::const_iterator
+           it = constantCells.begin(),
+           ie = constantCells.end();
+       it != ie; ++it) {
+    const TxStore::MiddleStateStore *m =
+        stateStore.find(getStateContext(it->first->getContext()));
+    if (!m)
+      continue;
+
+    ref<TxStoreEntry> e = m->findConcrete(it->first);
+    if (e.isNull() || !llvm::isa<ConstantExpr>(e->getExpression()))
+      continue;
+
+    if (e->getExpression()->getWidth() != it->second->getWidth() ||
+        e->getExpression() != it->second) {
+      ++constantFilterRejectCount;
+      if (debugSubsumptionLevel >= 1) {
+        klee_message("#%lu=>#%lu: Check failure due to unequal constant "
+                     "content (pre-filter)",
+                     state.txTreeNode->getNodeSequenceNumber(),
+                     nodeSequenceNumber);
+      }
+      return true;
+    }
+  }
+
+  return false;
+}
+
 ref<Expr> TxSubsumptionTableEntry::makeConstraint(
     ExecutionState &state, ref<TxInterpolantValue> tabledValue,
     ref<TxInterpolantValue> stateValue, ref<Expr> tabledOffset,
@@ -649,8 +1000,8 @@ bool TxSubsumptionTableEntry::detectConflictPrimitives(ExecutionState &state,
     return false;
   }
 
-  for (std::vector<ref<Expr> >::const_iterator it1 = state.constraints.begin(),
-                                               ie1 = state.constraints.end();
+  for (ConstraintManager::const_iterator it1 = state.constraints.begin(),
+                                         ie1 = state.constraints.end();
        it1 != ie1; ++it1) {
 
     if ((*it1)->getKind() != Expr::Eq)
@@ -739,6 +1090,45 @@ TxSubsumptionTableEntry::simplifyExistsExpr(ref<Expr> existsExpr,
   return ret;
 }
 
+ref<Expr> TxSubsumptionTableEntry::simplifyQuery(
+    ref<Expr> stateEqualityConstraints, bool &hasExistentialsOnly,
+    ExecutionState &state, int debugSubsumptionLevel) {
+  ExprHashMap<std::pair<ref<Expr>, bool> >::iterator it =
+      simplifiedQueries.find(stateEqualityConstraints);
+  if (it != simplifiedQueries.end()) {
+    ++simplificationCacheHitCount;
+    if (debugSubsumptionLevel >= 2) {
+      klee_message("Reusing the simplification of an earlier check");
+    }
+    hasExistentialsOnly = it->second.second;
+    return it->second.first;
+  }
+  ++simplificationCacheMissCount;
+
+  // AndExpr::alloc guarantees a conjunction, as required by
+  // simplifyExistsExpr.
+  ref<Expr> existsExpr = ExistsExpr::create(
+      existentials,
+      AndExpr::alloc(!normalizedInterpolant.isNull()
+                         ? normalizedInterpolant
+                         : ref<Expr>(ConstantExpr::create(1, Expr::Bool)),
+                     stateEqualityConstraints));
+  if (debugSubsumptionLevel >= 2) {
+    klee_message("Before simplification:\n%s",
+                 TxPrettyExpressionBuilder::constructQuery(
+                     state.constraints, existsExpr).c_str());
+  }
+
+  hasExistentialsOnly = false;
+  ref<Expr> result = simplifyExistsExpr(existsExpr, hasExistentialsOnly);
+
+  if (simplifiedQueries.size() >= maxSimplifiedQueries)
+    simplifiedQueries.clear();
+  simplifiedQueries.insert(std::make_pair(
+      stateEqualityConstraints, std::make_pair(result, hasExistentialsOnly)));
+  return result;
+}
+
 void TxSubsumptionTableEntry::interpolateValues(
     ExecutionState &state, std::set<ref<TxStateValue> > &coreValues,
     std::map<ref<TxStateValue>, std::set<uint64_t> > &corePointerValues,
@@ -785,16 +1175,11 @@ void TxSubsumptionTableEntry::interpolateValues(
 #endif
 }
 
-bool TxSubsumptionTableEntry::subsumed(
-    TimingSolver *solver, ExecutionState &state, double timeout,
-    bool leftRetrieval, TxStore::TopStateStore &__internalStore,
-    TxStore::LowerStateStore &__concretelyAddressedHistoricalStore,
-    TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore,
-    int debugSubsumptionLevel) {
+TxSubsumptionTableEntry::CheckResult TxSubsumptionTableEntry::prepareCheck(
+    ExecutionState &state, const TxStore::StateView &stateStore,
+    int debugSubsumptionLevel, SubsumptionQuery &query) {
 #ifdef ENABLE_Z3
-  // Tell the solver implementation that we are checking for subsumption for
-  // collecting statistics of solver calls.
-  SubsumptionCheckMarker subsumptionCheckMarker;
+  rebaseContexts(state.txTreeNode->entryCallHistory);
 
   // Quick check for subsumption in case the interpolant is empty
   if (empty()) {
@@ -803,7 +1188,7 @@ bool TxSubsumptionTableEntry::subsumed(
                    state.txTreeNode->getNodeSequenceNumber(),
                    nodeSequenceNumber);
     }
-    return true;
+    return CheckSuccess;
   }
 
   ref<Expr> stateEqualityConstraints;
@@ -814,10 +1199,11 @@ bool TxSubsumptionTableEntry::subsumed(
   std::map<ref<TxAllocationInfo>, ref<TxAllocationInfo> > unifiedBases;
 
   // Non-pointer / exact pointer values to be marked as in the interpolant
-  std::set<ref<TxStateValue> > coreValues;
+  std::set<ref<TxStateValue> > &coreValues = query.coreValues;
 
   // Pointer values in the core for memory bounds interpolation.
-  std::map<ref<TxStateValue>, std::set<uint64_t> > corePointerValues;
+  std::map<ref<TxStateValue>, std::set<uint64_t> > &corePointerValues =
+      query.corePointerValues;
 
   {
     TimerStatIncrementer t(concretelyAddressedStoreExpressionBuildTime);
@@ -830,8 +1216,9 @@ bool TxSubsumptionTableEntry::subsumed(
       assert(!it1->second.empty() && "empty table entry with real index");
 
       const TxStore::LowerInterpolantStore &tabledConcreteMap = it1->second;
-      TxStore::TopStateStore::iterator mIt = __internalStore.find(it1->first);
-      if (mIt == __internalStore.end()) {
+      const TxStore::MiddleStateStore *m =
+          stateStore.find(getStateContext(it1->first));
+      if (!m) {
         if (debugSubsumptionLevel >= 1) {
           std::string msg;
           std::string padding(makeTabs(1));
@@ -843,18 +1230,16 @@ bool TxSubsumptionTableEntry::subsumed(
                        state.txTreeNode->getNodeSequenceNumber(),
                        nodeSequenceNumber, msg.c_str());
         }
-        return false;
+        return CheckFailure;
       }
 
-      TxStore::MiddleStateStore &m = mIt->second;
-
       for (TxStore::LowerInterpolantStore::const_iterator
                it2 = tabledConcreteMap.begin(),
                ie2 = tabledConcreteMap.end();
            it2 != ie2; ++it2) {
         ref<TxInterpolantValue> stateValue;
 
-        ref<TxStoreEntry> e = m.findConcrete(it2->first, unifiedBases);
+        ref<TxStoreEntry> e = m->findConcrete(it2->first, unifiedBases);
 
         if (e.isNull()) {
           // Fail the subsumption, since the address was not found in the state,
@@ -870,10 +1255,10 @@ bool TxSubsumptionTableEntry::subsumed(
                          state.txTreeNode->getNodeSequenceNumber(),
                          nodeSequenceNumber, msg.c_str());
           }
-          return false;
+          return CheckFailure;
         } else {
           bool leftUse =
-              state.txTreeNode->getStore()->isInLeftSubtree(e->getDepth());
+              stateStore.isInLeftSubtree(e->getDepth());
           stateValue = e->getInterpolantStyleValue(leftUse);
         }
 
@@ -893,7 +1278,7 @@ bool TxSubsumptionTableEntry::subsumed(
                            state.txTreeNode->getNodeSequenceNumber(),
                            nodeSequenceNumber, msg.c_str());
             }
-            return false;
+            return CheckFailure;
           } else if (TxDependency::boundInterpolation() &&
                      tabledValue->isPointer() && stateValue->isPointer()) {
             ref<Expr> boundsCheck;
@@ -910,7 +1295,7 @@ bool TxSubsumptionTableEntry::subsumed(
                                  state.txTreeNode->getNodeSequenceNumber(),
                                  nodeSequenceNumber, msg.c_str());
                   }
-                  return false;
+                  return CheckFailure;
                 }
                 if (!boundsCheck->isTrue())
                   res = boundsCheck;
@@ -932,7 +1317,7 @@ bool TxSubsumptionTableEntry::subsumed(
                                state.txTreeNode->getNodeSequenceNumber(),
                                nodeSequenceNumber, msg.c_str());
                 }
-                return false;
+                return CheckFailure;
               }
               if (!offsetsCheck->isTrue())
                 res = offsetsCheck;
@@ -975,7 +1360,7 @@ bool TxSubsumptionTableEntry::subsumed(
                                msg.c_str());
                 }
               }
-              return false;
+              return CheckFailure;
             } else if (res->isTrue()) {
               if (debugSubsumptionLevel >= 1) {
                 if (debugSubsumptionLevel >= 2) {
@@ -1008,16 +1393,17 @@ bool TxSubsumptionTableEntry::subsumed(
           }
         }
 
-        e = m.findSymbolic(it2->first);
+        e = m->findSymbolic(it2->first);
         if (!e.isNull()) {
           const ref<Expr> tabledConcreteOffset = it2->first->getOffset();
           ref<Expr> conjunction;
           bool leftUse =
-              state.txTreeNode->getStore()->isInLeftSubtree(e->getDepth());
+              stateStore.isInLeftSubtree(e->getDepth());
 
           // We make sure the context part of the addresses (the allocation
           // site and the call history) are equivalent.
-          if (it2->first->getContext() == e->getAddress()->getContext()) {
+          if (getStateContext(it2->first->getContext()) ==
+              e->getAddress()->getContext()) {
 
             ref<TxInterpolantValue> interpolantValue =
                 e->getInterpolantStyleValue(leftUse);
@@ -1027,7 +1413,7 @@ bool TxSubsumptionTableEntry::subsumed(
                 unifiedBases, debugSubsumptionLevel);
 
             if (constraint.isNull())
-              return false;
+              return CheckFailure;
 
             if (!conjunction.isNull()) {
               conjunction = AndExpr::create(constraint, conjunction);
@@ -1060,16 +1446,14 @@ bool TxSubsumptionTableEntry::subsumed(
              it1 = concretelyAddressedHistoricalStore.begin(),
              ie1 = concretelyAddressedHistoricalStore.end();
          it1 != ie1; ++it1) {
-      TxStore::LowerStateStore::const_iterator mIt =
-          __concretelyAddressedHistoricalStore.find(it1->first);
+      ref<TxStoreEntry> e = stateStore.findConcreteHistorical(it1->first);
       ref<Expr> constraint;
 
-      if (mIt == __concretelyAddressedHistoricalStore.end()) {
-        mIt = __symbolicallyAddressedHistoricalStore.find(it1->first);
-        if (mIt != __symbolicallyAddressedHistoricalStore.end()) {
-          ref<TxStoreEntry> e = mIt->second;
+      if (e.isNull()) {
+        e = stateStore.findSymbolicHistorical(it1->first);
+        if (!e.isNull()) {
           bool leftUse =
-              state.txTreeNode->getStore()->isInLeftSubtree(e->getDepth());
+              stateStore.isInLeftSubtree(e->getDepth());
           ref<TxInterpolantValue> interpolantValue =
               e->getInterpolantStyleValue(leftUse);
           constraint = makeConstraint(
@@ -1077,7 +1461,7 @@ bool TxSubsumptionTableEntry::subsumed(
               e->getAddress()->getOffset(), coreValues, corePointerValues,
               unifiedBases, debugSubsumptionLevel);
           if (constraint.isNull())
-              return false;
+              return CheckFailure;
             if (stateEqualityConstraints.isNull()) {
               stateEqualityConstraints = constraint;
             } else {
@@ -1086,12 +1470,11 @@ bool TxSubsumptionTableEntry::subsumed(
             }
         } else {
           // Match not found
-          return false;
+          return CheckFailure;
         }
       } else {
-        ref<TxStoreEntry> e = mIt->second;
         bool leftUse =
-            state.txTreeNode->getStore()->isInLeftSubtree(e->getDepth());
+            stateStore.isInLeftSubtree(e->getDepth());
         ref<TxInterpolantValue> interpolantValue =
             e->getInterpolantStyleValue(leftUse);
         constraint = makeConstraint(
@@ -1099,7 +1482,7 @@ bool TxSubsumptionTableEntry::subsumed(
             e->getAddress()->getOffset(), coreValues, corePointerValues,
             unifiedBases, debugSubsumptionLevel);
         if (constraint.isNull())
-          return false;
+          return CheckFailure;
         if (stateEqualityConstraints.isNull()) {
           stateEqualityConstraints = constraint;
         } else {
@@ -1127,8 +1510,9 @@ bool TxSubsumptionTableEntry::subsumed(
       assert(!it1->second.empty() && "empty table entry with real index");
 
       const TxStore::LowerInterpolantStore &tabledSymbolicMap = it1->second;
-      TxStore::TopStateStore::iterator mIt = __internalStore.find(it1->first);
-      if (mIt == __internalStore.end()) {
+      const TxStore::MiddleStateStore *m =
+          stateStore.find(getStateContext(it1->first));
+      if (!m) {
         if (debugSubsumptionLevel >= 1) {
           std::string msg;
           std::string padding(makeTabs(1));
@@ -1140,11 +1524,9 @@ bool TxSubsumptionTableEntry::subsumed(
                        state.txTreeNode->getNodeSequenceNumber(),
                        nodeSequenceNumber, msg.c_str());
         }
-        return false;
+        return CheckFailure;
       }
 
-      TxStore::MiddleStateStore &m = mIt->second;
-
       ref<Expr> conjunction;
 
       for (TxStore::LowerInterpolantStore::const_iterator
@@ -1152,14 +1534,15 @@ bool TxSubsumptionTableEntry::subsumed(
                ie2 = tabledSymbolicMap.end();
            it2 != ie2; ++it2) {
 
-        ref<TxStoreEntry> e = m.findConcrete(it2->first, unifiedBases);
+        ref<TxStoreEntry> e = m->findConcrete(it2->first, unifiedBases);
         if (!e.isNull()) {
           bool leftUse =
-              state.txTreeNode->getStore()->isInLeftSubtree(e->getDepth());
+              stateStore.isInLeftSubtree(e->getDepth());
 
           // We make sure the context part of the addresses (the allocation site
           // and the call history) are equivalent.
-          if (it2->first->getContext() == e->getAddress()->getContext()) {
+          if (getStateContext(it2->first->getContext()) ==
+              e->getAddress()->getContext()) {
             ref<TxInterpolantValue> interpolantValue =
                 e->getInterpolantStyleValue(leftUse);
             ref<Expr> constraint = makeConstraint(
@@ -1168,7 +1551,7 @@ bool TxSubsumptionTableEntry::subsumed(
                 unifiedBases, debugSubsumptionLevel);
 
             if (constraint.isNull())
-              return false;
+              return CheckFailure;
 
             if (!constraint.isNull()) {
               if (!conjunction.isNull()) {
@@ -1180,14 +1563,15 @@ bool TxSubsumptionTableEntry::subsumed(
           }
         }
 
-        e = m.findSymbolic(it2->first);
+        e = m->findSymbolic(it2->first);
         if (!e.isNull()) {
           bool leftUse =
-              state.txTreeNode->getStore()->isInLeftSubtree(e->getDepth());
+              stateStore.isInLeftSubtree(e->getDepth());
 
           // We make sure the context part of the addresses (the allocation site
           // and the call history) are equivalent.
-          if (it2->first->getContext() == e->getAddress()->getContext()) {
+          if (getStateContext(it2->first->getContext()) ==
+              e->getAddress()->getContext()) {
             ref<TxInterpolantValue> interpolantValue =
                 e->getInterpolantStyleValue(leftUse);
             ref<Expr> constraint = makeConstraint(
@@ -1196,7 +1580,7 @@ bool TxSubsumptionTableEntry::subsumed(
                 unifiedBases, debugSubsumptionLevel);
 
             if (constraint.isNull())
-              return false;
+              return CheckFailure;
 
             if (!conjunction.isNull()) {
               conjunction = AndExpr::create(constraint, conjunction);
@@ -1223,16 +1607,14 @@ bool TxSubsumptionTableEntry::subsumed(
              ie1 = symbolicallyAddressedHistoricalStore.end();
          it1 != ie1; ++it1) {
 
-      TxStore::LowerStateStore::const_iterator mIt =
-          __concretelyAddressedHistoricalStore.find(it1->first);
+      ref<TxStoreEntry> e = stateStore.findConcreteHistorical(it1->first);
       ref<Expr> constraint;
 
-      if (mIt == __concretelyAddressedHistoricalStore.end()) {
-        mIt = __symbolicallyAddressedHistoricalStore.find(it1->first);
-        if (mIt != __symbolicallyAddressedHistoricalStore.end()) {
-          ref<TxStoreEntry> e = mIt->second;
+      if (e.isNull()) {
+        e = stateStore.findSymbolicHistorical(it1->first);
+        if (!e.isNull()) {
           bool leftUse =
-              state.txTreeNode->getStore()->isInLeftSubtree(e->getDepth());
+              stateStore.isInLeftSubtree(e->getDepth());
           ref<TxInterpolantValue> interpolantValue =
               e->getInterpolantStyleValue(leftUse);
           constraint = makeConstraint(
@@ -1240,7 +1622,7 @@ bool TxSubsumptionTableEntry::subsumed(
               e->getAddress()->getOffset(), coreValues, corePointerValues,
               unifiedBases, debugSubsumptionLevel);
           if (constraint.isNull())
-            return false;
+            return CheckFailure;
           if (stateEqualityConstraints.isNull()) {
             stateEqualityConstraints = constraint;
           } else {
@@ -1249,12 +1631,11 @@ bool TxSubsumptionTableEntry::subsumed(
           }
           } else {
             // Match not found
-            return false;
+            return CheckFailure;
           }
       } else {
-        ref<TxStoreEntry> e = mIt->second;
         bool leftUse =
-            state.txTreeNode->getStore()->isInLeftSubtree(e->getDepth());
+            stateStore.isInLeftSubtree(e->getDepth());
         ref<TxInterpolantValue> interpolantValue =
             e->getInterpolantStyleValue(leftUse);
         constraint = makeConstraint(
@@ -1262,7 +1643,7 @@ bool TxSubsumptionTableEntry::subsumed(
             e->getAddress()->getOffset(), coreValues, corePointerValues,
             unifiedBases, debugSubsumptionLevel);
         if (constraint.isNull())
-          return false;
+          return CheckFailure;
         if (stateEqualityConstraints.isNull()) {
           stateEqualityConstraints = constraint;
         } else {
@@ -1273,7 +1654,6 @@ bool TxSubsumptionTableEntry::subsumed(
     }
   }
 
-  Solver::Validity result;
   ref<Expr> expr; // The query expression
 
   {
@@ -1305,21 +1685,15 @@ bool TxSubsumptionTableEntry::subsumed(
                      nodeSequenceNumber, msg.c_str());
       }
 
-      interpolateValues(state, coreValues, corePointerValues,
-                        debugSubsumptionLevel);
-      return true;
+      query.interpolateValues = true;
+      return CheckSuccess;
     }
 
     bool exprHasNoFreeVariables = false;
 
     if (!existentials.empty()) {
-      ref<Expr> existsExpr = ExistsExpr::create(existentials, expr);
-      if (debugSubsumptionLevel >= 2) {
-        klee_message("Before simplification:\n%s",
-                     TxPrettyExpressionBuilder::constructQuery(
-                         state.constraints, existsExpr).c_str());
-      }
-      expr = simplifyExistsExpr(existsExpr, exprHasNoFreeVariables);
+      expr = simplifyQuery(expr->getKid(1), exprHasNoFreeVariables, state,
+                           debugSubsumptionLevel);
     }
 
     // We finally simplify the conjunction using create()
@@ -1334,22 +1708,18 @@ bool TxSubsumptionTableEntry::subsumed(
                      state.txTreeNode->getNodeSequenceNumber(),
                      nodeSequenceNumber);
       }
-      return false;
+      return CheckFailure;
     }
 
-    bool success = false;
-
     if (!detectConflictPrimitives(state, expr)) {
       if (debugSubsumptionLevel >= 1) {
         klee_message(
             "#%lu=>#%lu: Check failure as contradictory equalities detected",
             state.txTreeNode->getNodeSequenceNumber(), nodeSequenceNumber);
       }
-      return false;
+      return CheckFailure;
     }
 
-    std::vector<ref<Expr> > unsatCore;
-
     // We call the solver only when the simplified query expression is not a
     // constant and no contradictory unary constraints found from
     // solvingUnaryConstraints method.
@@ -1376,7 +1746,7 @@ bool TxSubsumptionTableEntry::subsumed(
                          nodeSequenceNumber, msg.c_str());
           }
 
-          return true;
+          return CheckSuccess;
         } else {
           // Here we try to get bound-variables-free conjunction, if there is
           // no constraint with both bound and non-bound variables
@@ -1395,33 +1765,13 @@ bool TxSubsumptionTableEntry::subsumed(
                              state.constraints, expr).c_str());
           }
 
-          if (llvm::isa<ExistsExpr>(expr)) {
-            // We instantiate a new Z3 solver to make sure that we use Z3
-            // without pre-solving optimizations. It would be nice in the future
-            // to just run solver->evaluate so that the optimizations can be
-            // used, but this requires handling of quantified expressions by
-            // KLEE's pre-solving procedure, which does not exist currently.
-            Z3Solver *z3solver = new Z3Solver();
-            z3solver->setCoreSolverTimeout(timeout);
-            success = z3solver->directComputeValidity(
-                Query(state.constraints, expr), result, unsatCore);
-            z3solver->setCoreSolverTimeout(0);
-            delete z3solver;
-          } else {
-            solver->setTimeout(timeout);
-            success = solver->evaluate(state, expr, result, unsatCore);
-            solver->setTimeout(0);
-          }
-
-          if (!success || result != Solver::True) {
-            if (debugSubsumptionLevel >= 1) {
-              klee_message("#%lu=>#%lu: Check failure as solved did not decide "
-                           "validity of existentially-quantified query",
-                           state.txTreeNode->getNodeSequenceNumber(),
-                           nodeSequenceNumber);
-            }
-            return false;
-          }
+          // A query that remains quantified is sent by the solver to Z3
+          // without pre-solving optimizations, as KLEE's pre-solving
+          // procedure does not handle quantified expressions.
+          query.expr = expr;
+          query.existential = true;
+          query.interpolateValues = true;
+          return CheckNeedsSolver;
         }
 
       } else {
@@ -1432,18 +1782,9 @@ bool TxSubsumptionTableEntry::subsumed(
         }
         // We call the solver in the standard way if the
         // formula is unquantified.
-        solver->setTimeout(timeout);
-        success = solver->evaluate(state, expr, result, unsatCore);
-        solver->setTimeout(0);
-
-        if (!success || result != Solver::True) {
-          if (debugSubsumptionLevel >= 1) {
-            klee_message(
-                "#%lu=>#%lu: Check failure as solved did not decide validity",
-                state.txTreeNode->getNodeSequenceNumber(), nodeSequenceNumber);
-          }
-          return false;
-        }
+        query.expr = expr;
+        query.interpolateValues = true;
+        return CheckNeedsSolver;
       }
     } else {
       // expr is a constant expression
@@ -1459,15 +1800,37 @@ bool TxSubsumptionTableEntry::subsumed(
               msg.c_str());
         }
 
-        interpolateValues(state, coreValues, corePointerValues,
-                          debugSubsumptionLevel);
-        return true;
+        query.interpolateValues = true;
+        return CheckSuccess;
       }
       if (debugSubsumptionLevel >= 1) {
         klee_message(
             "#%lu=>#%lu: Check failure as query expression is non-true",
             state.txTreeNode->getNodeSequenceNumber(), nodeSequenceNumber);
       }
+      return CheckFailure;
+    }
+  }
+#endif /* ENABLE_Z3 */
+  return CheckFailure;
+}
+
+bool TxSubsumptionTableEntry::completeCheck(ExecutionState &state,
+                                            SubsumptionQuery &query,
+                                            bool success,
+                                            Solver::Validity result,
+                                            std::vector<ref<Expr> > &unsatCore,
+                                            int debugSubsumptionLevel) {
+  if (!query.expr.isNull()) {
+    if (!success || result != Solver::True) {
+      if (debugSubsumptionLevel >= 1) {
+        klee_message("#%lu=>#%lu: Check failure as solved did not decide "
+                     "validity%s",
+                     state.txTreeNode->getNodeSequenceNumber(),
+                     nodeSequenceNumber,
+                     query.existential ? " of existentially-quantified query"
+                                       : "");
+      }
       return false;
     }
 
@@ -1475,7 +1838,7 @@ bool TxSubsumptionTableEntry::subsumed(
     // path condition.
     if (debugSubsumptionLevel >= 1) {
       std::string msg = "";
-      if (!corePointerValues.empty()) {
+      if (!query.corePointerValues.empty()) {
         msg += " (with successful memory bound checks)";
       }
       klee_message("#%lu=>#%lu: Check success as solver decided validity%s",
@@ -1485,15 +1848,44 @@ bool TxSubsumptionTableEntry::subsumed(
 
     // We create path condition marking structure and mark core constraints
     state.txTreeNode->unsatCoreInterpolation(unsatCore);
+  }
 
-    interpolateValues(state, coreValues, corePointerValues,
+  if (query.interpolateValues)
+    interpolateValues(state, query.coreValues, query.corePointerValues,
                       debugSubsumptionLevel);
-    return true;
+  return true;
+}
+
+bool TxSubsumptionTableEntry::subsumed(TxSubsumptionSolver *solver,
+                                       ExecutionState &state, double timeout,
+                                       const TxStore::StateView &stateStore,
+                                       int debugSubsumptionLevel) {
+#ifdef ENABLE_Z3
+  // Tell the solver implementation that we are checking for subsumption for
+  // collecting statistics of solver calls.
+  SubsumptionCheckMarker subsumptionCheckMarker;
+
+  SubsumptionQuery query;
+  CheckResult checkResult =
+      prepareCheck(state, stateStore, debugSubsumptionLevel, query);
+  if (checkResult == CheckFailure)
+    return false;
+
+  bool success = true;
+  Solver::Validity result = Solver::True;
+  std::vector<ref<Expr> > unsatCore;
+
+  if (checkResult == CheckNeedsSolver) {
+    TimerStatIncrementer t(solverAccessTime);
+    success = solver->evaluate(state, query.expr, timeout, result, unsatCore);
   }
+  return completeCheck(state, query, success, result, unsatCore,
+                       debugSubsumptionLevel);
 #endif /* ENABLE_Z3 */
   return false;
 }
 
+
 ref<Expr> TxSubsumptionTableEntry::getInterpolant() const {
   return interpolant;
 }
@@ -1639,6 +2031,18 @@ void TxSubsumptionTableEntry::printStat(std::stringstream &stream) {
                 1000 << "\n";
   stream << "KLEE: done:     Solver access time (ms) = "
          << ((double)solverAccessTime.getValue()) / 1000 << "\n";
+  stream << "KLEE: done:     Subsumption solver cache hits / misses / "
+            "evictions = " << TxSubsumptionSolver::cacheHitCount << " / "
+         << TxSubsumptionSolver::cacheMissCount << " / "
+         << TxSubsumptionSolver::cacheEvictionCount << "\n";
+  stream << "KLEE: done:     Existential query simplification cache hits / "
+            "misses = " << simplificationCacheHitCount << " / "
+         << simplificationCacheMissCount << "\n";
+  stream << "KLEE: done:     Table entries examined by pre-filters = "
+         << prefilterCheckCount << "\n";
+  stream << "KLEE: done:     Table entries rejected by context / constant "
+            "pre-filters = " << contextFilterRejectCount << " / "
+         << constantFilterRejectCount << "\n";
 }
 
 /**/
@@ -1699,13 +2103,20 @@ void TxSubsumptionTable::CallHistoryIndexedTable::clearTree(Node *node) {
 }
 
 void TxSubsumptionTable::CallHistoryIndexedTable::insert(
-    const std::vector<llvm::Instruction *> &callHistory,
+    const TxCallHistory *callHistory,
     TxSubsumptionTableEntry *entry) {
-  Node *current = root;
+  std::map<const TxCallHistory *, Node *>::const_iterator indexIt =
+      index.find(callHistory);
+  if (indexIt != index.end()) {
+    indexIt->second->entryList.push_back(entry);
+    return;
+  }
 
+  Node *current = root;
+  std::vector<llvm::Instruction *> callSites = callHistory->getCallSites();
   for (std::vector<llvm::Instruction *>::const_iterator
-           it = callHistory.begin(),
-           ie = callHistory.end();
+           it = callSites.begin(),
+           ie = callSites.end();
        it != ie; ++it) {
     llvm::Instruction *call = *it;
     std::map<llvm::Instruction *, Node *>::const_iterator it1 =
@@ -1718,28 +2129,74 @@ void TxSubsumptionTable::CallHistoryIndexedTable::insert(
       current = it1->second;
     }
   }
+  index[callHistory] = current;
   current->entryList.push_back(entry);
 }
 
+void TxSubsumptionTable::CallHistoryIndexedTable::getEntries(
+    std::vector<TxSubsumptionTableEntry *> &entries) const {
+  // Every node with entries is indexed
+  for (std::map<const TxCallHistory *, Node *>::const_iterator
+           it = index.begin(),
+           ie = index.end();
+       it != ie; ++it) {
+    entries.insert(entries.end(), it->second->entryList.begin(),
+                   it->second->entryList.end());
+  }
+}
+
+void TxSubsumptionTable::CallHistoryIndexedTable::removeEntries(
+    const std::set<TxSubsumptionTableEntry *> &entries) {
+  for (std::map<const TxCallHistory *, Node *>::iterator it = index.begin(),
+                                                         ie = index.end();
+       it != ie; ++it) {
+    std::deque<TxSubsumptionTableEntry *> &entryList = it->second->entryList;
+    std::deque<TxSubsumptionTableEntry *> kept;
+    for (std::deque<TxSubsumptionTableEntry *>::iterator
+             it1 = entryList.begin(),
+             ie1 = entryList.end();
+         it1 != ie1; ++it1) {
+      if (entries.find(*it1) == entries.end())
+        kept.push_back(*it1);
+    }
+    entryList.swap(kept);
+  }
+}
+
+TxSubsumptionTable::CheckProfile *
+TxSubsumptionTable::CallHistoryIndexedTable::getProfile(
+    const TxCallHistory *callHistory) {
+  std::map<const TxCallHistory *, Node *>::const_iterator it =
+      index.find(callHistory);
+  if (it == index.end())
+    return 0;
+  return &it->second->profile;
+}
+
+void TxSubsumptionTable::CallHistoryIndexedTable::getProfiles(
+    std::vector<std::pair<const TxCallHistory *, const CheckProfile *> > &
+        profiles) const {
+  for (std::map<const TxCallHistory *, Node *>::const_iterator
+           it = index.begin(),
+           ie = index.end();
+       it != ie; ++it) {
+    if (it->second->profile.checkCount)
+      profiles.push_back(std::make_pair(it->first, &it->second->profile));
+  }
+}
+
 std::pair<TxSubsumptionTable::EntryIterator, TxSubsumptionTable::EntryIterator>
 TxSubsumptionTable::CallHistoryIndexedTable::find(
-    const std::vector<llvm::Instruction *> &callHistory, bool &found) const {
-  Node *current = root;
+    const TxCallHistory *callHistory, bool &found) const {
   std::pair<EntryIterator, EntryIterator> ret;
 
-  for (std::vector<llvm::Instruction *>::const_iterator
-           it = callHistory.begin(),
-           ie = callHistory.end();
-       it != ie; ++it) {
-    llvm::Instruction *call = *it;
-    std::map<llvm::Instruction *, Node *>::const_iterator it1 =
-        current->next.find(call);
-    if (it1 == current->next.end()) {
-      found = false;
-      return ret;
-    }
-    current = it1->second;
+  std::map<const TxCallHistory *, Node *>::const_iterator it =
+      index.find(callHistory);
+  if (it == index.end()) {
+    found = false;
+    return ret;
   }
+  Node *current = it->second;
   found = true;
   return std::pair<EntryIterator, EntryIterator>(current->entryList.rbegin(),
                                                  current->entryList.rend());
@@ -1769,14 +2226,39 @@ void TxSubsumptionTable::CallHistoryIndexedTable::print(
 std::map<uintptr_t, TxSubsumptionTable::CallHistoryIndexedTable *>
 TxSubsumptionTable::instance;
 
+std::map<llvm::Function *,
+         std::map<uintptr_t, std::deque<TxSubsumptionTableEntry *> > >
+TxSubsumptionTable::summaries;
+
+uint64_t TxSubsumptionTable::summaryCheckCount = 0;
+
+uint64_t TxSubsumptionTable::summaryHitCount = 0;
+
+uint64_t TxSubsumptionTable::tableSize = 0;
+
+uint64_t TxSubsumptionTable::insertionCount = 0;
+
+uint64_t TxSubsumptionTable::evictionCount = 0;
+
+uint64_t TxSubsumptionTable::evictedSize = 0;
+
+uint64_t TxSubsumptionTable::loadCount = 0;
+
+uint64_t TxSubsumptionTable::loadedHitCount = 0;
+
+uint64_t TxSubsumptionTable::saveCount = 0;
+
 void
 TxSubsumptionTable::insert(uintptr_t id,
-                           const std::vector<llvm::Instruction *> &callHistory,
+                           const TxCallHistory *callHistory,
                            TxSubsumptionTableEntry *entry) {
   CallHistoryIndexedTable *subTable = 0;
 
   TxTree::entryNumber++; // Count of entries in the table
 
+  entry->insertionTime = insertionCount++;
+  tableSize += entry->size;
+
   std::map<uintptr_t, CallHistoryIndexedTable *>::iterator it =
       instance.find(id);
 
@@ -1784,32 +2266,110 @@ TxSubsumptionTable::insert(uintptr_t id,
     subTable = new CallHistoryIndexedTable();
     subTable->insert(callHistory, entry);
     instance[id] = subTable;
-    return;
+  } else {
+    subTable = it->second;
+    subTable->insert(callHistory, entry);
   }
-  subTable = it->second;
-  subTable->insert(callHistory, entry);
-}
 
-bool TxSubsumptionTable::check(TimingSolver *solver, ExecutionState &state,
-                               double timeout, int debugSubsumptionLevel) {
-  CallHistoryIndexedTable *subTable = 0;
-  TxTreeNode *txTreeNode = state.txTreeNode;
+  if (FunctionSummaries && entry->isContextIndependent()) {
+    llvm::Function *function =
+        reinterpret_cast<llvm::Instruction *>(id)->getParent()->getParent();
+    summaries[function][id].push_back(entry);
+  }
 
-  std::map<uintptr_t, CallHistoryIndexedTable *>::iterator it =
-      instance.find(state.txTreeNode->getProgramPoint());
-  if (it == instance.end()) {
-    if (debugSubsumptionLevel >= 1) {
-      klee_message(
-          "#%lu: Check failure due to control point not found in table",
-          state.txTreeNode->getNodeSequenceNumber());
-    }
-    return false;
+  if (MaxSubsumptionTableMB &&
+      tableSize > ((uint64_t)MaxSubsumptionTableMB << 20))
+    evict();
+}
+
+void TxSubsumptionTable::evict() {
+  std::vector<TxSubsumptionTableEntry *> entries;
+  for (std::map<uintptr_t, CallHistoryIndexedTable *>::const_iterator
+           it = instance.begin(),
+           ie = instance.end();
+       it != ie; ++it) {
+    it->second->getEntries(entries);
+  }
+  std::sort(entries.begin(), entries.end(),
+            TxSubsumptionTableEntry::lessUseful);
+
+  // We evict down to three quarters of the budget, so that the table, which
+  // is visited entirely, is not sorted again at the next insertion.
+  uint64_t budget = (uint64_t)MaxSubsumptionTableMB << 20;
+  uint64_t target = budget - budget / 4;
+  std::set<TxSubsumptionTableEntry *> evicted;
+  for (std::vector<TxSubsumptionTableEntry *>::iterator it = entries.begin(),
+                                                        ie = entries.end();
+       it != ie && tableSize > target; ++it) {
+    // The entry just inserted is kept, as the caller still refers to it
+    if ((*it)->insertionTime + 1 == insertionCount)
+      continue;
+    evicted.insert(*it);
+    tableSize -= (*it)->size;
+    evictedSize += (*it)->size;
+    ++evictionCount;
+    --TxTree::entryNumber;
   }
-  subTable = it->second;
 
-  bool found;
-  std::pair<EntryIterator, EntryIterator> iterPair =
-      subTable->find(txTreeNode->entryCallHistory, found);
+  for (std::map<uintptr_t, CallHistoryIndexedTable *>::iterator
+           it = instance.begin(),
+           ie = instance.end();
+       it != ie; ++it) {
+    it->second->removeEntries(evicted);
+  }
+
+  for (std::map<llvm::Function *,
+                std::map<uintptr_t, std::deque<TxSubsumptionTableEntry *> > >::
+           iterator it = summaries.begin(),
+                    ie = summaries.end();
+       it != ie; ++it) {
+    for (std::map<uintptr_t, std::deque<TxSubsumptionTableEntry *> >::iterator
+             it1 = it->second.begin(),
+             ie1 = it->second.end();
+         it1 != ie1; ++it1) {
+      std::deque<TxSubsumptionTableEntry *> &entryList = it1->second;
+      std::deque<TxSubsumptionTableEntry *> kept;
+      for (std::deque<TxSubsumptionTableEntry *>::iterator
+               entryIt = entryList.begin(),
+               entryIe = entryList.end();
+           entryIt != entryIe; ++entryIt) {
+        if (!evicted.count(*entryIt))
+          kept.push_back(*entryIt);
+      }
+      entryList.swap(kept);
+    }
+  }
+
+  for (std::set<TxSubsumptionTableEntry *>::iterator it = evicted.begin(),
+                                                     ie = evicted.end();
+       it != ie; ++it) {
+    // The graph would otherwise draw subsumption edges to a deleted entry
+    TxTreeGraph::removeTableEntryMapping(*it);
+    delete *it;
+  }
+}
+
+bool TxSubsumptionTable::check(TxSubsumptionSolver *solver,
+                               ExecutionState &state, double timeout,
+                               int debugSubsumptionLevel) {
+  CallHistoryIndexedTable *subTable = 0;
+  TxTreeNode *txTreeNode = state.txTreeNode;
+
+  std::map<uintptr_t, CallHistoryIndexedTable *>::iterator it =
+      instance.find(state.txTreeNode->getProgramPoint());
+  if (it == instance.end()) {
+    if (debugSubsumptionLevel >= 1) {
+      klee_message(
+          "#%lu: Check failure due to control point not found in table",
+          state.txTreeNode->getNodeSequenceNumber());
+    }
+    return false;
+  }
+  subTable = it->second;
+
+  bool found;
+  std::pair<EntryIterator, EntryIterator> iterPair =
+      subTable->find(txTreeNode->entryCallHistory, found);
   if (!found) {
     if (debugSubsumptionLevel >= 1) {
       klee_message("#%lu: Check failure due to entry not found",
@@ -1818,45 +2378,218 @@ bool TxSubsumptionTable::check(TimingSolver *solver, ExecutionState &state,
     return false;
   }
 
-  if (iterPair.first != iterPair.second) {
+  uint64_t scannedCount = 0;
+  if (!SubsumptionProfile)
+    return checkEntries(solver, state, timeout, iterPair,
+                        debugSubsumptionLevel, scannedCount);
+
+  CheckProfile *profile = subTable->getProfile(txTreeNode->entryCallHistory);
+  WallTimer timer;
+  uint64_t solverCallCount = stats::subsumptionQueryCount.getValue();
+
+  bool success = checkEntries(solver, state, timeout, iterPair,
+                              debugSubsumptionLevel, scannedCount);
+
+  ++profile->checkCount;
+  if (success)
+    ++profile->successCount;
+  profile->scannedCount += scannedCount;
+  profile->solverCallCount +=
+      stats::subsumptionQueryCount.getValue() - solverCallCount;
+  profile->time += timer.check();
+  return success;
+}
 
-    TxStore::TopInterpolantStore concretelyAddressedStore;
-    TxStore::TopInterpolantStore symbolicallyAddressedStore;
-    TxStore::LowerInterpolantStore concretelyAddressedHistoricalStore;
-    TxStore::LowerInterpolantStore symbolicallyAddressedHistoricalStore;
+bool TxSubsumptionTable::checkSummaries(TxSubsumptionSolver *solver,
+                                        ExecutionState &state, double timeout,
+                                        int debugSubsumptionLevel) {
+  uintptr_t programPoint = state.txTreeNode->getProgramPoint();
+  std::map<llvm::Function *,
+           std::map<uintptr_t, std::deque<TxSubsumptionTableEntry *> > >::
+      iterator functionIt = summaries.find(
+          reinterpret_cast<llvm::Instruction *>(programPoint)
+              ->getParent()
+              ->getParent());
+  if (functionIt == summaries.end())
+    return false;
+
+  std::map<uintptr_t, std::deque<TxSubsumptionTableEntry *> >::iterator it =
+      functionIt->second.find(programPoint);
+  if (it == functionIt->second.end())
+    return false;
+
+  // The summaries of the call history of the state were already checked
+  // against in the call history indexed table
+  std::deque<TxSubsumptionTableEntry *> candidates;
+  for (std::deque<TxSubsumptionTableEntry *>::iterator
+           entryIt = it->second.begin(),
+           entryIe = it->second.end();
+       entryIt != entryIe; ++entryIt) {
+    if ((*entryIt)->callHistory != state.txTreeNode->entryCallHistory)
+      candidates.push_back(*entryIt);
+  }
+  if (candidates.empty())
+    return false;
+
+  ++summaryCheckCount;
+
+  uint64_t scannedCount = 0;
+  if (!checkEntries(solver, state, timeout,
+                    std::make_pair(candidates.rbegin(), candidates.rend()),
+                    debugSubsumptionLevel, scannedCount))
+    return false;
 
-    bool leftRetrieval;
-    TxStore::TopStateStore __internalStore;
-    TxStore::LowerStateStore __concretelyAddressedHistoricalStore;
-    TxStore::LowerStateStore __symbolicallyAddressedHistoricalStore;
+  if (debugSubsumptionLevel >= 1) {
+    klee_message("#%lu: Subsumed by a summary of another call history",
+                 state.txTreeNode->getNodeSequenceNumber());
+  }
+  ++summaryHitCount;
+  return true;
+}
 
-    txTreeNode->getStoredExpressions(txTreeNode->entryCallHistory,
-                                     leftRetrieval, __internalStore,
-                                     __concretelyAddressedHistoricalStore,
-                                     __symbolicallyAddressedHistoricalStore);
+bool TxSubsumptionTable::hasEntries(uintptr_t id,
+                                    const TxCallHistory *callHistory) {
+  std::map<uintptr_t, CallHistoryIndexedTable *>::iterator it =
+      instance.find(id);
+  if (it == instance.end())
+    return false;
+
+  bool found;
+  std::pair<EntryIterator, EntryIterator> iterPair =
+      it->second->find(callHistory, found);
+  return found && iterPair.first != iterPair.second;
+}
+
+bool TxSubsumptionTable::checkEntries(
+    TxSubsumptionSolver *solver, ExecutionState &state, double timeout,
+    std::pair<EntryIterator, EntryIterator> iterPair,
+    int debugSubsumptionLevel, uint64_t &scannedCount) {
+  TxTreeNode *txTreeNode = state.txTreeNode;
+
+  if (iterPair.first != iterPair.second) {
+    TxStore::StateView stateStore = txTreeNode->getStoredExpressions();
+
+    if (solver->isParallel()) {
+      return checkInParallel(solver, state, timeout, iterPair, stateStore,
+                             debugSubsumptionLevel, scannedCount);
+    }
 
     // Iterate the subsumption table entry with reverse iterator because
     // the successful subsumption mostly happen in the newest entry.
     for (EntryIterator it = iterPair.first, ie = iterPair.second; it != ie;
          ++it) {
-      if ((*it)->subsumed(solver, state, timeout, leftRetrieval,
-                          __internalStore, __concretelyAddressedHistoricalStore,
-                          __symbolicallyAddressedHistoricalStore,
+      ++scannedCount;
+      if ((*it)->prefiltered(state, stateStore, debugSubsumptionLevel))
+        continue;
+
+      if ((*it)->subsumed(solver, state, timeout, stateStore,
                           debugSubsumptionLevel)) {
+        ++(*it)->subsumptionCount;
+        if ((*it)->loaded)
+          ++loadedHitCount;
+
         // We mark as subsumed such that the node will not be
         // stored into table (the table already contains a more
         // general entry).
         txTreeNode->isSubsumed = true;
+        txTreeNode->reachFrameDepth((*it)->leastFrameDepth);
 
         // Mark the node as subsumed, and create a subsumption edge
         TxTreeGraph::markAsSubsumed(txTreeNode, (*it));
         return true;
       }
+      ++(*it)->failedCheckCount;
     }
   }
   return false;
 }
 
+bool TxSubsumptionTable::checkInParallel(
+    TxSubsumptionSolver *solver, ExecutionState &state, double timeout,
+    std::pair<EntryIterator, EntryIterator> iterPair,
+    const TxStore::StateView &stateStore, int debugSubsumptionLevel,
+    uint64_t &scannedCount) {
+  TxTreeNode *txTreeNode = state.txTreeNode;
+
+  // The entries needing the solver, up to the first entry that subsumes the
+  // state without the solver, if any. The chosen entry is the first of these
+  // to subsume the state, as in the sequential check.
+  std::vector<TxSubsumptionTableEntry *> entries;
+  std::vector<TxSubsumptionTableEntry::SubsumptionQuery> queries;
+  TxSubsumptionTableEntry *decidedEntry = 0;
+  TxSubsumptionTableEntry::SubsumptionQuery decidedQuery;
+
+  for (EntryIterator it = iterPair.first, ie = iterPair.second; it != ie;
+       ++it) {
+    ++scannedCount;
+    if ((*it)->prefiltered(state, stateStore, debugSubsumptionLevel))
+      continue;
+
+    TxSubsumptionTableEntry::SubsumptionQuery query;
+    TxSubsumptionTableEntry::CheckResult checkResult = (*it)->prepareCheck(
+        state, stateStore, debugSubsumptionLevel, query);
+    if (checkResult == TxSubsumptionTableEntry::CheckFailure) {
+      ++(*it)->failedCheckCount;
+      continue;
+    }
+    if (checkResult == TxSubsumptionTableEntry::CheckSuccess) {
+      decidedEntry = *it;
+      decidedQuery = query;
+      break;
+    }
+    entries.push_back(*it);
+    queries.push_back(query);
+  }
+
+  std::vector<ref<Expr> > exprs;
+  for (std::vector<TxSubsumptionTableEntry::SubsumptionQuery>::iterator
+           it = queries.begin(),
+           ie = queries.end();
+       it != ie; ++it) {
+    exprs.push_back(it->expr);
+  }
+
+  std::vector<ref<Expr> > unsatCore;
+  unsigned first = exprs.size();
+  if (!exprs.empty()) {
+    TimerStatIncrementer t(TxSubsumptionTableEntry::solverAccessTime);
+    first = solver->evaluateFirstValid(state, exprs, timeout, unsatCore);
+  }
+
+  // Report the failures before the chosen entry, as the sequential check
+  for (unsigned i = 0; i < first; ++i) {
+    std::vector<ref<Expr> > noCore;
+    entries[i]->completeCheck(state, queries[i], false, Solver::Unknown,
+                              noCore, debugSubsumptionLevel);
+    ++entries[i]->failedCheckCount;
+  }
+
+  TxSubsumptionTableEntry *entry = 0;
+  if (first < entries.size()) {
+    entry = entries[first];
+    entry->completeCheck(state, queries[first], true, Solver::True, unsatCore,
+                         debugSubsumptionLevel);
+  } else if (decidedEntry) {
+    entry = decidedEntry;
+    entry->completeCheck(state, decidedQuery, true, Solver::True, unsatCore,
+                         debugSubsumptionLevel);
+  } else {
+    return false;
+  }
+  ++entry->subsumptionCount;
+  if (entry->loaded)
+    ++loadedHitCount;
+
+  // We mark as subsumed such that the node will not be stored into table
+  // (the table already contains a more general entry).
+  txTreeNode->isSubsumed = true;
+  txTreeNode->reachFrameDepth(entry->leastFrameDepth);
+
+  // Mark the node as subsumed, and create a subsumption edge
+  TxTreeGraph::markAsSubsumed(txTreeNode, entry);
+  return true;
+}
+
 void TxSubsumptionTable::clear() {
   for (std::map<uintptr_t, CallHistoryIndexedTable *>::iterator
            it = instance.begin(),
@@ -1867,6 +2600,1001 @@ void TxSubsumptionTable::clear() {
       delete it->second;
     }
   }
+  summaries.clear();
+}
+
+void TxSubsumptionTable::printStat(std::stringstream &stream) {
+  stream << "KLEE: done:     Table entries evicted (estimated bytes freed) = "
+         << evictionCount << " (" << evictedSize << ")\n";
+  stream << "KLEE: done:     Table entries loaded from file = " << loadCount
+         << "\n";
+  stream << "KLEE: done:     Subsumptions by table entries loaded from file = "
+         << loadedHitCount << "\n";
+  stream << "KLEE: done:     Table entries saved to file = " << saveCount
+         << "\n";
+  stream << "KLEE: done:     Function summary checks from other call "
+            "histories (successful) = " << summaryCheckCount << " ("
+         << summaryHitCount << ")\n";
+}
+
+/// \brief The version of the format of the table files
+static const unsigned tableFileVersion = 3;
+
+/// \brief A hash of the textual form of the module, with which a table file
+/// is rejected when written for another module, as the instruction
+/// identifiers in the file would refer to other instructions. The options
+/// that change the interpolants are hashed as well, as the entries computed
+/// under other settings may be unsound, or useless, for this run.
+static uint64_t getModuleHash(KModule *kmodule) {
+  std::string text;
+  llvm::raw_string_ostream stream(text);
+
+  // The module identifier is the path of the bitcode file, which is not part
+  // of the module content
+  std::string identifier = kmodule->module->getModuleIdentifier();
+  kmodule->module->setModuleIdentifier("");
+  kmodule->module->print(stream, 0);
+  kmodule->module->setModuleIdentifier(identifier);
+  stream << "no-existential=" << NoExistential
+         << " exact-address-interpolant=" << ExactAddressInterpolant
+         << " special-function-bound-interpolation="
+         << SpecialFunctionBoundInterpolation
+         << " tracerx-pointer-error=" << TracerXPointerError
+         << " store-relevance-analysis=" << StoreRelevanceAnalysis << "\n";
+  stream.flush();
+
+  // The 64-bit FNV-1a hash
+  uint64_t hash = 14695981039346656037ULL;
+  for (std::string::const_iterator it = text.begin(), ie = text.end();
+       it != ie; ++it) {
+    hash ^= static_cast<unsigned char>(*it);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/// \brief The prefix of the names of the arrays that stand for the
+/// existentially-quantified subexpressions in a table file, as the KQuery
+/// language has no quantifiers
+static const char *const quantifierMarkerPrefix = "__tx_exists_";
+
+namespace {
+/// \brief Replaces the arrays of an expression with the arrays of the same
+/// name and size of an array cache. Symbolic arrays are unique in a cache,
+/// hence the arrays of a parsed expression become those of the states. The
+/// comparisons of the marker arrays of quantifiers become the quantifiers.
+class TxArrayRebindingVisitor : public ExprVisitor {
+  ArrayCache &arrayCache;
+
+  std::map<const Array *, const Array *> rebound;
+
+  /// \brief The bodies and the variables of the quantifiers, indexed by the
+  /// names of their marker arrays
+  std::map<std::string, std::pair<ref<Expr>, std::set<const Array *> > >
+  quantifiers;
+
+  const UpdateNode *rebind(const UpdateNode *update) {
+    if (!update)
+      return 0;
+    return new UpdateNode(rebind(update->next), visit(update->index),
+                          visit(update->value));
+  }
+
+public:
+  TxArrayRebindingVisitor(ArrayCache &_arrayCache) : arrayCache(_arrayCache) {}
+
+  const Array *rebind(const Array *array) {
+    std::map<const Array *, const Array *>::iterator it = rebound.find(array);
+    if (it != rebound.end())
+      return it->second;
+
+    const Array *result;
+    if (array->isConstantArray()) {
+      result = arrayCache.CreateArray(
+          array->name, array->size, &array->constantValues[0],
+          &array->constantValues[0] + array->constantValues.size(),
+          array->domain, array->range);
+    } else {
+      result = arrayCache.CreateArray(array->name, array->size, 0, 0,
+                                      array->domain, array->range);
+    }
+    rebound[array] = result;
+    return result;
+  }
+
+  void addQuantifier(const std::string &markerName, ref<Expr> body,
+                     const std::set<const Array *> &variables) {
+    quantifiers[markerName] = std::make_pair(body, variables);
+  }
+
+  Action visitEq(const EqExpr &e) {
+    const ReadExpr *re = llvm::dyn_cast<ReadExpr>(e.right);
+    if (!re)
+      return Action::doChildren();
+
+    std::map<std::string,
+             std::pair<ref<Expr>, std::set<const Array *> > >::iterator it =
+        quantifiers.find(re->updates.root->name);
+    if (it == quantifiers.end())
+      return Action::doChildren();
+
+    std::set<const Array *> variables;
+    for (std::set<const Array *>::iterator it1 = it->second.second.begin(),
+                                           ie1 = it->second.second.end();
+         it1 != ie1; ++it1) {
+      variables.insert(rebind(*it1));
+    }
+    return Action::changeTo(
+        ExistsExpr::create(variables, visit(it->second.first)));
+  }
+
+  Action visitRead(const ReadExpr &re) {
+    UpdateList updates(rebind(re.updates.root), rebind(re.updates.head));
+    return Action::changeTo(ReadExpr::create(updates, visit(re.index)));
+  }
+};
+
+/// \brief Writes the record of a table entry: its quantified subexpressions,
+/// its existentially-quantified variables, and the cells of its interpolant
+/// stores. The expressions are written as indices into exprs and the arrays
+/// as indices into arrays, the values and the objects of the KQuery query of
+/// the entry, in which the quantified subexpressions are replaced by
+/// comparisons of marker arrays.
+class TxTableRecordWriter : public ExprVisitor {
+  KModule *kmodule;
+
+  /// \brief The cache of the marker arrays of the quantifiers
+  ArrayCache markerCache;
+
+  std::map<const Array *, unsigned> arrayIndices;
+
+  unsigned quantifierCount;
+
+  std::ostringstream quantifiers;
+
+  std::ostringstream existentials;
+
+  std::ostringstream stores;
+
+  unsigned addArray(const Array *array) {
+    std::map<const Array *, unsigned>::iterator it = arrayIndices.find(array);
+    if (it != arrayIndices.end())
+      return it->second;
+    arrayIndices[array] = arrays.size();
+    arrays.push_back(array);
+    return arrays.size() - 1;
+  }
+
+  unsigned addExpr(ref<Expr> expr) {
+    ref<Expr> marked = visit(expr);
+    exprs.push_back(marked);
+    return exprs.size() - 1;
+  }
+
+  /// \brief Writes an instruction as its identifier, and a global or an
+  /// argument by its name, which are the same in runs on the same module.
+  ///
+  /// \return false if the value is not null and cannot be written.
+  bool writeValue(llvm::Value *value) {
+    if (!value) {
+      stores << " n";
+    } else if (llvm::Instruction *inst =
+                   llvm::dyn_cast<llvm::Instruction>(value)) {
+      stores << " i " << kmodule->infos->getInfo(inst).id;
+    } else if (llvm::isa<llvm::GlobalValue>(value) && value->hasName()) {
+      std::string name = value->getName().str();
+      stores << " g " << name.size() << " " << name;
+    } else if (llvm::Argument *arg = llvm::dyn_cast<llvm::Argument>(value)) {
+      std::string name = arg->getParent()->getName().str();
+      stores << " a " << name.size() << " " << name << " " << arg->getArgNo();
+    } else {
+      stores << " n";
+      return false;
+    }
+    return true;
+  }
+
+  void writeContext(ref<TxAllocationContext> context) {
+    if (!writeValue(context->getValue()))
+      valid = false;
+
+    std::vector<llvm::Instruction *> callSites =
+        context->getCallHistory()->getCallSites();
+    stores << " " << context->isRelative() << " " << callSites.size();
+    for (std::vector<llvm::Instruction *>::iterator it = callSites.begin(),
+                                                    ie = callSites.end();
+         it != ie; ++it) {
+      stores << " " << kmodule->infos->getInfo(*it).id;
+    }
+  }
+
+  void writeAllocationInfo(ref<TxAllocationInfo> allocInfo) {
+    writeContext(allocInfo->getContext());
+    stores << " " << addExpr(allocInfo->getBase()) << " "
+           << allocInfo->getSize();
+  }
+
+  void writeVariable(ref<TxVariable> variable) {
+    writeAllocationInfo(variable->getAllocationInfo());
+    stores << " " << addExpr(variable->getOffset());
+  }
+
+  void writeInterpolantValue(ref<TxInterpolantValue> value) {
+    // The LLVM value of a stored value is only printed, hence it is omitted
+    // when it cannot be written
+    writeValue(value->getValue());
+    stores << " " << addExpr(value->getExpression()) << " "
+           << value->useBound();
+
+    const std::map<ref<TxAllocationInfo>, std::set<uint64_t> > &bounds =
+        value->getAllocationBounds();
+    stores << " " << bounds.size();
+    for (std::map<ref<TxAllocationInfo>, std::set<uint64_t> >::const_iterator
+             it = bounds.begin(),
+             ie = bounds.end();
+         it != ie; ++it) {
+      writeAllocationInfo(it->first);
+      stores << " " << it->second.size();
+      for (std::set<uint64_t>::const_iterator it1 = it->second.begin(),
+                                              ie1 = it->second.end();
+           it1 != ie1; ++it1) {
+        stores << " " << *it1;
+      }
+    }
+
+    const std::map<ref<TxAllocationInfo>, std::set<ref<Expr> > > &offsets =
+        value->getAllocationOffsets();
+    stores << " " << offsets.size();
+    for (std::map<ref<TxAllocationInfo>,
+                  std::set<ref<Expr> > >::const_iterator it = offsets.begin(),
+                                                         ie = offsets.end();
+         it != ie; ++it) {
+      writeAllocationInfo(it->first);
+      stores << " " << it->second.size();
+      for (std::set<ref<Expr> >::const_iterator it1 = it->second.begin(),
+                                                ie1 = it->second.end();
+           it1 != ie1; ++it1) {
+        stores << " " << addExpr(*it1);
+      }
+    }
+  }
+
+public:
+  std::vector<ref<Expr> > exprs;
+
+  std::vector<const Array *> arrays;
+
+  /// \brief False once an allocation site that cannot be written is met
+  bool valid;
+
+  TxTableRecordWriter(KModule *_kmodule)
+      : kmodule(_kmodule), quantifierCount(0), valid(true) {}
+
+  /// \brief Replaces a quantified expression, the body of which is already
+  /// visited, by a comparison of the byte of a new marker array with one, as
+  /// the arrays of the KQuery language have byte values
+  Action visitExprPost(const Expr &e) {
+    const ExistsExpr *existsExpr = llvm::dyn_cast<ExistsExpr>(&e);
+    if (!existsExpr)
+      return Action::skipChildren();
+
+    std::ostringstream name;
+    name << quantifierMarkerPrefix << quantifierCount++;
+    const Array *marker = markerCache.CreateArray(name.str(), 1);
+
+    exprs.push_back(existsExpr->body);
+    quantifiers << " " << exprs.size() - 1 << " "
+                << existsExpr->variables.size();
+    for (std::set<const Array *>::const_iterator
+             it = existsExpr->variables.begin(),
+             ie = existsExpr->variables.end();
+         it != ie; ++it) {
+      quantifiers << " " << addArray(*it);
+    }
+    return Action::changeTo(EqExpr::create(
+        ConstantExpr::create(1, Expr::Int8),
+        ReadExpr::create(UpdateList(marker, 0),
+                         ConstantExpr::create(0, Expr::Int32))));
+  }
+
+  void writeExistentials(const std::set<const Array *> &variables) {
+    existentials << " " << variables.size();
+    for (std::set<const Array *>::const_iterator it = variables.begin(),
+                                                 ie = variables.end();
+         it != ie; ++it) {
+      existentials << " " << addArray(*it);
+    }
+  }
+
+  void writeStore(const TxStore::TopInterpolantStore &store) {
+    stores << " " << store.size();
+    for (TxStore::TopInterpolantStore::const_iterator it = store.begin(),
+                                                      ie = store.end();
+         it != ie; ++it) {
+      writeContext(it->first);
+      writeStore(it->second);
+    }
+  }
+
+  void writeStore(const TxStore::LowerInterpolantStore &store) {
+    stores << " " << store.size();
+    for (TxStore::LowerInterpolantStore::const_iterator it = store.begin(),
+                                                        ie = store.end();
+         it != ie; ++it) {
+      writeVariable(it->first);
+      writeInterpolantValue(it->second);
+    }
+  }
+
+  /// \brief The record, which starts with whether the entry has an
+  /// interpolant, the query expression of the entry otherwise being false
+  std::string getRecord(bool hasInterpolant) const {
+    std::ostringstream record;
+    record << hasInterpolant << " " << quantifierCount << quantifiers.str()
+           << existentials.str() << stores.str();
+    return record.str();
+  }
+};
+
+/// \brief Reads the record of a table entry written by TxTableRecordWriter,
+/// with the values and the objects of the parsed KQuery query of the entry.
+class TxTableRecordReader {
+  std::istringstream stream;
+
+  const std::map<unsigned, llvm::Instruction *> &instructions;
+
+  llvm::Module *module;
+
+  /// \brief The values of the query, with the arrays of the states
+  std::vector<ref<Expr> > exprs;
+
+  /// \brief False once the record is found to be invalid for the module
+  bool valid;
+
+  unsigned readCount() {
+    unsigned count = 0;
+    if (!(stream >> count))
+      valid = false;
+    return count;
+  }
+
+  ref<Expr> readExpr() {
+    unsigned index = readCount();
+    if (index < exprs.size())
+      return exprs[index];
+    valid = false;
+    return ConstantExpr::create(0, Expr::Int64);
+  }
+
+  llvm::Instruction *readInstruction() {
+    std::map<unsigned, llvm::Instruction *>::const_iterator it =
+        instructions.find(readCount());
+    if (it != instructions.end())
+      return it->second;
+    valid = false;
+    return 0;
+  }
+
+  std::string readName() {
+    size_t length = readCount();
+    stream.get(); // The separating space
+    std::string name(length, ' ');
+    if (length)
+      stream.read(&name[0], length);
+    if (!stream)
+      valid = false;
+    return name;
+  }
+
+  llvm::Value *readValue() {
+    std::string kind;
+    stream >> kind;
+    if (kind == "i")
+      return readInstruction();
+
+    if (kind == "g") {
+      llvm::GlobalValue *global = module->getNamedValue(readName());
+      if (!global)
+        valid = false;
+      return global;
+    }
+
+    if (kind == "a") {
+      llvm::Function *f = module->getFunction(readName());
+      unsigned argNo = readCount();
+      if (!f || argNo >= f->arg_size()) {
+        valid = false;
+        return 0;
+      }
+      llvm::Function::arg_iterator it = f->arg_begin();
+      std::advance(it, argNo);
+      return &*it;
+    }
+
+    if (kind != "n")
+      valid = false;
+    return 0;
+  }
+
+  ref<TxAllocationContext> readContext() {
+    llvm::Value *value = readValue();
+    bool relative = readCount();
+    const TxCallHistory *callHistory = TxCallHistory::getEmpty();
+    for (unsigned i = 0, n = readCount(); i < n && valid; ++i) {
+      llvm::Instruction *callSite = readInstruction();
+      if (callSite)
+        callHistory = callHistory->push(callSite);
+    }
+    return TxAllocationContext::create(value, callHistory, relative);
+  }
+
+  ref<TxAllocationInfo> readAllocationInfo() {
+    ref<TxAllocationContext> context = readContext();
+    ref<Expr> base = readExpr();
+    uint64_t size = 0;
+    if (!(stream >> size))
+      valid = false;
+    return TxAllocationInfo::create(context, base, size);
+  }
+
+  ref<TxVariable> readVariable() {
+    ref<TxAllocationInfo> allocInfo = readAllocationInfo();
+    return TxVariable::create(allocInfo, readExpr());
+  }
+
+  ref<TxInterpolantValue> readInterpolantValue() {
+    llvm::Value *value = readValue();
+    ref<Expr> expr = readExpr();
+    bool useBound = readCount();
+
+    std::map<ref<TxAllocationInfo>, std::set<uint64_t> > bounds;
+    for (unsigned i = 0, n = readCount(); i < n && valid; ++i) {
+      std::set<uint64_t> &allocationBounds = bounds[readAllocationInfo()];
+      for (unsigned j = 0, m = readCount(); j < m && valid; ++j) {
+        uint64_t bound = 0;
+        if (!(stream >> bound))
+          valid = false;
+        allocationBounds.insert(bound);
+      }
+    }
+
+    std::map<ref<TxAllocationInfo>, std::set<ref<Expr> > > offsets;
+    for (unsigned i = 0, n = readCount(); i < n && valid; ++i) {
+      std::set<ref<Expr> > &allocationOffsets = offsets[readAllocationInfo()];
+      for (unsigned j = 0, m = readCount(); j < m && valid; ++j)
+        allocationOffsets.insert(readExpr());
+    }
+
+    return TxInterpolantValue::create(value, expr, useBound, bounds, offsets);
+  }
+
+  void readStore(TxStore::TopInterpolantStore &store) {
+    for (unsigned i = 0, n = readCount(); i < n && valid; ++i) {
+      ref<TxAllocationContext> context = readContext();
+      readStore(store[context]);
+    }
+  }
+
+  void readStore(TxStore::LowerInterpolantStore &store) {
+    for (unsigned i = 0, n = readCount(); i < n && valid; ++i) {
+      ref<TxVariable> variable = readVariable();
+      store[variable] = readInterpolantValue();
+    }
+  }
+
+  const Array *readObject(const expr::QueryCommand &query) {
+    unsigned index = readCount();
+    if (index < query.Objects.size())
+      return query.Objects[index];
+    valid = false;
+    return 0;
+  }
+
+public:
+  TxTableRecordReader(
+      const std::string &record,
+      const std::map<unsigned, llvm::Instruction *> &_instructions,
+      llvm::Module *_module)
+      : stream(record), instructions(_instructions), module(_module),
+        valid(true) {}
+
+  /// \brief Reads the entry of the record and of the query.
+  ///
+  /// \return The entry, with the arrays of the given cache, or null if the
+  /// record is invalid for the module.
+  TxSubsumptionTableEntry *readEntry(const expr::QueryCommand &query,
+                                     uintptr_t programPoint,
+                                     const TxCallHistory *callHistory,
+                                     int leastFrameDepth,
+                                     ArrayCache &arrayCache) {
+    TxArrayRebindingVisitor visitor(arrayCache);
+    bool hasInterpolant = readCount();
+
+    for (unsigned i = 0, n = readCount(); i < n && valid; ++i) {
+      unsigned bodyIndex = readCount();
+      std::set<const Array *> variables;
+      for (unsigned j = 0, m = readCount(); j < m && valid; ++j) {
+        if (const Array *variable = readObject(query))
+          variables.insert(variable);
+      }
+      if (bodyIndex >= query.Values.size()) {
+        valid = false;
+        break;
+      }
+
+      std::ostringstream name;
+      name << quantifierMarkerPrefix << i;
+      visitor.addQuantifier(name.str(), query.Values[bodyIndex], variables);
+    }
+
+    std::set<const Array *> existentials;
+    for (unsigned i = 0, n = readCount(); i < n && valid; ++i) {
+      if (const Array *variable = readObject(query))
+        existentials.insert(visitor.rebind(variable));
+    }
+    if (!valid)
+      return 0;
+
+    ref<Expr> interpolant;
+    if (hasInterpolant)
+      interpolant = visitor.visit(query.Query);
+    for (std::vector<expr::ExprHandle>::const_iterator
+             it = query.Values.begin(),
+             ie = query.Values.end();
+         it != ie; ++it) {
+      exprs.push_back(visitor.visit(*it));
+    }
+
+    TxStore::TopInterpolantStore concretelyAddressedStore;
+    TxStore::TopInterpolantStore symbolicallyAddressedStore;
+    TxStore::LowerInterpolantStore concretelyAddressedHistoricalStore;
+    TxStore::LowerInterpolantStore symbolicallyAddressedHistoricalStore;
+    readStore(concretelyAddressedStore);
+    readStore(symbolicallyAddressedStore);
+    readStore(concretelyAddressedHistoricalStore);
+    readStore(symbolicallyAddressedHistoricalStore);
+    if (!valid)
+      return 0;
+
+    return new TxSubsumptionTableEntry(
+        programPoint, callHistory, leastFrameDepth, interpolant, existentials,
+        concretelyAddressedStore, symbolicallyAddressedStore,
+        concretelyAddressedHistoricalStore,
+        symbolicallyAddressedHistoricalStore);
+  }
+};
+}
+
+/// \brief Reads a table entry from its record and its KQuery query.
+///
+/// \return The entry, or null if the record or the query is invalid.
+static TxSubsumptionTableEntry *
+readEntry(const std::string &fileName, const std::string &text,
+          TxTableRecordReader &reader, ExprBuilder *builder,
+          uintptr_t programPoint, const TxCallHistory *callHistory,
+          int leastFrameDepth, ArrayCache &arrayCache) {
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
+  std::unique_ptr<llvm::MemoryBuffer> buffer(
+      llvm::MemoryBuffer::getMemBuffer(text));
+#else
+  llvm::OwningPtr<llvm::MemoryBuffer> buffer(
+      llvm::MemoryBuffer::getMemBuffer(text));
+#endif
+  expr::Parser *parser =
+      expr::Parser::Create(fileName, buffer.get(), builder, false);
+
+  // The declarations are deleted last, as the parser refers to the array
+  // declarations, and the record is read while the arrays of the query exist
+  expr::QueryCommand *query = 0;
+  std::vector<expr::Decl *> decls;
+  while (expr::Decl *decl = parser->ParseTopLevelDecl()) {
+    if (expr::QueryCommand *q = llvm::dyn_cast<expr::QueryCommand>(decl))
+      query = q;
+    decls.push_back(decl);
+  }
+
+  TxSubsumptionTableEntry *entry = 0;
+  if (query && !parser->GetNumErrors())
+    entry = reader.readEntry(*query, programPoint, callHistory,
+                             leastFrameDepth, arrayCache);
+
+  for (std::vector<expr::Decl *>::iterator it = decls.begin(),
+                                           ie = decls.end();
+       it != ie; ++it) {
+    delete *it;
+  }
+  delete parser;
+  return entry;
+}
+
+void TxSubsumptionTable::save(const std::string &fileName, KModule *kmodule) {
+  std::ofstream file(fileName.c_str());
+  if (!file) {
+    klee_warning("cannot write subsumption table file %s", fileName.c_str());
+    return;
+  }
+  file << "tracerx-subsumption-table " << tableFileVersion << " "
+       << getModuleHash(kmodule) << "\n";
+
+  // The entries are written in the order of insertion, which is the order
+  // they are checked against
+  std::vector<TxSubsumptionTableEntry *> entries;
+  for (std::map<uintptr_t, CallHistoryIndexedTable *>::const_iterator
+           it = instance.begin(),
+           ie = instance.end();
+       it != ie; ++it) {
+    it->second->getEntries(entries);
+  }
+  std::sort(entries.begin(), entries.end(),
+            TxSubsumptionTableEntry::insertedBefore);
+
+  for (std::vector<TxSubsumptionTableEntry *>::iterator it = entries.begin(),
+                                                        ie = entries.end();
+       it != ie; ++it) {
+    TxSubsumptionTableEntry *entry = *it;
+
+    TxTableRecordWriter writer(kmodule);
+    ref<Expr> query = ConstantExpr::create(0, Expr::Bool);
+    if (!entry->interpolant.isNull())
+      query = writer.visit(entry->interpolant);
+    writer.writeExistentials(entry->existentials);
+    writer.writeStore(entry->concretelyAddressedStore);
+    writer.writeStore(entry->symbolicallyAddressedStore);
+    writer.writeStore(entry->concretelyAddressedHistoricalStore);
+    writer.writeStore(entry->symbolicallyAddressedHistoricalStore);
+
+    // An allocation site that is not an instruction, a global or an
+    // argument is not the same in another run
+    if (!writer.valid)
+      continue;
+
+    std::string text;
+    llvm::raw_string_ostream stream(text);
+    const ref<Expr> *exprs = writer.exprs.empty() ? 0 : &writer.exprs[0];
+    const Array *const *arrays =
+        writer.arrays.empty() ? 0 : &writer.arrays[0];
+    ExprPPrinter::printQuery(stream, ConstraintManager(), query, exprs,
+                             exprs + writer.exprs.size(), arrays,
+                             arrays + writer.arrays.size());
+    stream.flush();
+
+    std::vector<llvm::Instruction *> callSites =
+        entry->callHistory->getCallSites();
+    file << kmodule->infos
+                ->getInfo(reinterpret_cast<llvm::Instruction *>(
+                    entry->programPoint))
+                .id << " " << callSites.size();
+    for (std::vector<llvm::Instruction *>::iterator it1 = callSites.begin(),
+                                                    ie1 = callSites.end();
+         it1 != ie1; ++it1) {
+      file << " " << kmodule->infos->getInfo(*it1).id;
+    }
+    file << " " << entry->leastFrameDepth << " " << text.size() << "\n"
+         << writer.getRecord(!entry->interpolant.isNull()) << "\n" << text
+         << "\n";
+    ++saveCount;
+  }
+}
+
+/// \brief The quoted CSV field of the text
+static std::string csvField(const std::string &text) {
+  std::string field = "\"";
+  for (std::string::const_iterator it = text.begin(), ie = text.end();
+       it != ie; ++it) {
+    if (*it == '"')
+      field += '"';
+    field += *it;
+  }
+  return field + "\"";
+}
+
+/// \brief The source location of the instruction, as file:line
+static std::string getSourceLocation(KModule *kmodule,
+                                     llvm::Instruction *instruction) {
+  const InstructionInfo &info = kmodule->infos->getInfo(instruction);
+  std::ostringstream stream;
+  stream << info.file << ":" << info.line;
+  return stream.str();
+}
+
+namespace {
+/// \brief A line of the subsumption profile
+struct ProfileLine {
+  uintptr_t programPoint;
+
+  /// \brief The call history, null for the line of a whole program point
+  const TxCallHistory *callHistory;
+
+  const TxSubsumptionTable::CheckProfile *profile;
+
+  ProfileLine(uintptr_t _programPoint, const TxCallHistory *_callHistory,
+              const TxSubsumptionTable::CheckProfile *_profile)
+      : programPoint(_programPoint), callHistory(_callHistory),
+        profile(_profile) {}
+
+  bool operator<(const ProfileLine &other) const {
+    return profile->time > other.profile->time;
+  }
+};
+}
+
+void TxSubsumptionTable::saveProfile(const std::string &fileName,
+                                     KModule *kmodule) {
+  std::ofstream file(fileName.c_str());
+  if (!file) {
+    klee_warning("cannot write subsumption profile %s", fileName.c_str());
+    return;
+  }
+
+  // The totals of the program points, referred to by the lines
+  std::map<uintptr_t, CheckProfile> programPointProfiles;
+  std::vector<ProfileLine> lines;
+  for (std::map<uintptr_t, CallHistoryIndexedTable *>::const_iterator
+           it = instance.begin(),
+           ie = instance.end();
+       it != ie; ++it) {
+    std::vector<std::pair<const TxCallHistory *, const CheckProfile *> >
+        profiles;
+    it->second->getProfiles(profiles);
+    if (profiles.empty())
+      continue;
+
+    CheckProfile &total = programPointProfiles[it->first];
+    for (std::vector<std::pair<const TxCallHistory *,
+                               const CheckProfile *> >::iterator
+             it1 = profiles.begin(),
+             ie1 = profiles.end();
+         it1 != ie1; ++it1) {
+      total.add(*it1->second);
+      lines.push_back(ProfileLine(it->first, it1->first, it1->second));
+    }
+    lines.push_back(ProfileLine(it->first, 0, &total));
+  }
+  std::stable_sort(lines.begin(), lines.end());
+
+  file << "function,location,assembly_line,call_history,checks,successes,"
+          "entries_scanned,solver_calls,time_us\n";
+  for (std::vector<ProfileLine>::iterator it = lines.begin(),
+                                          ie = lines.end();
+       it != ie; ++it) {
+    llvm::Instruction *instruction =
+        reinterpret_cast<llvm::Instruction *>(it->programPoint);
+
+    std::string callHistory = "*";
+    if (it->callHistory) {
+      callHistory.clear();
+      std::vector<llvm::Instruction *> callSites =
+          it->callHistory->getCallSites();
+      for (std::vector<llvm::Instruction *>::iterator
+               it1 = callSites.begin(),
+               ie1 = callSites.end();
+           it1 != ie1; ++it1) {
+        if (it1 != callSites.begin())
+          callHistory += " > ";
+        callHistory += getSourceLocation(kmodule, *it1);
+      }
+    }
+
+    const CheckProfile *profile = it->profile;
+    file << csvField(instruction->getParent()->getParent()->getName().str())
+         << "," << csvField(getSourceLocation(kmodule, instruction)) << ","
+         << kmodule->infos->getInfo(instruction).assemblyLine << ","
+         << csvField(callHistory) << "," << profile->checkCount << ","
+         << profile->successCount << "," << profile->scannedCount << ","
+         << profile->solverCallCount << "," << profile->time << "\n";
+  }
+}
+
+bool TxSubsumptionTable::load(const std::string &fileName, KModule *kmodule,
+                              ArrayCache &arrayCache) {
+  std::ifstream file(fileName.c_str());
+  std::string magic;
+  unsigned version;
+  uint64_t hash;
+  if (!(file >> magic >> version >> hash) ||
+      magic != "tracerx-subsumption-table" || version != tableFileVersion) {
+    klee_warning("cannot read subsumption table file %s", fileName.c_str());
+    return false;
+  }
+  if (hash != getModuleHash(kmodule)) {
+    klee_warning("ignoring subsumption table file %s written for another "
+                 "module or other interpolation options",
+                 fileName.c_str());
+    return false;
+  }
+
+  std::map<unsigned, llvm::Instruction *> instructions;
+  for (std::vector<KFunction *>::iterator it = kmodule->functions.begin(),
+                                          ie = kmodule->functions.end();
+       it != ie; ++it) {
+    KFunction *kf = *it;
+    for (unsigned i = 0; i < kf->numInstructions; ++i)
+      instructions[kf->instructions[i]->info->id] = kf->instructions[i]->inst;
+  }
+
+  ExprBuilder *builder = createDefaultExprBuilder();
+  unsigned programPointId, callSiteCount;
+  uint64_t rejectCount = 0;
+  while (file >> programPointId >> callSiteCount) {
+    bool valid = instructions.count(programPointId);
+    const TxCallHistory *callHistory = TxCallHistory::getEmpty();
+    for (unsigned i = 0; i < callSiteCount; ++i) {
+      unsigned callSiteId = 0;
+      file >> callSiteId;
+      std::map<unsigned, llvm::Instruction *>::iterator it =
+          instructions.find(callSiteId);
+      if (it == instructions.end())
+        valid = false;
+      else
+        callHistory = callHistory->push(it->second);
+    }
+
+    int leastFrameDepth = 0;
+    size_t length = 0;
+    file >> leastFrameDepth >> length;
+    file.get(); // The line break
+    std::string record;
+    std::getline(file, record);
+    std::string text(length, ' ');
+    if (length)
+      file.read(&text[0], length);
+    if (!file) {
+      klee_warning("truncated subsumption table file %s", fileName.c_str());
+      break;
+    }
+
+    TxSubsumptionTableEntry *entry = 0;
+    uintptr_t programPoint = 0;
+    if (valid) {
+      programPoint =
+          reinterpret_cast<uintptr_t>(instructions[programPointId]);
+      TxTableRecordReader reader(record, instructions, kmodule->module);
+      entry = readEntry(fileName, text, reader, builder, programPoint,
+                        callHistory, leastFrameDepth, arrayCache);
+    }
+    if (!entry) {
+      ++rejectCount;
+      continue;
+    }
+
+    insert(programPoint, callHistory, entry);
+    ++loadCount;
+  }
+  delete builder;
+
+  if (rejectCount)
+    klee_warning("ignored %lu invalid entries of subsumption table file %s",
+                 rejectCount, fileName.c_str());
+  return true;
+}
+
+/**/
+
+std::map<uintptr_t, TxSubsumptionSchedule::PointSchedule>
+TxSubsumptionSchedule::points;
+
+std::set<uintptr_t> TxSubsumptionSchedule::loopHeads;
+
+uint64_t TxSubsumptionSchedule::loopHeadSkipCount = 0;
+
+uint64_t TxSubsumptionSchedule::loopHeadCandidateSkipCount = 0;
+
+uint64_t TxSubsumptionSchedule::untabledCount = 0;
+
+uint64_t TxSubsumptionSchedule::backoffSkipCount = 0;
+
+double TxSubsumptionSchedule::backoffLostEstimate = 0;
+
+void TxSubsumptionSchedule::initialize(KModule *kmodule) {
+  if (!SubsumptionCheckLoopHeads)
+    return;
+
+  for (std::vector<KFunction *>::iterator it = kmodule->functions.begin(),
+                                          ie = kmodule->functions.end();
+       it != ie; ++it) {
+    llvm::Function *f = (*it)->function;
+    loopHeads.insert(reinterpret_cast<uintptr_t>(&*f->getEntryBlock().begin()));
+
+    llvm::DominatorTree dominatorTree;
+    llvm::LoopInfoBase<llvm::BasicBlock, llvm::Loop> loopInfo;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 8)
+    dominatorTree.recalculate(*f);
+    loopInfo.analyze(dominatorTree);
+#elif LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
+    dominatorTree.recalculate(*f);
+    loopInfo.Analyze(dominatorTree);
+#else
+    dominatorTree.runOnFunction(*f);
+    loopInfo.Analyze(dominatorTree.getBase());
+#endif
+
+    for (llvm::Function::iterator bbit = f->begin(), bbie = f->end();
+         bbit != bbie; ++bbit) {
+      llvm::BasicBlock *bb = &*bbit;
+      if (!loopInfo.isLoopHeader(bb))
+        continue;
+
+      // The header starts a tree node only when the branch to it forks, as
+      // in rotated loops. Otherwise the nodes of the iteration start at the
+      // successors of the branch on the loop condition in the header.
+      loopHeads.insert(reinterpret_cast<uintptr_t>(&*bb->begin()));
+      llvm::TerminatorInst *terminator = bb->getTerminator();
+      for (unsigned i = 0, n = terminator->getNumSuccessors(); i < n; ++i) {
+        loopHeads.insert(
+            reinterpret_cast<uintptr_t>(&*terminator->getSuccessor(i)->begin()));
+      }
+    }
+  }
+}
+
+bool TxSubsumptionSchedule::scheduled(uintptr_t programPoint,
+                                      const TxCallHistory *callHistory) {
+  if (SubsumptionCheckLoopHeads && !loopHeads.count(programPoint)) {
+    ++loopHeadSkipCount;
+    if (TxSubsumptionTable::hasEntries(programPoint, callHistory))
+      ++loopHeadCandidateSkipCount;
+    return false;
+  }
+
+  if (MaxFailSubsumption <= 0)
+    return true;
+
+  std::map<uintptr_t, PointSchedule>::iterator it = points.find(programPoint);
+  if (it == points.end() || !it->second.skipCount)
+    return true;
+
+  PointSchedule &point = it->second;
+  --point.skipCount;
+  ++backoffSkipCount;
+  backoffLostEstimate += (double)point.successCount / point.checkCount;
+  return false;
+}
+
+void TxSubsumptionSchedule::record(uintptr_t programPoint, bool success) {
+  if (MaxFailSubsumption <= 0)
+    return;
+
+  PointSchedule &point = points[programPoint];
+  ++point.checkCount;
+  if (success) {
+    ++point.successCount;
+    point.backoff = 1;
+    return;
+  }
+
+  if (point.checkCount < (uint64_t)MaxFailSubsumption)
+    return;
+
+  double failureRatio = (double)(point.checkCount - point.successCount) /
+                        (double)point.checkCount;
+  if (failureRatio < SubsumptionBackoffRatio)
+    return;
+
+  point.skipCount = point.backoff;
+  if (point.backoff < maxBackoff)
+    point.backoff *= 2;
+}
+
+bool TxSubsumptionSchedule::tabled(uintptr_t programPoint) {
+  // The entries of a point that is never checked cannot subsume, but those
+  // written to a file may be checked by another run
+  if (SubsumptionCheckLoopHeads && WriteSubsumptionTable.empty() &&
+      !loopHeads.count(programPoint)) {
+    ++untabledCount;
+    return false;
+  }
+  return true;
+}
+
+void TxSubsumptionSchedule::printStat(std::stringstream &stream) {
+  stream << "KLEE: done:     Subsumption checks skipped outside loop heads = "
+         << loopHeadSkipCount << " (" << loopHeadCandidateSkipCount
+         << " with table entries)\n";
+  stream << "KLEE: done:     Table entries not built outside loop heads = "
+         << untabledCount << "\n";
+  stream << "KLEE: done:     Subsumption checks skipped by back off = "
+         << backoffSkipCount << " (estimated subsumptions lost = "
+         << (uint64_t)(backoffLostEstimate + 0.5) << ")\n";
 }
 
 /**/
@@ -1892,6 +3620,8 @@ uint64_t TxTree::subsumptionCheckCount = 0;
 
 uint64_t TxTree::blockCount = 1;
 
+uint64_t TxTree::unsatCoreInterpolationCount = 0;
+
 void TxTree::printTimeStat(std::stringstream &stream) {
   stream << "KLEE: done:     setCurrentINode = "
          << ((double)setCurrentINodeTime.getValue()) / 1000 << "\n";
@@ -1907,21 +3637,44 @@ void TxTree::printTimeStat(std::stringstream &stream) {
          << ((double)executeOnNodeTime.getValue()) / 1000 << "\n";
   stream << "KLEE: done:     executeMemoryOperation = "
          << ((double)executeMemoryOperationTime.getValue()) / 1000 << "\n";
+  stream << "KLEE: done:     dependency marking = "
+         << ((double)TxStore::markingTime.getValue()) / 1000 << "\n";
 }
 
 void TxTree::printTableStat(std::stringstream &stream) {
   TxSubsumptionTableEntry::printStat(stream);
+  TxSubsumptionTable::printStat(stream);
+  TxSubsumptionSchedule::printStat(stream);
+  TxRelevanceAnalysis::printStat(stream);
 
   stream
       << "KLEE: done:     Average table entries per subsumption checkpoint = "
-      << inTwoDecimalPoints(entryNumber / programPointNumber) << "\n";
+      << inTwoDecimalPoints(
+             programPointNumber ? entryNumber / programPointNumber : 0) << "\n";
 
   stream << "KLEE: done:     Number of subsumption checks = "
          << subsumptionCheckCount << "\n";
 
   stream << "KLEE: done:     Average solver calls per subsumption check = "
-         << inTwoDecimalPoints((double)stats::subsumptionQueryCount /
-                               (double)subsumptionCheckCount) << "\n";
+         << inTwoDecimalPoints(
+                subsumptionCheckCount
+                    ? (double)stats::subsumptionQueryCount /
+                          (double)subsumptionCheckCount
+                    : 0) << "\n";
+
+  stream << "KLEE: done:     Number of unsat-core interpolations = "
+         << unsatCoreInterpolationCount << "\n";
+
+  stream << "KLEE: done:     Number of store entries visited by dependency "
+            "marking = " << TxStore::markingVisitCount << "\n";
+
+  stream << "KLEE: done:     Average store entries visited per unsat-core "
+            "interpolation = "
+         << inTwoDecimalPoints(
+                unsatCoreInterpolationCount
+                    ? (double)TxStore::markingVisitCount /
+                          (double)unsatCoreInterpolationCount
+                    : 0) << "\n";
 }
 
 std::string TxTree::inTwoDecimalPoints(const double n) {
@@ -1957,7 +3710,8 @@ std::string TxTree::getInterpolationStat() {
 TxTree::TxTree(
     ExecutionState *_root, llvm::DataLayout *_targetData,
     std::map<const llvm::GlobalValue *, ref<ConstantExpr> > *_globalAddresses)
-    : targetData(_targetData), globalAddresses(_globalAddresses) {
+    : targetData(_targetData), globalAddresses(_globalAddresses),
+      subsumptionSolver(0) {
   currentTxTreeNode = 0;
   assert(_targetData && "target data layout not provided");
   if (!_root->txTreeNode) {
@@ -1992,12 +3746,30 @@ bool TxTree::subsumptionCheck(TimingSolver *solver, ExecutionState &state,
                  state.txTreeNode->getNodeSequenceNumber());
   }
 
+  if (!TxSubsumptionSchedule::scheduled(state.txTreeNode->getProgramPoint(),
+                                        state.txTreeNode->entryCallHistory)) {
+    if (debugSubsumptionLevel >= 1) {
+      klee_message("#%lu: Check skipped by the schedule",
+                   state.txTreeNode->getNodeSequenceNumber());
+    }
+    return false;
+  }
+
   ++subsumptionCheckCount; // For profiling
 
   TimerStatIncrementer t(subsumptionCheckTime);
 
-  return TxSubsumptionTable::check(solver, state, timeout,
-                                   debugSubsumptionLevel);
+  if (!subsumptionSolver)
+    subsumptionSolver = new TxSubsumptionSolver(solver);
+
+  bool success = TxSubsumptionTable::check(subsumptionSolver, state, timeout,
+                                           debugSubsumptionLevel);
+  if (!success && FunctionSummaries)
+    success = TxSubsumptionTable::checkSummaries(subsumptionSolver, state,
+                                                 timeout,
+                                                 debugSubsumptionLevel);
+  TxSubsumptionSchedule::record(state.txTreeNode->getProgramPoint(), success);
+  return success;
 #endif
   return false;
 }
@@ -2026,7 +3798,8 @@ void TxTree::remove(TxTreeNode *node, bool dumping) {
     // This is because a generic error returns no information (true), which
     // should not be used for subsuming.
     if (!dumping && !node->isSubsumed && node->storable &&
-        !node->genericEarlyTermination) {
+        !node->genericEarlyTermination &&
+        TxSubsumptionSchedule::tabled(node->getProgramPoint())) {
       int debugSubsumptionLevel = node->dependency->debugSubsumptionLevel;
 
       if (debugSubsumptionLevel >= 2) {
@@ -2056,6 +3829,7 @@ void TxTree::remove(TxTreeNode *node, bool dumping) {
     if (p) {
       if (!p->genericEarlyTermination)
         p->genericEarlyTermination = node->genericEarlyTermination;
+      p->reachFrameDepth(node->leastFrameDepth);
       if (node == p->left) {
         p->left = 0;
       } else {
@@ -2215,10 +3989,14 @@ TxTreeNode::TxTreeNode(
       graph(_parent ? _parent->graph : 0),
       instructionsDepth(_parent ? _parent->instructionsDepth : 0),
       targetData(_targetData), globalAddresses(_globalAddresses),
-      genericEarlyTermination(false), isSubsumed(false) {
+      genericEarlyTermination(false), frameDepth(0), leastFrameDepth(0),
+      isSubsumed(false) {
   if (_parent) {
     entryCallHistory = _parent->callHistory;
     callHistory = _parent->callHistory;
+  } else {
+    entryCallHistory = TxCallHistory::getEmpty();
+    callHistory = TxCallHistory::getEmpty();
   }
 
   // Inherit the abstract dependency or NULL
@@ -2263,39 +4041,39 @@ void TxTreeNode::execute(llvm::Instruction *instr,
 void TxTreeNode::bindCallArguments(llvm::Instruction *site,
                                    std::vector<ref<Expr> > &arguments) {
   TimerStatIncrementer t(bindCallArgumentsTime);
+  ++frameDepth;
   dependency->bindCallArguments(site, callHistory, arguments);
 }
 
-void TxTreeNode::bindReturnValue(llvm::CallInst *site, llvm::Instruction *inst,
+void TxTreeNode::bindReturnValue(llvm::Instruction *site,
+                                 llvm::Instruction *inst,
                                  ref<Expr> returnValue) {
   // TODO: This is probably where we should simplify
   // the dependency graph by removing callee values.
   TimerStatIncrementer t(bindReturnValueTime);
-  dependency->bindReturnValue(site, callHistory, inst, returnValue);
+
+  // The frame was pushed by bindCallArguments whatever the kind of the call
+  // site, hence it is popped for an invoke as well
+  if (--frameDepth < leastFrameDepth)
+    leastFrameDepth = frameDepth;
+
+  if (llvm::CallInst *callSite = llvm::dyn_cast<llvm::CallInst>(site))
+    dependency->bindReturnValue(callSite, callHistory, inst, returnValue);
 }
 
-void TxTreeNode::getStoredExpressions(
-    const std::vector<llvm::Instruction *> &_callHistory,
-    bool &leftRetrieval, TxStore::TopStateStore &__internalStore,
-    TxStore::LowerStateStore &__concretelyAddressedHistoricalStore,
-    TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore) const {
+TxStore::StateView TxTreeNode::getStoredExpressions() const {
   TimerStatIncrementer t(getStoredExpressionsTime);
-  std::map<ref<Expr>, ref<Expr> > dummySubstitution;
-  std::set<const Array *> dummyReplacements;
 
   // Since a program point index is a first statement in a basic block,
   // the allocations to be stored in subsumption table should be obtained
   // from the parent node.
-  if (parent) {
-    dependency->getParentStoredExpressions(
-        _callHistory, dummySubstitution, dummyReplacements, false,
-        leftRetrieval, __internalStore, __concretelyAddressedHistoricalStore,
-        __symbolicallyAddressedHistoricalStore);
-  }
+  if (parent)
+    return dependency->getParentStoreView();
+  return TxStore::StateView(0, getStore());
 }
 
 void TxTreeNode::getStoredCoreExpressions(
-    const std::vector<llvm::Instruction *> &_callHistory,
+    const TxCallHistory *_callHistory,
     const std::map<ref<Expr>, ref<Expr> > &substitution,
     std::set<const Array *> &replacements,
     TxStore::TopInterpolantStore &concretelyAddressedStore,
@@ -2323,6 +4101,7 @@ void TxTreeNode::incInstructionsDepth() { ++instructionsDepth; }
 
 void
 TxTreeNode::unsatCoreInterpolation(const std::vector<ref<Expr> > &unsatCore) {
+  ++TxTree::unsatCoreInterpolationCount;
   dependency->unsatCoreInterpolation(unsatCore);
 }
 
@@ -2359,12 +4138,9 @@ void TxTreeNode::print(llvm::raw_ostream &stream,
     stream << "\n";
   }
   stream << tabsNext << "Call history:\n";
-  for (std::vector<llvm::Instruction *>::const_reverse_iterator
-           it = callHistory.rbegin(),
-           ie = callHistory.rend();
-       it != ie; ++it) {
+  for (const TxCallHistory *h = callHistory; !h->empty(); h = h->getParent()) {
     stream << tabsNext;
-    (*it)->print(stream);
+    h->getCallSite()->print(stream);
     stream << "\n";
   }
   if (dependency) {
@@ -23,14 +23,19 @@
 #include "klee/Solver.h"
 #include "klee/Statistic.h"
 #include "klee/TimerStatIncrementer.h"
+#include "klee/util/ExprHashMap.h"
 #include "klee/util/ExprVisitor.h"
 #include "klee/util/TxTreeGraph.h"
 
 #include "llvm/Support/raw_ostream.h"
 #include "TxDependency.h"
+#include "TxSubsumptionSolver.h"
 
 namespace klee {
 
+class ArrayCache;
+class KModule;
+
 /// \brief The subsumption table.
 ///
 /// This is the database of states that have been generalized by the
@@ -48,6 +53,38 @@ class TxSubsumptionTable {
   typedef std::deque<TxSubsumptionTableEntry *>::const_reverse_iterator
   EntryIterator;
 
+public:
+  /// \brief The cost of the subsumption checks against a set of entries,
+  /// recorded with -subsumption-profile
+  struct CheckProfile {
+    uint64_t checkCount;
+
+    uint64_t successCount;
+
+    /// \brief The entries examined, including those rejected by the
+    /// pre-filters
+    uint64_t scannedCount;
+
+    uint64_t solverCallCount;
+
+    /// \brief The wall-clock time of the checks, in microseconds
+    uint64_t time;
+
+    CheckProfile()
+        : checkCount(0), successCount(0), scannedCount(0), solverCallCount(0),
+          time(0) {}
+
+    void add(const CheckProfile &other) {
+      checkCount += other.checkCount;
+      successCount += other.successCount;
+      scannedCount += other.scannedCount;
+      solverCallCount += other.solverCallCount;
+      time += other.time;
+    }
+  };
+
+private:
+
   class CallHistoryIndexedTable {
     class Node {
       friend class CallHistoryIndexedTable;
@@ -58,6 +95,9 @@ class TxSubsumptionTable {
 
       std::map<llvm::Instruction *, Node *> next;
 
+      /// \brief The checks against the entries of this node
+      CheckProfile profile;
+
       Node(llvm::Instruction *_id) : id(_id) {}
 
       void dump() const {
@@ -74,6 +114,9 @@ class TxSubsumptionTable {
 
     Node *root;
 
+    /// \brief The node of each call history, as call histories are interned
+    std::map<const TxCallHistory *, Node *> index;
+
     void printNode(llvm::raw_ostream &stream, Node *n, std::string edges) const;
 
   public:
@@ -83,13 +126,30 @@ class TxSubsumptionTable {
 
     void clearTree(Node *node);
 
-    void insert(const std::vector<llvm::Instruction *> &callHistory,
+    void insert(const TxCallHistory *callHistory,
                 TxSubsumptionTableEntry *entry);
 
     std::pair<EntryIterator, EntryIterator>
-    find(const std::vector<llvm::Instruction *> &callHistory,
+    find(const TxCallHistory *callHistory,
          bool &found) const;
 
+    /// \brief Appends all the entries of this table to the vector
+    void getEntries(std::vector<TxSubsumptionTableEntry *> &entries) const;
+
+    /// \brief Removes the given entries from this table, without deleting
+    /// them
+    void removeEntries(const std::set<TxSubsumptionTableEntry *> &entries);
+
+    /// \brief The profile of the node of the call history, null if there is
+    /// no such node
+    CheckProfile *getProfile(const TxCallHistory *callHistory);
+
+    /// \brief Appends the call histories of the nodes checked against, with
+    /// their profiles
+    void getProfiles(std::vector<std::pair<const TxCallHistory *,
+                                           const CheckProfile *> > &profiles)
+        const;
+
     void dump() const {
       this->print(llvm::errs());
       llvm::errs() << "\n";
@@ -100,16 +160,104 @@ class TxSubsumptionTable {
 
   static std::map<uintptr_t, CallHistoryIndexedTable *> instance;
 
+  /// \brief The context-independent entries of each function, by program
+  /// point, tried for the call histories other than their own with
+  /// -function-summaries. The entries are owned by instance.
+  static std::map<llvm::Function *,
+                  std::map<uintptr_t, std::deque<TxSubsumptionTableEntry *> > >
+  summaries;
+
+  /// \brief Number of checks against the summaries of another call history,
+  /// and of those that succeeded
+  static uint64_t summaryCheckCount;
+  static uint64_t summaryHitCount;
+
+  /// \brief The estimated memory of the entries in the table, in bytes
+  static uint64_t tableSize;
+
+  /// \brief The number of entries inserted so far, which dates the entries
+  static uint64_t insertionCount;
+
+  /// \brief The number of entries evicted, and their estimated memory
+  static uint64_t evictionCount;
+  static uint64_t evictedSize;
+
+  /// \brief The numbers of entries read from and written to table files,
+  /// and of the states subsumed by the entries read
+  static uint64_t loadCount;
+  static uint64_t saveCount;
+  static uint64_t loadedHitCount;
+
+  /// \brief Evicts the least useful entries, bringing the table below its
+  /// memory budget
+  static void evict();
+
+  /// \brief The check against the given table entries, counting the entries
+  /// examined in scannedCount.
+  static bool checkEntries(TxSubsumptionSolver *solver, ExecutionState &state,
+                           double timeout,
+                           std::pair<EntryIterator, EntryIterator> iterPair,
+                           int debugSubsumptionLevel, uint64_t &scannedCount);
+
+  /// \brief The check against the given table entries with
+  /// -subsumption-threads, where the queries of all entries are solved
+  /// together, and the chosen entry is the same as with check.
+  static bool checkInParallel(TxSubsumptionSolver *solver,
+                              ExecutionState &state, double timeout,
+                              std::pair<EntryIterator, EntryIterator> iterPair,
+                              const TxStore::StateView &stateStore,
+                              int debugSubsumptionLevel,
+                              uint64_t &scannedCount);
+
 public:
   static void insert(uintptr_t id,
-                     const std::vector<llvm::Instruction *> &callHistory,
+                     const TxCallHistory *callHistory,
                      TxSubsumptionTableEntry *entry);
 
-  static bool check(TimingSolver *solver, ExecutionState &state, double timeout,
-                    int debugSubsumptionLevel);
+  static bool check(TxSubsumptionSolver *solver, ExecutionState &state,
+                    double timeout, int debugSubsumptionLevel);
+
+  /// \brief The check against the function summaries of the program point
+  /// tabled under other call histories than that of the state
+  static bool checkSummaries(TxSubsumptionSolver *solver,
+                             ExecutionState &state, double timeout,
+                             int debugSubsumptionLevel);
+
+  /// \brief Returns true if the table has entries to check at the program
+  /// point for the call history
+  static bool hasEntries(uintptr_t id, const TxCallHistory *callHistory);
 
   static void clear();
 
+  /// \brief Writes the entries of the table to a file, for later runs on the
+  /// same module to start with. Program points and call sites are written as
+  /// instruction identifiers, and the expressions of an entry as a KQuery
+  /// query. The cells of the interpolant stores are keyed by their
+  /// allocation site, an instruction identifier or the name of a global or
+  /// an argument, with its call history, and by the indices of their base
+  /// and offset expressions in the query. The existentially-quantified
+  /// variables are the arrays declared by the query.
+  static void save(const std::string &fileName, KModule *kmodule);
+
+  /// \brief Reads into the table the entries written by an earlier run, with
+  /// the arrays of the expressions taken from the given cache, so that they
+  /// are those of the states of this run. The file is rejected when written
+  /// for another module.
+  ///
+  /// \return true if the file was read, false otherwise.
+  static bool load(const std::string &fileName, KModule *kmodule,
+                   ArrayCache &arrayCache);
+
+  /// \brief Writes the profile of the subsumption checks recorded with
+  /// -subsumption-profile as CSV, one line per program point and call
+  /// history, and one per program point with call history "*", the most
+  /// time-consuming first. Locations are given by the instruction table of
+  /// the module.
+  static void saveProfile(const std::string &fileName, KModule *kmodule);
+
+  /// \brief For printing the eviction and table file statistics
+  static void printStat(std::stringstream &stream);
+
   static void print(llvm::raw_ostream &stream) {
     for (std::map<uintptr_t, CallHistoryIndexedTable *>::const_iterator
              it = instance.begin(),
@@ -152,6 +300,7 @@ public:
 /// \see TxSubsumptionTable
 class TxSubsumptionTableEntry {
   friend class TxTree;
+  friend class TxSubsumptionTable;
 
 #ifdef ENABLE_Z3
   /// \brief Mark begin and end of subsumption check for use within a scope
@@ -165,8 +314,33 @@ class TxSubsumptionTableEntry {
   static Statistic symbolicallyAddressedStoreExpressionBuildTime;
   static Statistic solverAccessTime;
 
+  /// \brief Counters of the entries examined by the pre-filters, and of the
+  /// entries rejected by each of them
+  static uint64_t prefilterCheckCount;
+  static uint64_t contextFilterRejectCount;
+  static uint64_t constantFilterRejectCount;
+
+  /// \brief Counters of the existentially-quantified queries whose
+  /// simplification was found in, or added to, simplifiedQueries
+  static uint64_t simplificationCacheHitCount;
+  static uint64_t simplificationCacheMissCount;
+
+  /// \brief The maximum number of simplified queries kept per entry
+  static const size_t maxSimplifiedQueries = 64;
+
   ref<Expr> interpolant;
 
+  /// \brief The interpolant with its atoms normalized by
+  /// simplifyInterpolantExpr, computed once when the entry is created. It
+  /// stands for the interpolant in existentially-quantified queries.
+  ref<Expr> normalizedInterpolant;
+
+  /// \brief The results of simplifyExistsExpr on the existentially-quantified
+  /// queries of this entry, with their hasExistentialsOnly flag, indexed by
+  /// the state equality constraints, the only part of the query that differs
+  /// between checks.
+  ExprHashMap<std::pair<ref<Expr>, bool> > simplifiedQueries;
+
   TxStore::LowerInterpolantStore concretelyAddressedHistoricalStore;
 
   TxStore::LowerInterpolantStore symbolicallyAddressedHistoricalStore;
@@ -177,6 +351,106 @@ class TxSubsumptionTableEntry {
 
   std::set<const Array *> existentials;
 
+  /// \brief The union of the signature bits of the allocation contexts of the
+  /// tabled stores, all of which have to exist in a subsumed state.
+  uint64_t contextSignature;
+
+  /// \brief The concretely-addressed tabled cells holding constant,
+  /// non-pointer values, which a subsumed state has to store as well.
+  std::vector<std::pair<ref<TxVariable>, ref<Expr> > > constantCells;
+
+  /// \brief The allocation contexts of the tabled stores whose call histories
+  /// are relative to the function entry (see generalizeStores)
+  std::set<ref<TxAllocationContext> > relativeContexts;
+
+  /// \brief The entry call history on which the relative contexts were last
+  /// rebased, their rebased contexts, and the union of the signature bits of
+  /// these
+  const TxCallHistory *rebaseCallHistory;
+  std::map<ref<TxAllocationContext>, ref<TxAllocationContext> >
+  rebasedContexts;
+  uint64_t rebasedContextSignature;
+
+  /// \brief The numbers of states this entry subsumed, and of full checks
+  /// against this entry that failed, to judge its usefulness in the eviction
+  /// from the table
+  uint64_t subsumptionCount;
+  uint64_t failedCheckCount;
+
+  /// \brief The value of TxSubsumptionTable::insertionCount when this entry
+  /// was inserted, which breaks the usefulness ties in favor of newer entries
+  uint64_t insertionTime;
+
+  /// \brief The estimated memory of this entry, in bytes
+  uint64_t size;
+
+  /// \brief Whether this entry was read from a table file
+  const bool loaded;
+
+  /// \brief The call history under which this entry is tabled
+  const TxCallHistory *callHistory;
+
+  /// \brief The least stack frame depth reached by the subtree of the entry,
+  /// relative to the frame at its program point (see
+  /// TxTreeNode#leastFrameDepth)
+  int leastFrameDepth;
+
+  /// \brief Whether the entry holds for any call history of the function of
+  /// its program point: its subtree never returned to the caller. The tabled
+  /// cells of the frames of the function and of its callees are then
+  /// generalized with -function-summaries, and the others are only found in
+  /// the states that share their allocation contexts.
+  bool isContextIndependent() const;
+
+  /// \brief Rewrites the call histories of the allocation contexts of the
+  /// tabled stores that extend the call history of the entry, which are those
+  /// of the frames of the function of the program point and of its callees,
+  /// relative to the function entry.
+  void generalizeStores();
+
+  void generalizeStore(TxStore::TopInterpolantStore &store);
+
+  /// \brief Rebases the relative allocation contexts of the tabled stores on
+  /// the entry call history of the state to check.
+  void rebaseContexts(const TxCallHistory *entryCallHistory);
+
+  /// \brief The allocation context in the state to check of a tabled
+  /// allocation context, which is the context itself unless relative
+  ref<TxAllocationContext>
+  getStateContext(ref<TxAllocationContext> context) const;
+
+  /// \brief Computes the pre-filter signatures of this entry.
+  void computeSignatures();
+
+  /// \brief Estimates the memory of this entry.
+  void computeSize();
+
+  /// \brief Computes normalizedInterpolant from the interpolant.
+  void normalizeInterpolant();
+
+  /// \brief Removes from a tabled store the allocations of the frame of the
+  /// program point that cannot be read downstream of it, with
+  /// -store-relevance-analysis.
+  void dropIrrelevantAllocations(TxStore::TopInterpolantStore &store);
+
+  /// \brief Simplifies the existentially-quantified query of this entry with
+  /// the given state equality constraints, reusing the result of an earlier
+  /// check with the same constraints.
+  ref<Expr> simplifyQuery(ref<Expr> stateEqualityConstraints,
+                          bool &hasExistentialsOnly,
+                          ExecutionState &state, int debugSubsumptionLevel);
+
+  /// \brief Whether the first entry is to be evicted before the second:
+  /// entries are ordered by their ratio of successful subsumptions to failed
+  /// checks, then from the oldest.
+  static bool lessUseful(const TxSubsumptionTableEntry *first,
+                         const TxSubsumptionTableEntry *second);
+
+  /// \brief Whether the first entry was inserted into the table before the
+  /// second.
+  static bool insertedBefore(const TxSubsumptionTableEntry *first,
+                             const TxSubsumptionTableEntry *second);
+
   /// \brief A procedure for building subsumption check constraints using
   /// symbolically-addressed store elements
   ///
@@ -288,22 +562,76 @@ class TxSubsumptionTableEntry {
   /// \brief For printing member functions running time statistics,
   static void printStat(std::stringstream &stream);
 
+  /// \brief The outcome of the part of a subsumption check before the solver
+  /// call
+  enum CheckResult { CheckFailure, CheckSuccess, CheckNeedsSolver };
+
+  /// \brief The query of a subsumption check, with the state values to be
+  /// marked as in the interpolant on success
+  struct SubsumptionQuery {
+    /// \brief The query expression, null when the check is decided without
+    /// the solver
+    ref<Expr> expr;
+
+    bool existential;
+
+    /// \brief Whether coreValues and corePointerValues are to be interpolated
+    /// on success
+    bool interpolateValues;
+
+    std::set<ref<TxStateValue> > coreValues;
+
+    std::map<ref<TxStateValue>, std::set<uint64_t> > corePointerValues;
+
+    SubsumptionQuery() : existential(false), interpolateValues(false) {}
+  };
+
+  /// \brief Builds the query of the subsumption check of the state against
+  /// this entry, deciding the check when no solver call is needed. The state
+  /// is not modified.
+  CheckResult prepareCheck(ExecutionState &state,
+                           const TxStore::StateView &stateStore,
+                           int debugSubsumptionLevel, SubsumptionQuery &query);
+
+  /// \brief Completes the subsumption check given the solver result of the
+  /// query, if any, and on success marks the unsatisfiability core and the
+  /// core values of the state.
+  bool completeCheck(ExecutionState &state, SubsumptionQuery &query,
+                     bool success, Solver::Validity result,
+                     std::vector<ref<Expr> > &unsatCore,
+                     int debugSubsumptionLevel);
+
 public:
   const uintptr_t programPoint;
 
   const uint64_t nodeSequenceNumber;
 
   TxSubsumptionTableEntry(TxTreeNode *node,
-                          const std::vector<llvm::Instruction *> &callHistory);
+                          const TxCallHistory *callHistory);
+
+  /// \brief The constructor of an entry read from a table file
+  TxSubsumptionTableEntry(
+      uintptr_t programPoint, const TxCallHistory *callHistory,
+      int leastFrameDepth, ref<Expr> interpolant,
+      const std::set<const Array *> &existentials,
+      const TxStore::TopInterpolantStore &concretelyAddressedStore,
+      const TxStore::TopInterpolantStore &symbolicallyAddressedStore,
+      const TxStore::LowerInterpolantStore &concretelyAddressedHistoricalStore,
+      const TxStore::LowerInterpolantStore &
+          symbolicallyAddressedHistoricalStore);
 
   ~TxSubsumptionTableEntry();
 
-  bool subsumed(
-      TimingSolver *solver, ExecutionState &state, double timeout,
-      bool leftRetrieval, TxStore::TopStateStore &__internalStore,
-      TxStore::LowerStateStore &__concretelyAddressedHistoricalStore,
-      TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore,
-      int debugSubsumptionLevel);
+  /// \brief Rejects in constant time per signature the states this entry
+  /// cannot subsume, before any expression is built.
+  ///
+  /// \return true if the state is rejected, false if the full check is needed.
+  bool prefiltered(ExecutionState &state, const TxStore::StateView &stateStore,
+                   int debugSubsumptionLevel);
+
+  bool subsumed(TxSubsumptionSolver *solver, ExecutionState &state,
+                double timeout, const TxStore::StateView &stateStore,
+                int debugSubsumptionLevel);
 
   /// Tests if the argument is a variable. A variable here is defined to be
   /// either a symbolic concatenation or a symbolic read. A concatenation in
@@ -394,6 +722,15 @@ class TxTreeNode {
   /// \brief Indicates that a generic error was encountered in this node
   bool genericEarlyTermination;
 
+  /// \brief The stack frame depth of the execution of this node, relative to
+  /// the frame at its program point
+  int frameDepth;
+
+  /// \brief The least relative stack frame depth reached by this node and
+  /// its subtree, negative when the subtree returned from the function of the
+  /// program point to its caller
+  int leastFrameDepth;
+
   void setProgramPoint(llvm::Instruction *instr) {
     if (!programPoint)
       programPoint = reinterpret_cast<uintptr_t>(instr);
@@ -437,18 +774,35 @@ class TxTreeNode {
   }
 
 public:
+  static void *operator new(size_t size) {
+    return TxArena::get(TxArena::TreeNode).allocate(size);
+  }
+
+  static void operator delete(void *block, size_t size) {
+    TxArena::get(TxArena::TreeNode).deallocate(block, size);
+  }
+
   bool isSubsumed;
 
   /// \brief The entry call history
-  std::vector<llvm::Instruction *> entryCallHistory;
+  const TxCallHistory *entryCallHistory;
 
   /// \brief The current call history
-  std::vector<llvm::Instruction *> callHistory;
+  const TxCallHistory *callHistory;
 
   uintptr_t getProgramPoint() { return programPoint; }
 
   uint64_t getNodeSequenceNumber() { return nodeSequenceNumber; }
 
+  int getLeastFrameDepth() const { return leastFrameDepth; }
+
+  /// \brief Account for a subtree whose least frame depth, relative to the
+  /// current frame of this node, is the given one
+  void reachFrameDepth(int subtreeLeastFrameDepth) {
+    if (frameDepth + subtreeLeastFrameDepth < leastFrameDepth)
+      leastFrameDepth = frameDepth + subtreeLeastFrameDepth;
+  }
+
   /// \brief Retrieve the interpolant for this node as KLEE expression object
   ///
   /// \param replacements The replacement bound variables for replacing the
@@ -477,19 +831,16 @@ public:
   void bindCallArguments(llvm::Instruction *site,
                          std::vector<ref<Expr> > &arguments);
 
-  /// \brief This propagates the dependency due to the return value of a call
-  void bindReturnValue(llvm::CallInst *site, llvm::Instruction *inst,
+  /// \brief Pops the frame pushed by bindCallArguments for a call or an
+  /// invoke site. This propagates the dependency due to the return value of
+  /// a call.
+  void bindReturnValue(llvm::Instruction *site, llvm::Instruction *inst,
                        ref<Expr> returnValue);
 
-  /// \brief This retrieves the allocations known at this state, and the
-  /// expressions stored in the allocations. This returns as the two last
-  /// arguments a pair of the store part indexed by constants, and the store
-  /// part indexed by symbolic expressions.
-  void getStoredExpressions(
-      const std::vector<llvm::Instruction *> &callHistory,
-      bool &leftRetrieval, TxStore::TopStateStore &__internalStore,
-      TxStore::LowerStateStore &__concretelyAddressedHistoricalStore,
-      TxStore::LowerStateStore &__symbolicallyAddressedHistoricalStore) const;
+  /// \brief This retrieves a read-only view of the allocations known at this
+  /// state, and of the expressions stored in the allocations, which are
+  /// looked up on demand by the subsumption checks.
+  TxStore::StateView getStoredExpressions() const;
 
   /// \brief This retrieves the allocations known at this state, and the
   /// expressions stored in the allocations, as long as the allocation is
@@ -503,7 +854,7 @@ public:
   /// be used for storing in the subsumption table, the variables need to be
   /// replaced with the bound ones.
   void getStoredCoreExpressions(
-      const std::vector<llvm::Instruction *> &callHistory,
+      const TxCallHistory *callHistory,
       const std::map<ref<Expr>, ref<Expr> > &substitution,
       std::set<const Array *> &replacements,
       TxStore::TopInterpolantStore &concretelyAddressedStore,
@@ -543,6 +894,10 @@ public:
 
   TxStore *getStore() const { return dependency->getStore(); }
 
+  TxPathCondition *getPathCondition() const {
+    return dependency->getPathCondition();
+  }
+
   /// \brief Print the content of the tree node object to the LLVM error stream.
   void dump() const;
 
@@ -552,6 +907,76 @@ public:
   void print(llvm::raw_ostream &stream) const;
 };
 
+/// \brief The scheduling of the subsumption checks at the program points of
+/// the tree nodes.
+///
+/// With -subsumption-check-loop-heads, the checks are restricted to the
+/// program points that start an iteration of a loop: the loop headers found
+/// by LLVM LoopInfo and their successors, as the header is not itself a
+/// node boundary when it is entered by an unconditional branch, plus the
+/// function entries. With -max-subsumption-failure, the checks at a program
+/// point back off exponentially once their failure ratio reaches
+/// -subsumption-backoff-ratio, and return to every visit on a success.
+class TxSubsumptionSchedule {
+  /// \brief The check history of a program point
+  struct PointSchedule {
+    uint64_t checkCount;
+
+    uint64_t successCount;
+
+    /// \brief The visits to skip before the next check
+    uint64_t skipCount;
+
+    /// \brief The visits to skip after the next failed check
+    uint64_t backoff;
+
+    PointSchedule()
+        : checkCount(0), successCount(0), skipCount(0), backoff(1) {}
+  };
+
+  static std::map<uintptr_t, PointSchedule> points;
+
+  /// \brief The program points with -subsumption-check-loop-heads
+  static std::set<uintptr_t> loopHeads;
+
+  /// \brief The bound of the visits skipped between two checks
+  static const uint64_t maxBackoff = 1024;
+
+public:
+  /// \brief Number of checks skipped at program points that are not loop
+  /// heads, and those of them for which the table has entries, bounding the
+  /// subsumptions lost. The table only has entries there when they are
+  /// built for -write-subsumption-table.
+  static uint64_t loopHeadSkipCount;
+  static uint64_t loopHeadCandidateSkipCount;
+
+  /// \brief Number of table entries not built at program points that are
+  /// not loop heads
+  static uint64_t untabledCount;
+
+  /// \brief Number of checks skipped by the back off, and the subsumptions
+  /// they lost, estimated by the success ratio of their program points
+  static uint64_t backoffSkipCount;
+  static double backoffLostEstimate;
+
+  /// \brief Computes the loop heads of the functions of the module
+  static void initialize(KModule *kmodule);
+
+  /// \brief Returns true if the program point, entered with the call
+  /// history, is to be checked for subsumption
+  static bool scheduled(uintptr_t programPoint,
+                        const TxCallHistory *callHistory);
+
+  /// \brief Records the result of a check at the program point
+  static void record(uintptr_t programPoint, bool success);
+
+  /// \brief Returns true if the table entries of the program point are to be
+  /// built, i.e., when it may be checked, or the table is written to a file
+  static bool tabled(uintptr_t programPoint);
+
+  static void printStat(std::stringstream &stream);
+};
+
 /// \brief The top-level structure that implements lazy annotation.
 ///
 /// The TxTree is the symbolic execution tree, a parallel of what is implemented
@@ -671,6 +1096,9 @@ class TxTree {
   /// variable is just a pointer to the one in klee::Executor.
   std::map<const llvm::GlobalValue *, ref<ConstantExpr> > *globalAddresses;
 
+  /// \brief The solver for subsumption checks, created on the first check
+  TxSubsumptionSolver *subsumptionSolver;
+
   void printNode(llvm::raw_ostream &stream, TxTreeNode *n,
                  std::string edges) const;
 
@@ -703,6 +1131,9 @@ public:
   /// \brief Number of visited basic blocks for statistical purposes
   static uint64_t blockCount;
 
+  /// \brief Number of unsat-core interpolations for statistical purposes
+  static uint64_t unsatCoreInterpolationCount;
+
   /// \brief The root node of the tree
   TxTreeNode *root;
 
@@ -716,7 +1147,10 @@ public:
          std::map<const llvm::GlobalValue *, ref<ConstantExpr> > *
              _globalAddresses);
 
-  ~TxTree() { TxSubsumptionTable::clear(); }
+  ~TxTree() {
+    TxSubsumptionTable::clear();
+    delete subsumptionSolver;
+  }
 
   /// \brief Set the reference to the KLEE state in the current interpolation
   /// data holder (Tracer-X tree node) that is currently being processed.
@@ -342,9 +342,16 @@ void TxTreeGraph::markAsSubsumed(TxTreeNode *txTreeNode,
 
   TxTreeGraph::Node *node = instance->txTreeNodeMap[txTreeNode];
   node->subsumed = true;
-  TxTreeGraph::Node *subsuming = instance->tableEntryMap[entry];
+
+  // Entries read from a table file (-read-subsumption-table) have no node in
+  // this tree, hence the node is shown as subsumed without an edge.
+  std::map<TxSubsumptionTableEntry *, TxTreeGraph::Node *>::iterator it =
+      instance->tableEntryMap.find(entry);
+  if (it == instance->tableEntryMap.end())
+    return;
+
   instance->subsumptionEdges.push_back(new TxTreeGraph::NumberedEdge(
-      node, subsuming, ++(instance->subsumptionEdgeNumber)));
+      node, it->second, ++(instance->subsumptionEdgeNumber)));
 }
 
 void TxTreeGraph::addPathCondition(TxTreeNode *txTreeNode,
@@ -375,6 +382,15 @@ void TxTreeGraph::addTableEntryMapping(TxTreeNode *txTreeNode,
   instance->tableEntryMap[entry] = node;
 }
 
+void TxTreeGraph::removeTableEntryMapping(TxSubsumptionTableEntry *entry) {
+  if (!OUTPUT_INTERPOLATION_TREE)
+    return;
+
+  assert(TxTreeGraph::instance && "Search tree graph not initialized");
+
+  instance->tableEntryMap.erase(entry);
+}
+
 void TxTreeGraph::setAsCore(TxPCConstraint *pathCondition) {
   if (!OUTPUT_INTERPOLATION_TREE)
     return;
@@ -32,6 +32,8 @@
 #include <llvm/Type.h>
 #endif
 
+#include <algorithm>
+
 using namespace klee;
 
 namespace klee {
@@ -40,6 +42,124 @@ bool concreteBound(uint64_t bound) { return bound < symbolicBoundId; }
 
 /**/
 
+TxCallHistory::~TxCallHistory() {
+  for (std::map<llvm::Instruction *, TxCallHistory *>::iterator
+           it = children.begin(),
+           ie = children.end();
+       it != ie; ++it) {
+    delete it->second;
+  }
+}
+
+const TxCallHistory *TxCallHistory::getEmpty() {
+  static TxCallHistory empty(0, 0);
+  return &empty;
+}
+
+const TxCallHistory *TxCallHistory::push(llvm::Instruction *site) const {
+  std::map<llvm::Instruction *, TxCallHistory *>::const_iterator it =
+      children.find(site);
+  if (it != children.end())
+    return it->second;
+
+  TxCallHistory *child = new TxCallHistory(this, site);
+  children[site] = child;
+  return child;
+}
+
+std::vector<llvm::Instruction *> TxCallHistory::getCallSites() const {
+  std::vector<llvm::Instruction *> ret(length);
+  unsigned i = length;
+  for (const TxCallHistory *h = this; h->parent; h = h->parent) {
+    ret[--i] = h->callSite;
+  }
+  return ret;
+}
+
+const TxCallHistory *
+TxCallHistory::getSuffix(const TxCallHistory *prefix) const {
+  if (prefix->length > length)
+    return 0;
+
+  const TxCallHistory *h = this;
+  std::vector<llvm::Instruction *> suffix;
+  while (h->length > prefix->length) {
+    suffix.push_back(h->callSite);
+    h = h->parent;
+  }
+  if (h != prefix)
+    return 0;
+
+  const TxCallHistory *ret = getEmpty();
+  for (std::vector<llvm::Instruction *>::reverse_iterator
+           it = suffix.rbegin(),
+           ie = suffix.rend();
+       it != ie; ++it) {
+    ret = ret->push(*it);
+  }
+  return ret;
+}
+
+const TxCallHistory *TxCallHistory::append(const TxCallHistory *suffix) const {
+  if (suffix->empty())
+    return this;
+
+  const TxCallHistory *ret = this;
+  std::vector<llvm::Instruction *> callSites = suffix->getCallSites();
+  for (std::vector<llvm::Instruction *>::iterator it = callSites.begin(),
+                                                  ie = callSites.end();
+       it != ie; ++it) {
+    ret = ret->push(*it);
+  }
+  return ret;
+}
+
+/**/
+
+std::vector<std::string> &TxCoreReasons::getTable() {
+  static std::vector<std::string> table(1);
+  return table;
+}
+
+unsigned TxCoreReasons::intern(const std::string &text) {
+  static std::map<std::string, unsigned> ids;
+
+  if (text.empty())
+    return noReason;
+
+  std::map<std::string, unsigned>::iterator it = ids.find(text);
+  if (it != ids.end())
+    return it->second;
+
+  std::vector<std::string> &table = getTable();
+  unsigned id = table.size();
+  table.push_back(text);
+  ids[text] = id;
+  return id;
+}
+
+void TxCoreReasons::insert(unsigned id) {
+  if (id == noReason)
+    return;
+
+  std::vector<unsigned>::iterator it =
+      std::lower_bound(reasons.begin(), reasons.end(), id);
+  if (it == reasons.end() || *it != id)
+    reasons.insert(it, id);
+}
+
+std::set<std::string> TxCoreReasons::getTexts() const {
+  std::set<std::string> texts;
+  for (std::vector<unsigned>::const_iterator it = reasons.begin(),
+                                             ie = reasons.end();
+       it != ie; ++it) {
+    texts.insert(getText(*it));
+  }
+  return texts;
+}
+
+/**/
+
 void TxStoreEntry::print(llvm::raw_ostream &stream,
                          const std::string &prefix) const {
   std::string tabsNext = appendTab(prefix);
@@ -52,27 +172,31 @@ void TxStoreEntry::print(llvm::raw_ostream &stream,
   stream << prefix << "content:\n";
   if (leftCore && rightCore) {
     stream << tabsNext << "a left and right interpolant value:\n";
-    for (std::set<std::string>::iterator it = leftCoreReasons.begin(),
-                                         ie = leftCoreReasons.end();
+    std::set<std::string> leftTexts(leftCoreReasons.getTexts());
+    for (std::set<std::string>::iterator it = leftTexts.begin(),
+                                         ie = leftTexts.end();
          it != ie; ++it) {
       stream << tabsNextNext << *it << "\n";
     }
-    for (std::set<std::string>::iterator it = rightCoreReasons.begin(),
-                                         ie = rightCoreReasons.end();
+    std::set<std::string> rightTexts(rightCoreReasons.getTexts());
+    for (std::set<std::string>::iterator it = rightTexts.begin(),
+                                         ie = rightTexts.end();
          it != ie; ++it) {
       stream << tabsNextNext << *it << "\n";
     }
   } else if (leftCore) {
     stream << tabsNext << "a left interpolant value:\n";
-    for (std::set<std::string>::iterator it = leftCoreReasons.begin(),
-                                         ie = leftCoreReasons.end();
+    std::set<std::string> leftTexts(leftCoreReasons.getTexts());
+    for (std::set<std::string>::iterator it = leftTexts.begin(),
+                                         ie = leftTexts.end();
          it != ie; ++it) {
       stream << tabsNextNext << *it << "\n";
     }
   } else if (rightCore) {
     stream << tabsNext << "a right interpolant value:\n";
-    for (std::set<std::string>::iterator it = rightCoreReasons.begin(),
-                                         ie = rightCoreReasons.end();
+    std::set<std::string> rightTexts(rightCoreReasons.getTexts());
+    for (std::set<std::string>::iterator it = rightTexts.begin(),
+                                         ie = rightTexts.end();
          it != ie; ++it) {
       stream << tabsNextNext << *it << "\n";
     }
@@ -155,8 +279,9 @@ void TxAllocationInfo::print(llvm::raw_ostream &stream,
 /**/
 
 ref<TxAllocationContext> TxAllocationContext::create(
-    llvm::Value *_value, const std::vector<llvm::Instruction *> &_callHistory) {
-  ref<TxAllocationContext> ret(new TxAllocationContext(_value, _callHistory));
+    llvm::Value *_value, const TxCallHistory *_callHistory, bool _relative) {
+  ref<TxAllocationContext> ret(
+      new TxAllocationContext(_value, _callHistory, _relative));
   return ret;
 }
 
@@ -174,11 +299,17 @@ void TxAllocationContext::print(llvm::raw_ostream &stream,
     }
     value->print(stream);
   }
-  if (callHistory.size() > 0) {
+  if (relative) {
+    stream << "\n" << prefix
+           << "Call history relative to the function entry:";
+  } else if (!callHistory->empty()) {
     stream << "\n" << prefix << "Call history:";
+  }
+  if (!callHistory->empty()) {
+    std::vector<llvm::Instruction *> callSites = callHistory->getCallSites();
     for (std::vector<llvm::Instruction *>::const_iterator
-             it = callHistory.begin(),
-             ie = callHistory.end();
+             it = callSites.begin(),
+             ie = callSites.end();
          it != ie; ++it) {
       stream << "\n" << tabs << prefix;
       (*it)->print(stream);
@@ -199,16 +330,15 @@ void TxVariable::print(llvm::raw_ostream &stream,
   stream << "\n";
 
   stream << prefix << "stack:";
-  if (allocInfo->getContext()->getCallHistory().empty()) {
+  if (allocInfo->getContext()->getCallHistory()->empty()) {
     stream << " (empty)\n";
   } else {
     stream << "\n";
-    for (std::vector<llvm::Instruction *>::const_reverse_iterator
-             it = allocInfo->getContext()->getCallHistory().rbegin(),
-             ib = it, ie = allocInfo->getContext()->getCallHistory().rend();
-         it != ie; ++it) {
+    // The call sites are printed from the last to the first
+    for (const TxCallHistory *h = allocInfo->getContext()->getCallHistory();
+         !h->empty(); h = h->getParent()) {
       stream << tabsNext;
-      (*it)->print(stream);
+      h->getCallSite()->print(stream);
       stream << "\n";
     }
   }
@@ -223,7 +353,7 @@ void TxVariable::print(llvm::raw_ostream &stream,
 
 void TxInterpolantValue::init(
     llvm::Value *_value, ref<Expr> _expr, bool canInterpolateBound,
-    const std::set<std::string> &_coreReasons, ref<TxStateAddress> _location,
+    const TxCoreReasons &_coreReasons, ref<TxStateAddress> _location,
     const std::map<ref<Expr>, ref<Expr> > &substitution,
     std::set<const Array *> &replacements, bool shadowing) {
   refCount = 0;
@@ -634,9 +764,14 @@ void TxInterpolantValue::print(llvm::raw_ostream &stream,
   bool offsetDisplayed = false;
 
   stream << prefix << "function/value: ";
-  if (outputFunctionName(value, stream))
+  if (value) {
+    if (outputFunctionName(value, stream))
       stream << "/";
-  value->print(stream);
+    value->print(stream);
+  } else {
+    // The value of an entry read from a table file may not be known
+    stream << "(unknown)";
+  }
   stream << "\n";
 
   if (!doNotUseBound && !allocationBounds.empty()) {
@@ -697,8 +832,9 @@ void TxInterpolantValue::print(llvm::raw_ostream &stream,
   if (!coreReasons.empty()) {
     stream << "\n";
     stream << prefix << "reason(s) for storage:\n";
-    for (std::set<std::string>::const_iterator is = coreReasons.begin(),
-                                               ie = coreReasons.end(), it = is;
+    std::set<std::string> texts(coreReasons.getTexts());
+    for (std::set<std::string>::const_iterator is = texts.begin(),
+                                               ie = texts.end(), it = is;
          it != ie; ++it) {
       if (it != is)
         stream << "\n";
@@ -948,6 +1084,9 @@ TxStoreEntry::TxStoreEntry(ref<TxStateAddress> _address,
       content(_content), depth(_depth), value(content->getValue()),
       valueExpr(content->getExpression()), leftDoNotInterpolateBound(false),
       rightDoNotInterpolateBound(false), leftCore(false), rightCore(false) {
+  markingEpoch[0][0] = markingEpoch[0][1] = 0;
+  markingEpoch[1][0] = markingEpoch[1][1] = 0;
+
   if (!content->getPointerInfo().isNull()) {
     leftPointerInfo = content->getPointerInfo();
     rightPointerInfo = content->getPointerInfo()->copy();
@@ -20,6 +20,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "klee/Internal/Module/KModule.h"
 
+#include <algorithm>
 #include <map>
 
 using namespace klee;
@@ -83,25 +84,130 @@ public:
   }
 };
 
+ConstraintNode::~ConstraintNode() {
+  // The nodes only referred to by their child are released in a loop, as
+  // the recursive destruction of a long list would overflow the stack.
+  ref<ConstraintNode> node = parent;
+  parent = ref<ConstraintNode>();
+  while (!node.isNull() && node->refCount == 1) {
+    ref<ConstraintNode> next = node->parent;
+    node->parent = ref<ConstraintNode>();
+    node = next;
+  }
+}
+
+ConstraintSegment::~ConstraintSegment() {
+  // As for the nodes, the prefix segments are released in a loop
+  ref<ConstraintSegment> segment = prefix;
+  prefix = ref<ConstraintSegment>();
+  while (!segment.isNull() && segment->refCount == 1) {
+    ref<ConstraintSegment> next = segment->prefix;
+    segment->prefix = ref<ConstraintSegment>();
+    segment = next;
+  }
+}
+
+ConstraintManager::ConstraintManager(
+    const std::vector<ref<Expr> > &_constraints) {
+  for (std::vector<ref<Expr> >::const_iterator it = _constraints.begin(),
+                                               ie = _constraints.end();
+       it != ie; ++it)
+    append(*it);
+}
+
+bool ConstraintManager::operator==(const ConstraintManager &other) const {
+  if (size() != other.size())
+    return false;
+  for (ConstraintNode *a = last.get(), *b = other.last.get(); a != b;
+       a = a->parent.get(), b = b->parent.get()) {
+    if (a->constraint != b->constraint)
+      return false;
+  }
+  return true;
+}
+
+ConstraintManager::const_iterator ConstraintManager::begin() const {
+  const_iterator it;
+  if (segment.isNull())
+    return it;
+
+  // The segments are walked from the first one, hence a set extended apart
+  // from its copies collects its path for the iterators
+  it.segment = segment.get();
+  if (segment->offset != 0) {
+    it.path = new ConstraintSegmentPath();
+    std::vector<const ConstraintSegment *> &segments = it.path->segments;
+    for (const ConstraintSegment *s = segment.get(); s; s = s->prefix.get())
+      segments.push_back(s);
+    std::reverse(segments.begin(), segments.end());
+    it.segment = segments.front();
+  }
+  return it;
+}
+
+void ConstraintManager::append(ref<Expr> e) {
+  size_t offset = size();
+  last = new ConstraintNode(last, e);
+
+  // The last segment is extended in place when it ends with the constraints
+  // of this set, even if shared with copies of the set that are shorter
+  if (segment.isNull())
+    segment = new ConstraintSegment(ref<ConstraintSegment>(), 0);
+  else if (segment->offset + segment->constraints.size() != offset)
+    segment = new ConstraintSegment(segment, offset);
+  segment->constraints.push_back(e);
+}
+
 bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
-  ConstraintManager::constraints_ty old;
-  bool changed = false;
+  // The constraints before the first rewritten one are kept, together with
+  // their nodes and segments, which remain shared with the copies of the set
+  const_iterator it = begin(), ie = end();
+  size_t kept = 0;
+  ref<Expr> rewritten;
+  for (; it != ie; ++it, ++kept) {
+    rewritten = visitor.visit(*it);
+    if (rewritten != *it)
+      break;
+  }
+  if (it == ie)
+    return false;
 
-  constraints.swap(old);
-  for (ConstraintManager::constraints_ty::iterator 
+  std::vector<ref<Expr> > old(++it, ie);
+
+  // The parents are copied before the references to their children are
+  // dropped, which may release the children
+  while (!last.isNull() && last->size > kept) {
+    ref<ConstraintNode> parent = last->parent;
+    last = parent;
+  }
+  if (kept == 0) {
+    segment = ref<ConstraintSegment>();
+  } else {
+    // The segment holding the last kept constraint, which append() extends
+    // in place only when it ends there
+    while (segment->offset >= kept) {
+      ref<ConstraintSegment> prefix = segment->prefix;
+      segment = prefix;
+    }
+  }
+
+  // The factors are computed again when needed
+  factors = ref<IndependentFactors>();
+
+  addConstraintInternal(rewritten); // enable further reductions
+  for (std::vector<ref<Expr> >::iterator
          it = old.begin(), ie = old.end(); it != ie; ++it) {
     ref<Expr> &ce = *it;
     ref<Expr> e = visitor.visit(ce);
 
     if (e!=ce) {
       addConstraintInternal(e); // enable further reductions
-      changed = true;
     } else {
-      constraints.push_back(ce);
+      append(ce);
     }
   }
 
-  return changed;
+  return true;
 }
 
 void ConstraintManager::simplifyForValidConstraint(ref<Expr> e) {
@@ -120,17 +226,23 @@ ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e,
 
   std::map<ref<Expr>, std::pair<ref<Expr>, ref<Expr> > > equalities;
 
-  for (ConstraintManager::constraints_ty::const_iterator 
-         it = constraints.begin(), ie = constraints.end(); it != ie; ++it) {
-    if (const EqExpr *ee = dyn_cast<EqExpr>(*it)) {
+  // The list is walked from the last constraint, which is the one kept for
+  // a repeated key, without flattening it
+  for (ConstraintNode *node = last.get(); node; node = node->parent.get()) {
+    const ref<Expr> &constraint = node->constraint;
+    if (const EqExpr *ee = dyn_cast<EqExpr>(constraint)) {
       if (isa<ConstantExpr>(ee->left)) {
-        equalities[ee->right] = std::make_pair(ee->left, *it);
+        equalities.insert(std::make_pair(
+            ee->right, std::make_pair(ee->left, constraint)));
       } else {
-        equalities[*it] =
-            std::make_pair(ConstantExpr::alloc(1, Expr::Bool), *it);
+        equalities.insert(std::make_pair(
+            constraint,
+            std::make_pair(ConstantExpr::alloc(1, Expr::Bool), constraint)));
       }
     } else {
-      equalities[*it] = std::make_pair(ConstantExpr::alloc(1, Expr::Bool), *it);
+      equalities.insert(std::make_pair(
+          constraint,
+          std::make_pair(ConstantExpr::alloc(1, Expr::Bool), constraint)));
     }
   }
 
@@ -171,12 +283,16 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
 	rewriteConstraints(visitor);
       }
     }
-    constraints.push_back(e);
+    append(e);
+    if (!factors.isNull())
+      addToFactors(e, size() - 1);
     break;
   }
     
   default:
-    constraints.push_back(e);
+    append(e);
+    if (!factors.isNull())
+      addToFactors(e, size() - 1);
     break;
   }
 }
@@ -185,3 +301,83 @@ void ConstraintManager::addConstraint(ref<Expr> e) {
   e = simplifyExpr(e);
   addConstraintInternal(e);
 }
+
+void ConstraintManager::addToFactors(ref<Expr> e, size_t position) const {
+  // The factors are updated in place unless shared with a copy of this set
+  if (factors->refCount != 1) {
+    ref<IndependentFactors> shared = factors;
+    factors = new IndependentFactors();
+    factors->factors = shared->factors;
+  }
+
+  // As the factors do not intersect each other, a factor not intersecting
+  // the constraint does not intersect the merged factor either, hence one
+  // pass suffices.
+  IndependentElementSet elements(e);
+  elements.exprs.clear();
+  std::vector<ref<IndependentFactor> > &all = factors->factors;
+  std::vector<ref<IndependentFactor> > intersecting;
+  unsigned largest = 0;
+  size_t kept = 0;
+  for (size_t i = 0; i < all.size(); ++i) {
+    if (elements.intersects(all[i]->elements)) {
+      if (!intersecting.empty() &&
+          all[i]->constraints->size >
+              intersecting[largest]->constraints->size)
+        largest = intersecting.size();
+      intersecting.push_back(all[i]);
+    } else {
+      all[kept++] = all[i];
+    }
+  }
+  all.resize(kept);
+
+  // The other factors are merged into the largest one, which is extended in
+  // place unless shared, and the merged constraints are linked rather than
+  // copied
+  ref<IndependentFactorNode> node = new IndependentFactorNode(e, position);
+  ref<IndependentFactor> factor;
+  if (intersecting.empty()) {
+    factor = new IndependentFactor(elements, node);
+  } else if (intersecting[largest]->refCount == 1) {
+    factor = intersecting[largest];
+    factor->elements.add(elements);
+  } else {
+    factor = new IndependentFactor(intersecting[largest]->elements, node);
+    factor->elements.add(elements);
+  }
+  for (unsigned i = 0; i < intersecting.size(); ++i) {
+    if (i != largest)
+      factor->elements.add(intersecting[i]->elements);
+    node->merged.push_back(intersecting[i]->constraints);
+    node->size += intersecting[i]->constraints->size;
+  }
+  factor->constraints = node;
+  all.push_back(factor);
+}
+
+void ConstraintManager::getIndependentConstraints(
+    ref<Expr> e, std::vector<ref<Expr> > &result) const {
+  if (factors.isNull()) {
+    factors = new IndependentFactors();
+    for (ConstraintNode *node = last.get(); node; node = node->parent.get())
+      addToFactors(node->constraint, node->size - 1);
+  }
+
+  // The constraints of the intersecting factors are put back in the order of
+  // the set by their positions, without walking the whole set
+  IndependentElementSet elements(e);
+  std::vector<std::pair<size_t, ref<Expr> > > slice;
+  for (std::vector<ref<IndependentFactor> >::const_iterator
+           it = factors->factors.begin(), ie = factors->factors.end();
+       it != ie; ++it) {
+    if (elements.intersects((*it)->elements))
+      (*it)->constraints->getConstraints(slice);
+  }
+  std::sort(slice.begin(), slice.end());
+
+  for (std::vector<std::pair<size_t, ref<Expr> > >::const_iterator
+           it = slice.begin(), ie = slice.end();
+       it != ie; ++it)
+    result.push_back(it->second);
+}
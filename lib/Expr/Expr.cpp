@@ -31,12 +31,156 @@ namespace {
   ConstArrayOpt("const-array-opt",
 	 cl::init(false),
 	 cl::desc("Enable various optimizations involving all-constant arrays."));
+
+  cl::opt<bool, true>
+  HashConsExpr("hash-cons-expr",
+               cl::location(Expr::hashConsing),
+               cl::desc("Share one node among structurally equal "
+                        "expressions (default=off)."));
 }
 
 /***/
 
 unsigned Expr::count = 0;
 
+bool Expr::hashConsing = false;
+
+unsigned Expr::uniqueCount = 0;
+
+/// The hash-consed expressions, in an open-addressing table indexed by their
+/// hash values, with linear probing. It is at most half full, and never
+/// deleted, as expressions may still be released during the static
+/// destruction at exit.
+static std::vector<Expr *> &getUniqueTable() {
+  static std::vector<Expr *> *table = new std::vector<Expr *>(1024, 0);
+  return *table;
+}
+
+/// The first slot of the unique table to probe for the hash value
+static inline size_t getUniqueSlot(unsigned hash, size_t mask) {
+  // The hash values are often multiples of MAGIC_HASH_CONSTANT, hence they
+  // are scrambled first
+  return (hash * 0x9E3779B1U) & mask;
+}
+
+void Expr::ConsKey::computeHash() {
+  // The same as the computeHash of the expression
+  switch (kind) {
+  case Constant:
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 1)
+    hash = hash_value(*value) ^ (width * MAGIC_HASH_CONSTANT);
+#else
+    hash = value->getHashValue() ^ (width * MAGIC_HASH_CONSTANT);
+#endif
+    break;
+  case Read:
+    hash = kids[0]->hash() * MAGIC_HASH_CONSTANT;
+    hash ^= updates->hash();
+    break;
+  case Extract:
+    hash = offset * MAGIC_HASH_CONSTANT;
+    hash ^= width * MAGIC_HASH_CONSTANT;
+    hash ^= kids[0]->hash() * MAGIC_HASH_CONSTANT;
+    break;
+  case ZExt:
+  case SExt:
+    hash = (width * MAGIC_HASH_CONSTANT) ^ kids[0]->hash() * MAGIC_HASH_CONSTANT;
+    break;
+  case Not:
+    hash = kids[0]->hash() * MAGIC_HASH_CONSTANT * Not;
+    break;
+  default:
+    hash = kind * MAGIC_HASH_CONSTANT;
+    for (unsigned i = 0; i < numKids; ++i) {
+      hash <<= 1;
+      hash ^= kids[i]->hash() * MAGIC_HASH_CONSTANT;
+    }
+  }
+}
+
+bool Expr::ConsKey::matches(const Expr &e) const {
+  if (e.hashValue != hash || e.getKind() != kind || e.getNumKids() != numKids)
+    return false;
+  if (width && e.getWidth() != width)
+    return false;
+  for (unsigned i = 0; i < numKids; ++i)
+    if (e.getKid(i).get() != kids[i])
+      return false;
+
+  switch (kind) {
+  case Constant:
+    return cast<ConstantExpr>(e).getAPValue() == *value;
+  case Read:
+    return !cast<ReadExpr>(e).updates.compare(*updates);
+  case Extract:
+    return cast<ExtractExpr>(e).offset == offset;
+  default:
+    return true;
+  }
+}
+
+Expr *Expr::findUnique(const ConsKey &key) {
+  std::vector<Expr *> &table = getUniqueTable();
+  size_t mask = table.size() - 1;
+  for (size_t i = getUniqueSlot(key.hash, mask); table[i]; i = (i + 1) & mask)
+    if (key.matches(*table[i]))
+      return table[i];
+  return 0;
+}
+
+void Expr::insertUnique(Expr *e) {
+  // Only the expressions whose kids are unique are found by their kids'
+  // addresses, and are structurally different from the other unique ones
+  for (unsigned i = 0, n = e->getNumKids(); i < n; ++i)
+    if (!e->getKid(i)->isUnique)
+      return;
+
+  std::vector<Expr *> &table = getUniqueTable();
+  if (2 * (uniqueCount + 1) > table.size()) {
+    std::vector<Expr *> old(2 * table.size(), 0);
+    old.swap(table);
+    size_t mask = table.size() - 1;
+    for (std::vector<Expr *>::iterator it = old.begin(), ie = old.end();
+         it != ie; ++it) {
+      if (!*it)
+        continue;
+      size_t i = getUniqueSlot((*it)->hashValue, mask);
+      while (table[i])
+        i = (i + 1) & mask;
+      table[i] = *it;
+    }
+  }
+
+  size_t mask = table.size() - 1;
+  size_t i = getUniqueSlot(e->hashValue, mask);
+  while (table[i])
+    i = (i + 1) & mask;
+  table[i] = e;
+  e->isUnique = 1;
+  ++uniqueCount;
+}
+
+void Expr::removeUnique(Expr *e) {
+  std::vector<Expr *> &table = getUniqueTable();
+  size_t mask = table.size() - 1;
+  size_t i = getUniqueSlot(e->hashValue, mask);
+  while (table[i] != e)
+    i = (i + 1) & mask;
+
+  // The expressions probed past the emptied slot are moved back into it, so
+  // that the probes still find them
+  for (size_t j = (i + 1) & mask; table[j]; j = (j + 1) & mask) {
+    size_t k = getUniqueSlot(table[j]->hashValue, mask);
+    if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+      continue;
+    table[i] = table[j];
+    i = j;
+  }
+  table[i] = 0;
+  e->isUnique = 0;
+  --uniqueCount;
+}
+
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
 
@@ -87,6 +231,14 @@ ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
 int Expr::compare(const Expr &b, ExprEquivSet &equivs) const {
   if (this == &b) return 0;
 
+  // Distinct hash-consed expressions are structurally different, hence they
+  // never compare equal and are not recorded in equivs. They are still
+  // ordered by their structure, not by address, as non-unique expressions
+  // (e.g., built while hash-consing was off) may be compared with both, and
+  // the order has to stay transitive. Their equal kids are shared, so the
+  // comparison stops at the first differing kids.
+  bool unique = isUnique && b.isUnique;
+
   const Expr *ap, *bp;
   if (this < &b) {
     ap = this; bp = &b;
@@ -94,7 +246,7 @@ int Expr::compare(const Expr &b, ExprEquivSet &equivs) const {
     ap = &b; bp = this;
   }
 
-  if (equivs.count(std::make_pair(ap, bp)))
+  if (!unique && equivs.count(std::make_pair(ap, bp)))
     return 0;
 
   Kind ak = getKind(), bk = b.getKind();
@@ -112,7 +264,8 @@ int Expr::compare(const Expr &b, ExprEquivSet &equivs) const {
     if (int res = getKid(i)->compare(*b.getKid(i), equivs))
       return res;
 
-  equivs.insert(std::make_pair(ap, bp));
+  if (!unique)
+    equivs.insert(std::make_pair(ap, bp));
   return 0;
 }
 
@@ -83,6 +83,11 @@ Solver *createCoreSolver(CoreSolverType cst) {
     return createDummySolver();
   case Z3_SOLVER:
 #ifdef ENABLE_Z3
+    if (Z3Workers) {
+      llvm::errs() << "Using Z3 solver backend in " << Z3Workers
+                   << " worker processes\n";
+      return new Z3WorkerSolver(Z3Workers, Z3WorkerMemoryMB);
+    }
     llvm::errs() << "Using Z3 solver backend\n";
     return new Z3Solver();
 #else
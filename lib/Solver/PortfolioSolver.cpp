@@ -0,0 +1,420 @@
+//===-- PortfolioSolver.cpp -------------------------------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementation of a solver racing several core
+/// solvers on the hard queries.
+///
+/// The primary core solver, of -solver-backend, answers the queries in KLEE's
+/// process, so that its incremental state and caches are kept. A query it
+/// does not answer within -solver-portfolio-threshold seconds is raced: each
+/// core solver, the primary one included, is run in a forked process, so
+/// that the solvers neither share KLEE expressions, whose reference counts
+/// are not thread safe, nor need to be interruptible. The first process to
+/// answer writes the result to a socket, and the other processes are killed.
+///
+//===----------------------------------------------------------------------===//
+#include "SolverProcess.h"
+
+#include "klee/CommandLine.h"
+#include "klee/Constraints.h"
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/TimerStatIncrementer.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace klee {
+
+class PortfolioSolverImpl : public SolverImpl {
+  struct Backend {
+    Solver *solver;
+    Statistic *wins;
+
+    Backend(Solver *_solver, Statistic *_wins)
+        : solver(_solver), wins(_wins) {}
+  };
+
+  std::vector<Backend> backends;
+
+  double timeout;
+
+  SolverRunStatus runStatusCode;
+
+  /// The backend answering the queries that only Z3 supports, and the
+  /// unsatisfiable queries when their cores are needed for interpolation,
+  /// or null
+  Solver *z3Solver;
+
+  /// race - Run the operation with the backends from the given index on, in
+  /// forked processes, until the deadline if non-zero. Returns the index of
+  /// the backend of the reply, or the number of backends on failure.
+  unsigned race(unsigned first, double deadline, const Query &query,
+                SolverReply::Operation operation,
+                const std::vector<const Array *> *objects, SolverReply &reply);
+
+  /// solve - Run the operation with the primary backend in KLEE's process,
+  /// and race the backends when the primary one does not answer within the
+  /// threshold. Sets raced to whether the query was raced.
+  bool solve(const Query &query, SolverReply::Operation operation,
+             const std::vector<const Array *> *objects, SolverReply &reply,
+             bool &raced);
+
+  /// accept - Whether the reply of a backend is taken as the result
+  bool accept(const Backend &backend, const SolverReply &reply) const;
+
+public:
+  PortfolioSolverImpl(const std::vector<std::pair<CoreSolverType, Solver *> >
+                          &solvers);
+  ~PortfolioSolverImpl();
+
+  bool computeTruth(const Query &, bool &isValid,
+                    std::vector<ref<Expr> > &unsatCore);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution,
+                            std::vector<ref<Expr> > &unsatCore);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(double _timeout);
+};
+
+bool PortfolioSolverImpl::accept(const Backend &backend,
+                                 const SolverReply &reply) const {
+  bool unsat;
+  if (!reply.isSuccess(unsat))
+    return false;
+
+  // Only Z3 computes the unsatisfiability cores that interpolation needs
+  if (unsat && INTERPOLATION_ENABLED && z3Solver)
+    return backend.solver == z3Solver;
+  return true;
+}
+
+unsigned PortfolioSolverImpl::race(unsigned first, double deadline,
+                                   const Query &query,
+                                   SolverReply::Operation operation,
+                                   const std::vector<const Array *> *objects,
+                                   SolverReply &reply) {
+  unsigned size = backends.size();
+  std::vector<pid_t> pids(size, -1);
+  std::vector<int> fds(size, -1);
+
+  fflush(stdout);
+  fflush(stderr);
+  for (unsigned i = first; i < size; ++i) {
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == -1) {
+      klee_warning("socketpair failed (for solver portfolio)");
+      continue;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for solver portfolio)");
+      close(sockets[0]);
+      close(sockets[1]);
+      continue;
+    }
+
+    if (pid == 0) {
+      // The process is the leader of a new group, so that the processes
+      // forked by the backend, e.g., by STP, are killed together with it
+      setpgid(0, 0);
+      for (unsigned j = first; j < i; ++j) {
+        if (fds[j] != -1)
+          close(fds[j]);
+      }
+      close(sockets[0]);
+
+      SolverReply message;
+      message.solve(backends[i].solver, query, operation, objects);
+      sendMessage(sockets[1], message.getData());
+      _exit(0);
+    }
+
+    setpgid(pid, pid);
+    close(sockets[1]);
+    pids[i] = pid;
+    fds[i] = sockets[0];
+  }
+
+  unsigned winner = size;
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+  while (winner == size) {
+    std::vector<struct pollfd> polled;
+    std::vector<unsigned> polledBackends;
+    for (unsigned i = first; i < size; ++i) {
+      if (fds[i] == -1)
+        continue;
+      struct pollfd p;
+      p.fd = fds[i];
+      p.events = POLLIN;
+      p.revents = 0;
+      polled.push_back(p);
+      polledBackends.push_back(i);
+    }
+    if (polled.empty())
+      break;
+
+    int milliseconds = -1;
+    if (deadline)
+      milliseconds =
+          std::max(0, (int)((deadline - util::getWallTime()) * 1000));
+    int n = poll(&polled[0], polled.size(), milliseconds);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      if (n == 0)
+        runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+      break;
+    }
+
+    // A process writes its reply at once before exiting, hence the reply
+    // is read without waiting for the other processes
+    for (unsigned j = 0; j < polled.size() && winner == size; ++j) {
+      if (!polled[j].revents)
+        continue;
+      unsigned i = polledBackends[j];
+      SolverReply message;
+      bool received = receiveMessage(fds[i], message.getData());
+      close(fds[i]);
+      fds[i] = -1;
+
+      if (received && accept(backends[i], message)) {
+        winner = i;
+        reply = message;
+      }
+    }
+  }
+
+  for (unsigned i = first; i < size; ++i) {
+    if (pids[i] == -1)
+      continue;
+    if (i != winner) {
+      kill(-pids[i], SIGKILL);
+      kill(pids[i], SIGKILL);
+    }
+    if (fds[i] != -1)
+      close(fds[i]);
+    int status;
+    while (waitpid(pids[i], &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+
+  if (winner < size)
+    ++*backends[winner].wins;
+  return winner;
+}
+
+bool PortfolioSolverImpl::solve(const Query &query,
+                                SolverReply::Operation operation,
+                                const std::vector<const Array *> *objects,
+                                SolverReply &reply, bool &raced) {
+  Backend &primary = backends.front();
+  double start = util::getWallTime();
+  unsigned first = 0;
+  raced = false;
+
+  if (PortfolioThreshold > 0) {
+    bool limited = !timeout || PortfolioThreshold < timeout;
+    if (limited)
+      primary.solver->setCoreSolverTimeout(PortfolioThreshold);
+    reply.solve(primary.solver, query, operation, objects);
+    if (limited)
+      primary.solver->setCoreSolverTimeout(timeout);
+    runStatusCode = primary.solver->impl->getOperationStatusCode();
+
+    if (accept(primary, reply)) {
+      ++*primary.wins;
+      return true;
+    }
+
+    bool unsat;
+    bool timedOut = !reply.isSuccess(unsat) &&
+                    runStatusCode == SOLVER_RUN_STATUS_TIMEOUT;
+    if (timedOut && !limited)
+      return false;
+
+    // The primary backend rejoins the race only when cut short by the
+    // threshold, otherwise only the other backends may still answer
+    if (!timedOut)
+      first = 1;
+  } else {
+    ++stats::queries;
+    if (operation != SolverReply::Truth)
+      ++stats::queryCounterexamples;
+  }
+
+  double deadline = timeout ? start + timeout : 0;
+  if (deadline && util::getWallTime() >= deadline) {
+    runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+    return false;
+  }
+
+  TimerStatIncrementer t(stats::queryTime);
+  ++stats::portfolioRaces;
+  raced = true;
+  return race(first, deadline, query, operation, objects, reply) <
+         backends.size();
+}
+
+PortfolioSolverImpl::PortfolioSolverImpl(
+    const std::vector<std::pair<CoreSolverType, Solver *> > &solvers)
+    : timeout(0.0), runStatusCode(SOLVER_RUN_STATUS_FAILURE), z3Solver(0) {
+  for (std::vector<std::pair<CoreSolverType, Solver *> >::const_iterator
+           it = solvers.begin(),
+           ie = solvers.end();
+       it != ie; ++it) {
+    Statistic *wins = &stats::portfolioSTPWins;
+    if (it->first == METASMT_SOLVER) {
+      wins = &stats::portfolioMetaSMTWins;
+    } else if (it->first == Z3_SOLVER) {
+      wins = &stats::portfolioZ3Wins;
+      if (!z3Solver)
+        z3Solver = it->second;
+    }
+    backends.push_back(Backend(it->second, wins));
+  }
+}
+
+PortfolioSolverImpl::~PortfolioSolverImpl() {
+  for (std::vector<Backend>::iterator it = backends.begin(),
+                                      ie = backends.end();
+       it != ie; ++it)
+    delete it->solver;
+}
+
+bool PortfolioSolverImpl::computeTruth(const Query &query, bool &isValid,
+                                       std::vector<ref<Expr> > &unsatCore) {
+  if (z3Solver && isExistentialQuery(query)) {
+    bool success = z3Solver->impl->computeTruth(query, isValid, unsatCore);
+    runStatusCode = z3Solver->impl->getOperationStatusCode();
+    return success;
+  }
+
+  // The queries are counted by the primary backend, or when raced from the
+  // start, by solve
+  SolverReply reply;
+  bool raced;
+  if (!solve(query, SolverReply::Truth, 0, reply, raced) ||
+      !reply.getTruth(query, isValid, unsatCore))
+    return false;
+
+  if (isValid) {
+    if (raced)
+      ++stats::queriesValid;
+    runStatusCode = SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  } else {
+    if (raced)
+      ++stats::queriesInvalid;
+    runStatusCode = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+  return true;
+}
+
+bool PortfolioSolverImpl::computeValue(const Query &query, ref<Expr> &result) {
+  SolverReply reply;
+  bool raced;
+  if (!solve(query, SolverReply::Value, 0, reply, raced) ||
+      !reply.getValue(result))
+    return false;
+
+  runStatusCode = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  return true;
+}
+
+bool PortfolioSolverImpl::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution,
+    std::vector<ref<Expr> > &unsatCore) {
+  if (z3Solver && isExistentialQuery(query)) {
+    bool success = z3Solver->impl->computeInitialValues(
+        query, objects, values, hasSolution, unsatCore);
+    runStatusCode = z3Solver->impl->getOperationStatusCode();
+    return success;
+  }
+
+  SolverReply reply;
+  bool raced;
+  if (!solve(query, SolverReply::InitialValues, &objects, reply, raced) ||
+      !reply.getInitialValues(query, objects, values, hasSolution, unsatCore))
+    return false;
+
+  if (hasSolution) {
+    if (raced)
+      ++stats::queriesInvalid;
+    runStatusCode = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  } else {
+    if (raced)
+      ++stats::queriesValid;
+    runStatusCode = SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  }
+  return true;
+}
+
+SolverImpl::SolverRunStatus PortfolioSolverImpl::getOperationStatusCode() {
+  return runStatusCode;
+}
+
+char *PortfolioSolverImpl::getConstraintLog(const Query &query) {
+  return backends.front().solver->getConstraintLog(query);
+}
+
+void PortfolioSolverImpl::setCoreSolverTimeout(double _timeout) {
+  timeout = _timeout;
+  for (std::vector<Backend>::iterator it = backends.begin(),
+                                      ie = backends.end();
+       it != ie; ++it)
+    it->solver->setCoreSolverTimeout(_timeout);
+}
+
+Solver *createPortfolioSolver(CoreSolverType cst,
+                              const std::vector<CoreSolverType> &others) {
+  std::vector<std::pair<CoreSolverType, Solver *> > solvers;
+  std::vector<CoreSolverType> types(1, cst);
+  types.insert(types.end(), others.begin(), others.end());
+  for (std::vector<CoreSolverType>::iterator it = types.begin(),
+                                             ie = types.end();
+       it != ie; ++it) {
+    bool duplicate = false;
+    for (unsigned i = 0; i < solvers.size(); ++i)
+      duplicate = duplicate || solvers[i].first == *it;
+    if (duplicate)
+      continue;
+
+    Solver *solver = createCoreSolver(*it);
+    if (!solver) {
+      for (unsigned i = 0; i < solvers.size(); ++i)
+        delete solvers[i].second;
+      return NULL;
+    }
+    solvers.push_back(std::make_pair(*it, solver));
+  }
+
+  if (solvers.size() == 1)
+    return solvers.front().second;
+  llvm::errs() << "Racing " << solvers.size() << " core solver backends\n";
+  return new Solver(new PortfolioSolverImpl(solvers));
+}
+}
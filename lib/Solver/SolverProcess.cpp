@@ -0,0 +1,243 @@
+//===-- SolverProcess.cpp ---------------------------------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementation of the messages between KLEE and
+/// the processes running core solvers on its behalf.
+///
+//===----------------------------------------------------------------------===//
+#include "SolverProcess.h"
+
+#include "klee/CommandLine.h"
+#include "klee/Constraints.h"
+#include "klee/SolverImpl.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace klee {
+
+void SolverReply::write(uint64_t word) {
+  data.append(reinterpret_cast<const char *>(&word), sizeof(word));
+}
+
+bool SolverReply::read(uint64_t &word) {
+  if (position + sizeof(word) > data.size())
+    return false;
+  data.copy(reinterpret_cast<char *>(&word), sizeof(word), position);
+  position += sizeof(word);
+  return true;
+}
+
+bool SolverReply::read(std::vector<unsigned char> &bytes, size_t size) {
+  if (position + size > data.size())
+    return false;
+  bytes.assign(data.begin() + position, data.begin() + position + size);
+  position += size;
+  return true;
+}
+
+void SolverReply::writeUnsatCore(const Query &query,
+                                 const std::vector<ref<Expr> > &unsatCore) {
+  std::vector<uint64_t> positions;
+  for (std::vector<ref<Expr> >::const_iterator it = unsatCore.begin(),
+                                               ie = unsatCore.end();
+       it != ie; ++it) {
+    uint64_t index = 0;
+    for (ConstraintManager::const_iterator ci = query.constraints.begin(),
+                                           ce = query.constraints.end();
+         ci != ce; ++ci, ++index) {
+      if (*ci == *it) {
+        positions.push_back(index);
+        break;
+      }
+    }
+  }
+  write(positions.size());
+  for (std::vector<uint64_t>::iterator it = positions.begin(),
+                                       ie = positions.end();
+       it != ie; ++it)
+    write(*it);
+}
+
+bool SolverReply::readUnsatCore(const Query &query,
+                                std::vector<ref<Expr> > &unsatCore) {
+  uint64_t size, index;
+  if (!read(size))
+    return false;
+  for (uint64_t i = 0; i < size; ++i) {
+    if (!read(index) || index >= query.constraints.size())
+      return false;
+    ConstraintManager::const_iterator it = query.constraints.begin();
+    std::advance(it, index);
+    unsatCore.push_back(*it);
+  }
+  return true;
+}
+
+void SolverReply::solve(Solver *solver, const Query &query,
+                        Operation operation,
+                        const std::vector<const Array *> *objects) {
+  data.clear();
+  position = 0;
+  std::vector<ref<Expr> > unsatCore;
+
+  switch (operation) {
+  case Truth: {
+    bool isValid;
+    if (!solver->impl->computeTruth(query, isValid, unsatCore))
+      break;
+    write(1);
+    write(isValid);
+    writeUnsatCore(query, unsatCore);
+    break;
+  }
+  case Value: {
+    ref<Expr> result;
+    if (!solver->impl->computeValue(query, result))
+      break;
+    const llvm::APInt &value = llvm::cast<ConstantExpr>(result)->getAPValue();
+    write(1);
+    write(0);
+    write(value.getBitWidth());
+    for (unsigned i = 0; i < value.getNumWords(); ++i)
+      write(value.getRawData()[i]);
+    break;
+  }
+  case InitialValues: {
+    std::vector<std::vector<unsigned char> > values;
+    bool hasSolution;
+    if (!solver->impl->computeInitialValues(query, *objects, values,
+                                            hasSolution, unsatCore))
+      break;
+    write(1);
+    write(!hasSolution);
+    if (hasSolution) {
+      for (std::vector<std::vector<unsigned char> >::iterator
+               it = values.begin(),
+               ie = values.end();
+           it != ie; ++it)
+        data.append(it->begin(), it->end());
+    } else {
+      writeUnsatCore(query, unsatCore);
+    }
+    break;
+  }
+  }
+
+  if (data.empty())
+    write(0);
+}
+
+bool SolverReply::isSuccess(bool &unsat) const {
+  // A failure is a single word
+  uint64_t words[2];
+  if (data.size() < sizeof(words))
+    return false;
+  data.copy(reinterpret_cast<char *>(words), sizeof(words));
+  unsat = words[1];
+  return words[0];
+}
+
+bool SolverReply::getTruth(const Query &query, bool &isValid,
+                           std::vector<ref<Expr> > &unsatCore) {
+  uint64_t success, unsat;
+  position = 0;
+  if (!read(success) || !success || !read(unsat))
+    return false;
+  isValid = unsat;
+  return readUnsatCore(query, unsatCore);
+}
+
+bool SolverReply::getValue(ref<Expr> &result) {
+  uint64_t success, unsat, width;
+  position = 0;
+  if (!read(success) || !success || !read(unsat) || !read(width) || !width)
+    return false;
+  std::vector<uint64_t> words((width + 63) / 64);
+  for (std::vector<uint64_t>::iterator it = words.begin(), ie = words.end();
+       it != ie; ++it) {
+    if (!read(*it))
+      return false;
+  }
+  result =
+      ConstantExpr::alloc(llvm::APInt(width, llvm::ArrayRef<uint64_t>(words)));
+  return true;
+}
+
+bool SolverReply::getInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution,
+    std::vector<ref<Expr> > &unsatCore) {
+  uint64_t success, unsat;
+  position = 0;
+  if (!read(success) || !success || !read(unsat))
+    return false;
+  hasSolution = !unsat;
+  if (!hasSolution)
+    return readUnsatCore(query, unsatCore);
+
+  values = std::vector<std::vector<unsigned char> >(objects.size());
+  for (unsigned i = 0; i < objects.size(); ++i) {
+    if (!read(values[i], objects[i]->size))
+      return false;
+  }
+  return true;
+}
+
+bool isExistentialQuery(const Query &query) {
+  return INTERPOLATION_ENABLED &&
+         (llvm::isa<ExistsExpr>(query.expr) ||
+          (llvm::isa<EqExpr>(query.expr) &&
+           llvm::isa<ExistsExpr>(query.expr->getKid(1))));
+}
+
+bool sendMessage(int fd, const std::string &message) {
+  uint64_t length = message.size();
+  std::string frame(reinterpret_cast<const char *>(&length), sizeof(length));
+  frame.append(message);
+  for (size_t written = 0; written < frame.size();) {
+    ssize_t n = send(fd, frame.data() + written, frame.size() - written,
+                     MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    written += n;
+  }
+  return true;
+}
+
+/// readFully - Read exactly the given number of bytes
+static bool readFully(int fd, char *buffer, size_t size) {
+  for (size_t done = 0; done < size;) {
+    ssize_t n = read(fd, buffer + done, size - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    done += n;
+  }
+  return true;
+}
+
+bool receiveMessage(int fd, std::string &message) {
+  uint64_t length;
+  if (!readFully(fd, reinterpret_cast<char *>(&length), sizeof(length)))
+    return false;
+  message.resize(length);
+  return !length || readFully(fd, &message[0], length);
+}
+}
@@ -0,0 +1,92 @@
+//===-- SolverProcess.h -----------------------------------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the declarations of the messages between KLEE and the
+/// processes running core solvers on its behalf.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SOLVERPROCESS_H
+#define KLEE_SOLVERPROCESS_H
+
+#include "klee/Solver.h"
+
+#include <string>
+#include <vector>
+
+namespace klee {
+
+/// SolverReply - The result of a solver operation, computed in a solver
+/// process. A reply is a sequence of 64-bit words: the success of the
+/// solver, whether the query is unsatisfiable, i.e., valid or without
+/// solution, and the result of the operation. The constraints of an
+/// unsatisfiability core are given as their positions in the query, hence
+/// the query of the receiver must have the constraints of the query solved,
+/// in the same order.
+class SolverReply {
+public:
+  enum Operation { Truth, Value, InitialValues };
+
+private:
+  std::string data;
+
+  size_t position;
+
+  void write(uint64_t word);
+
+  bool read(uint64_t &word);
+
+  bool read(std::vector<unsigned char> &bytes, size_t size);
+
+  void writeUnsatCore(const Query &query,
+                      const std::vector<ref<Expr> > &unsatCore);
+
+  bool readUnsatCore(const Query &query, std::vector<ref<Expr> > &unsatCore);
+
+public:
+  SolverReply() : position(0) {}
+
+  /// solve - Run the operation with the solver and set the reply to its
+  /// result. The objects are only used by InitialValues.
+  void solve(Solver *solver, const Query &query, Operation operation,
+             const std::vector<const Array *> *objects);
+
+  /// isSuccess - Whether the solver succeeded, and if so, whether the query
+  /// is unsatisfiable.
+  bool isSuccess(bool &unsat) const;
+
+  bool getTruth(const Query &query, bool &isValid,
+                std::vector<ref<Expr> > &unsatCore);
+
+  bool getValue(ref<Expr> &result);
+
+  bool getInitialValues(const Query &query,
+                        const std::vector<const Array *> &objects,
+                        std::vector<std::vector<unsigned char> > &values,
+                        bool &hasSolution, std::vector<ref<Expr> > &unsatCore);
+
+  std::string &getData() { return data; }
+};
+
+/// isExistentialQuery - Whether the query has existentially-quantified
+/// variables, as checked by Z3SolverImpl. Such queries are only solved by Z3,
+/// in KLEE's process.
+bool isExistentialQuery(const Query &query);
+
+/// sendMessage - Write a message to a stream socket, prefixed with its
+/// length. A closed socket is reported as a failure, not by SIGPIPE.
+bool sendMessage(int fd, const std::string &message);
+
+/// receiveMessage - Read a message written by sendMessage, blocking until it
+/// is complete. Fails on the end of the stream.
+bool receiveMessage(int fd, std::string &message);
+}
+
+#endif
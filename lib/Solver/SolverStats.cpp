@@ -27,6 +27,20 @@ Statistic stats::subsumptionQueryTime("SubsumptionQueryTime", "SQtime");
 Statistic stats::subsumptionQueryCount("SubsumptionQueryCount", "SCcount");
 Statistic stats::subsumptionQueryFailureCount("SubsumptionQueryFailureCount",
                                               "SFcount");
+Statistic stats::incrementalAssertions("IncrementalAssertions", "IAcount");
+Statistic stats::incrementalReusedAssertions("IncrementalReusedAssertions",
+                                             "IRcount");
+Statistic stats::portfolioSTPWins("PortfolioSTPWins", "PSwins");
+Statistic stats::portfolioMetaSMTWins("PortfolioMetaSMTWins", "PMwins");
+Statistic stats::portfolioZ3Wins("PortfolioZ3Wins", "PZwins");
+Statistic stats::portfolioRaces("PortfolioRaces", "Praces");
+Statistic stats::z3ConstructCacheHits("Z3ConstructCacheHits", "ZChits");
+Statistic stats::z3ConstructCacheMisses("Z3ConstructCacheMisses",
+                                        "ZCmisses");
+Statistic stats::z3ConstructCacheEvictions("Z3ConstructCacheEvictions",
+                                           "ZCevictions");
+uint64_t stats::z3ConstructCacheSize = 0;
+uint64_t stats::z3ConstructCachePeakSize = 0;
 
 #ifdef DEBUG
 Statistic stats::arrayHashTime("ArrayHashTime", "AHtime");
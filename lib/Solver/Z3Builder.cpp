@@ -59,7 +59,10 @@ void Z3ArrayExprHash::clear() {
 }
 
 Z3Builder::Z3Builder(bool autoClearConstructCache)
-    : autoClearConstructCache(autoClearConstructCache) {
+    : shadowReads(0), constructCacheHits(0), constructCacheMisses(0),
+      constructCacheEvictions(0), reportedConstructCacheSize(0),
+      autoClearConstructCache(autoClearConstructCache),
+      quantificationContext(0) {
   // FIXME: Should probably let the client pass in a Z3_config instead
   Z3_config cfg = Z3_mk_config();
   // It is very important that we ask Z3 to let us manage memory so that
@@ -78,6 +81,7 @@ Z3Builder::~Z3Builder() {
   clearConstructCache();
   _arr_hash.clear();
   Z3_del_context(ctx);
+  stats::z3ConstructCacheSize -= reportedConstructCacheSize;
 }
 
 Z3SortHandle Z3Builder::getBvSort(unsigned width) {
@@ -360,26 +364,39 @@ Z3ASTHandle Z3Builder::constructAShrByConstant(Z3ASTHandle expr, unsigned shift,
   }
 }
 
+/// isShadowArray - Whether the array is a shadow array of an interpolant,
+/// which is bound by the quantification contexts whose variables include it.
+static bool isShadowArray(const Array *root) {
+  return !root->name.find("__shadow__");
+}
+
 Z3ASTHandle Z3Builder::getInitialArray(const Array *root) {
 
   assert(root);
+
+  bool shadow = isShadowArray(root);
+  if (shadow)
+    ++shadowReads;
+
+  // In case this array is bound. This is checked before the array hash, which
+  // persists across queries, so that the array is bound even when it was
+  // free in an earlier query.
+  if (shadow && quantificationContext) {
+    QuantificationContext *qc = quantificationContext;
+
+    while (qc) {
+      std::map<std::string, Z3ASTHandle>::iterator it =
+          qc->existentials.find(root->name);
+      if (it != qc->existentials.end())
+        return it->second;
+      qc = qc->parent;
+    }
+  }
+
   Z3ASTHandle array_expr;
   bool hashed = _arr_hash.lookupArrayExpr(root, array_expr);
 
   if (!hashed) {
-    // In case this array is bound
-    if (!(root->name.find("__shadow__")) && quantificationContext) {
-      QuantificationContext *qc = quantificationContext;
-
-      while (qc) {
-        std::map<std::string, Z3ASTHandle>::iterator it =
-            qc->existentials.find(root->name);
-        if (it != qc->existentials.end())
-          return it->second;
-        qc = qc->parent;
-      }
-    }
-
     // Unique arrays by name, so we make sure the name is unique by
     // using the size of the array hash as a counter.
     std::string unique_id = llvm::itostr(_arr_hash._array_hash.size());
@@ -419,15 +436,24 @@ Z3ASTHandle Z3Builder::getArrayForUpdate(const Array *root,
   if (!un) {
     return (getInitialArray(root));
   } else {
+    // The updates of a shadow array translate differently inside and outside
+    // quantification contexts, hence they are only hashed outside.
+    bool quantifiedShadow = isShadowArray(root) && quantificationContext;
+
     // FIXME: This really needs to be non-recursive.
     Z3ASTHandle un_expr;
-    bool hashed = _arr_hash.lookupUpdateNodeExpr(un, un_expr);
+    bool hashed =
+        !quantifiedShadow && _arr_hash.lookupUpdateNodeExpr(un, un_expr);
 
-    if (!hashed) {
+    if (hashed) {
+      if (isShadowArray(root))
+        ++shadowReads;
+    } else {
       un_expr = writeExpr(getArrayForUpdate(root, un->next),
                           construct(un->index, 0), construct(un->value, 0));
 
-      _arr_hash.hashUpdateNodeExpr(un, un_expr);
+      if (!quantifiedShadow)
+        _arr_hash.hashUpdateNodeExpr(un, un_expr);
     }
 
     return (un_expr);
@@ -442,21 +468,93 @@ Z3ASTHandle Z3Builder::construct(ref<Expr> e, int *width_out) {
   if (!UseConstructHashZ3 || isa<ConstantExpr>(e)) {
     return constructActual(e, width_out);
   } else {
-    ExprHashMap<std::pair<Z3ASTHandle, unsigned> >::iterator it =
-        constructed.find(e);
-    if (it != constructed.end()) {
+    // A translation reading a shadow array made outside of a quantification
+    // context has the array free, and is not used inside one, where the
+    // array may be bound. Those made inside are kept by the context only.
+    ExprHashMap<ConstructedExpr>::iterator it = constructed.find(e);
+    if (it != constructed.end() &&
+        !(it->second.readsShadow && quantificationContext)) {
+      ++constructCacheHits;
+      if (it->second.readsShadow)
+        ++shadowReads;
       if (width_out)
-        *width_out = it->second.second;
-      return it->second.first;
-    } else {
-      int width;
-      if (!width_out)
-        width_out = &width;
-      Z3ASTHandle res = constructActual(e, width_out);
-      constructed.insert(std::make_pair(e, std::make_pair(res, *width_out)));
-      return res;
+        *width_out = it->second.width;
+      return it->second.ast;
+    }
+
+    it = retiredConstructed.find(e);
+    if (it != retiredConstructed.end() &&
+        !(it->second.readsShadow && quantificationContext)) {
+      // Still in use: move it to the current generation
+      ++constructCacheHits;
+      ConstructedExpr entry = it->second;
+      retiredConstructed.erase(it);
+      constructed.insert(std::make_pair(e, entry));
+      if (entry.readsShadow)
+        ++shadowReads;
+      if (width_out)
+        *width_out = entry.width;
+      return entry.ast;
+    }
+
+    if (quantificationContext) {
+      ExprHashMap<std::pair<Z3ASTHandle, unsigned> >::iterator scopedIt =
+          quantificationContext->constructed.find(e);
+      if (scopedIt != quantificationContext->constructed.end()) {
+        ++constructCacheHits;
+        ++shadowReads;
+        if (width_out)
+          *width_out = scopedIt->second.second;
+        return scopedIt->second.first;
+      }
+    }
+
+    ++constructCacheMisses;
+    int width;
+    if (!width_out)
+      width_out = &width;
+    uint64_t shadowReadsBefore = shadowReads;
+    Z3ASTHandle res = constructActual(e, width_out);
+    bool readsShadow = shadowReads != shadowReadsBefore;
+    if (readsShadow && quantificationContext)
+      quantificationContext->constructed.insert(
+          std::make_pair(e, std::make_pair(res, *width_out)));
+    else
+      constructed.insert(
+          std::make_pair(e, ConstructedExpr(res, *width_out, readsShadow)));
+    return res;
+  }
+}
+
+void Z3Builder::retireConstructCache(size_t maxSize) {
+  if (maxSize == 0) {
+    clearConstructCache();
+  } else if (constructed.size() >= maxSize / 2) {
+    constructCacheEvictions += retiredConstructed.size();
+    retiredConstructed.clear();
+    retiredConstructed.swap(constructed);
+
+    // A single query may have translated more than a generation can hold
+    if (retiredConstructed.size() >= maxSize / 2) {
+      constructCacheEvictions += retiredConstructed.size();
+      retiredConstructed.clear();
     }
   }
+  reportConstructCacheStatistics();
+}
+
+void Z3Builder::reportConstructCacheStatistics() {
+  stats::z3ConstructCacheHits += constructCacheHits;
+  stats::z3ConstructCacheMisses += constructCacheMisses;
+  stats::z3ConstructCacheEvictions += constructCacheEvictions;
+  constructCacheHits = constructCacheMisses = constructCacheEvictions = 0;
+
+  size_t size = getConstructCacheSize();
+  stats::z3ConstructCacheSize -= reportedConstructCacheSize;
+  stats::z3ConstructCacheSize += size;
+  if (stats::z3ConstructCacheSize > stats::z3ConstructCachePeakSize)
+    stats::z3ConstructCachePeakSize = stats::z3ConstructCacheSize;
+  reportedConstructCacheSize = size;
 }
 
 /** if *width_out!=1 then result is a bitvector,
@@ -117,6 +117,10 @@ class Z3Builder {
 
     QuantificationContext *parent;
 
+    /// constructed - The translations of the expressions that read shadow
+    /// arrays, made in this context and valid only while it is active.
+    ExprHashMap<std::pair<Z3ASTHandle, unsigned> > constructed;
+
     QuantificationContext(Z3Builder *builder, Z3_context _ctx,
                           std::set<const Array *> _existentials,
                           QuantificationContext *_parent);
@@ -130,9 +134,49 @@ class Z3Builder {
     QuantificationContext *getParent() { return parent; }
   };
 
-  ExprHashMap<std::pair<Z3ASTHandle, unsigned> > constructed;
+  /// ConstructedExpr - A cached translation of an expression.
+  struct ConstructedExpr {
+    Z3ASTHandle ast;
+    unsigned width;
+
+    /// readsShadow - Whether the expression reads a shadow array, which
+    /// translates to a free array outside of quantification contexts and to
+    /// a bound variable inside them.
+    bool readsShadow;
+
+    ConstructedExpr(Z3ASTHandle _ast, unsigned _width, bool _readsShadow)
+        : ast(_ast), width(_width), readsShadow(_readsShadow) {}
+  };
+
+  /// constructed - The Z3 ASTs and widths of the expressions translated or
+  /// reused since the construct cache was last retired. The translations of
+  /// expressions reading shadow arrays are only made outside quantification
+  /// contexts, and only used there.
+  ExprHashMap<ConstructedExpr> constructed;
+
+  /// retiredConstructed - The previous generation of the construct cache. An
+  /// expression found here is moved back to constructed, so that expressions
+  /// in use survive the next retirement and unused ones are evicted by it.
+  ExprHashMap<ConstructedExpr> retiredConstructed;
+
+  /// shadowReads - The number of shadow arrays read by the translations so
+  /// far, so that construct() can tell whether a translation read one.
+  uint64_t shadowReads;
+
   Z3ArrayExprHash _arr_hash;
 
+  /// Counters of the construct cache not yet added to the statistics. They
+  /// are kept here as construct() may run outside of the main thread.
+  uint64_t constructCacheHits;
+  uint64_t constructCacheMisses;
+  uint64_t constructCacheEvictions;
+
+  /// reportedConstructCacheSize - The size of the construct cache included in
+  /// stats::z3ConstructCacheSize when the cache was last retired.
+  size_t reportedConstructCacheSize;
+
+  void reportConstructCacheStatistics();
+
 private:
   Z3ASTHandle bvOne(unsigned width);
   Z3ASTHandle bvZero(unsigned width);
@@ -228,7 +272,23 @@ public:
     return res;
   }
 
-  void clearConstructCache() { constructed.clear(); }
+  void clearConstructCache() {
+    constructCacheEvictions += constructed.size() + retiredConstructed.size();
+    constructed.clear();
+    retiredConstructed.clear();
+  }
+
+  /// retireConstructCache - Bound the construct cache between queries to
+  /// fewer than maxSize entries. Once the current generation reaches half of
+  /// maxSize it becomes the retired generation, and the entries of the
+  /// previously retired generation that were not used since are evicted. A
+  /// maxSize of 0 clears the cache. The cache counters are then added to the
+  /// statistics, so this is only called from the main thread.
+  void retireConstructCache(size_t maxSize);
+
+  size_t getConstructCacheSize() const {
+    return constructed.size() + retiredConstructed.size();
+  }
 };
 }
 
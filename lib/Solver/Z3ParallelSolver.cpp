@@ -0,0 +1,334 @@
+//===-- Z3ParallelSolver.cpp ------------------------------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementation of a pool of Z3 worker threads for
+/// finding the first valid query of a sequence, used by subsumption checks.
+///
+/// Expressions are translated into the Z3 context of each worker by the
+/// calling thread, before the workers are started, as neither KLEE
+/// expressions nor Z3 contexts may be used by several threads at once. The
+/// workers only run Z3_solver_check.
+///
+//===----------------------------------------------------------------------===//
+#include "klee/Config/config.h"
+#ifdef ENABLE_Z3
+#include "Z3Builder.h"
+#include "klee/Constraints.h"
+#include "klee/Solver.h"
+#include "klee/SolverStats.h"
+#include "klee/TimerStatIncrementer.h"
+
+#include "llvm/Support/ErrorHandling.h"
+
+#include <climits>
+#include <pthread.h>
+#include <sstream>
+
+namespace klee {
+
+class Z3ParallelSolverImpl {
+  /// Worker - A thread with its own Z3 context. The worker solves the
+  /// queries at the positions i of the sequence such that i modulo the
+  /// number of workers is its index, in increasing order.
+  struct Worker {
+    Z3ParallelSolverImpl *pool;
+    unsigned index;
+    pthread_t thread;
+    Z3Builder *builder;
+    ::Z3_params solverParameters;
+    std::vector<Z3ASTHandle> trackingLiterals;
+
+    /// The position of the query being solved, or the number of queries
+    /// when the worker is not in Z3_solver_check
+    unsigned current;
+
+    /// The last generation of queries processed
+    unsigned generation;
+
+    Z3ASTHandle getTrackingLiteral(unsigned position);
+  };
+
+  std::vector<Worker *> workers;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t workReady;
+  pthread_cond_t workDone;
+
+  /// The generation of the current sequence of queries, incremented for
+  /// every call to computeFirstValid
+  unsigned generation;
+  unsigned finishedWorkers;
+  bool shutdown;
+
+  /// The solvers of the current sequence of queries, each in the context of
+  /// the worker solving it, and their outcomes
+  std::vector< ::Z3_solver> solvers;
+  std::vector< ::Z3_lbool> outcomes;
+
+  /// The position of the first query found valid so far
+  unsigned firstValid;
+
+  static void *run(void *worker);
+
+  void work(Worker *worker);
+
+  ::Z3_solver buildSolver(Worker *worker, const ConstraintManager &constraints,
+                          ref<Expr> expr, double timeout);
+
+public:
+  Z3ParallelSolverImpl(unsigned threads);
+  ~Z3ParallelSolverImpl();
+
+  unsigned computeFirstValid(const ConstraintManager &constraints,
+                             const std::vector<ref<Expr> > &exprs,
+                             double timeout, std::vector<bool> &success,
+                             std::vector<ref<Expr> > &unsatCore);
+};
+
+Z3ASTHandle
+Z3ParallelSolverImpl::Worker::getTrackingLiteral(unsigned position) {
+  // Named as in Z3SolverImpl::getTrackingLiteral
+  while (trackingLiterals.size() <= position) {
+    std::ostringstream stringStream;
+    stringStream << (trackingLiterals.size() + 1);
+
+    Z3_symbol symbol =
+        Z3_mk_string_symbol(builder->ctx, stringStream.str().c_str());
+    trackingLiterals.push_back(Z3ASTHandle(
+        Z3_mk_const(builder->ctx, symbol, Z3_mk_bool_sort(builder->ctx)),
+        builder->ctx));
+  }
+  return trackingLiterals[position];
+}
+
+Z3ParallelSolverImpl::Z3ParallelSolverImpl(unsigned threads)
+    : generation(0), finishedWorkers(0), shutdown(false), firstValid(0) {
+  assert(threads > 0 && "no worker threads");
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&workReady, NULL);
+  pthread_cond_init(&workDone, NULL);
+
+  for (unsigned i = 0; i < threads; ++i) {
+    Worker *worker = new Worker();
+    worker->pool = this;
+    worker->index = i;
+    worker->builder = new Z3Builder(/*autoClearConstructCache=*/false);
+    worker->solverParameters = Z3_mk_params(worker->builder->ctx);
+    Z3_params_inc_ref(worker->builder->ctx, worker->solverParameters);
+    worker->current = 0;
+    worker->generation = 0;
+    workers.push_back(worker);
+  }
+
+  for (std::vector<Worker *>::iterator it = workers.begin(),
+                                       ie = workers.end();
+       it != ie; ++it) {
+    if (pthread_create(&(*it)->thread, NULL, run, *it))
+      llvm::report_fatal_error("unable to create Z3 worker thread");
+  }
+}
+
+Z3ParallelSolverImpl::~Z3ParallelSolverImpl() {
+  pthread_mutex_lock(&mutex);
+  shutdown = true;
+  pthread_cond_broadcast(&workReady);
+  pthread_mutex_unlock(&mutex);
+
+  for (std::vector<Worker *>::iterator it = workers.begin(),
+                                       ie = workers.end();
+       it != ie; ++it) {
+    Worker *worker = *it;
+    pthread_join(worker->thread, NULL);
+    worker->trackingLiterals.clear();
+    Z3_params_dec_ref(worker->builder->ctx, worker->solverParameters);
+    delete worker->builder;
+    delete worker;
+  }
+
+  pthread_cond_destroy(&workDone);
+  pthread_cond_destroy(&workReady);
+  pthread_mutex_destroy(&mutex);
+}
+
+void *Z3ParallelSolverImpl::run(void *worker) {
+  Worker *w = static_cast<Worker *>(worker);
+  w->pool->work(w);
+  return NULL;
+}
+
+void Z3ParallelSolverImpl::work(Worker *worker) {
+  pthread_mutex_lock(&mutex);
+  while (true) {
+    while (!shutdown && worker->generation == generation)
+      pthread_cond_wait(&workReady, &mutex);
+    if (shutdown)
+      break;
+    worker->generation = generation;
+
+    // Queries after a valid one are not needed
+    for (unsigned i = worker->index; i < solvers.size() && i < firstValid;
+         i += workers.size()) {
+      worker->current = i;
+      pthread_mutex_unlock(&mutex);
+
+      ::Z3_lbool outcome = Z3_solver_check(worker->builder->ctx, solvers[i]);
+
+      pthread_mutex_lock(&mutex);
+      worker->current = solvers.size();
+      outcomes[i] = outcome;
+
+      // The query is valid when its negation is unsatisfiable, in which case
+      // we cancel the queries being solved after it.
+      if (outcome == Z3_L_FALSE && i < firstValid) {
+        firstValid = i;
+        for (std::vector<Worker *>::iterator it = workers.begin(),
+                                             ie = workers.end();
+             it != ie; ++it) {
+          if ((*it)->current > i && (*it)->current < solvers.size())
+            Z3_interrupt((*it)->builder->ctx);
+        }
+      }
+    }
+
+    ++finishedWorkers;
+    pthread_cond_signal(&workDone);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+::Z3_solver Z3ParallelSolverImpl::buildSolver(
+    Worker *worker, const ConstraintManager &constraints, ref<Expr> expr,
+    double timeout) {
+  Z3_context ctx = worker->builder->ctx;
+
+  ::Z3_solver solver;
+  if (llvm::isa<ExistsExpr>(expr)) {
+    Z3_symbol abv = Z3_mk_string_symbol(ctx, "ABV");
+    solver = Z3_mk_solver_for_logic(ctx, abv);
+  } else {
+    solver = Z3_mk_simple_solver(ctx);
+  }
+  Z3_solver_inc_ref(ctx, solver);
+
+  unsigned int timeoutInMilliSeconds = (unsigned int)((timeout * 1000) + 0.5);
+  if (timeoutInMilliSeconds == 0)
+    timeoutInMilliSeconds = UINT_MAX;
+  Z3_params_set_uint(ctx, worker->solverParameters,
+                     Z3_mk_string_symbol(ctx, "timeout"),
+                     timeoutInMilliSeconds);
+  Z3_solver_set_params(ctx, solver, worker->solverParameters);
+
+  unsigned position = 0;
+  for (ConstraintManager::const_iterator it = constraints.begin(),
+                                         ie = constraints.end();
+       it != ie; ++it) {
+    Z3_solver_assert_and_track(ctx, solver, worker->builder->construct(*it),
+                               worker->getTrackingLiteral(position++));
+  }
+
+  // As in Z3SolverImpl, the negation of the validity query is asserted
+  Z3_solver_assert(
+      ctx, solver,
+      Z3ASTHandle(Z3_mk_not(ctx, worker->builder->construct(expr)), ctx));
+  return solver;
+}
+
+unsigned Z3ParallelSolverImpl::computeFirstValid(
+    const ConstraintManager &constraints, const std::vector<ref<Expr> > &exprs,
+    double timeout, std::vector<bool> &success,
+    std::vector<ref<Expr> > &unsatCore) {
+  TimerStatIncrementer t(stats::subsumptionQueryTime);
+
+  unsigned size = exprs.size();
+  success.assign(size, false);
+  if (size == 0)
+    return 0;
+
+  // No worker is running at this point, hence the contexts are ours
+  solvers.resize(size);
+  for (unsigned i = 0; i < size; ++i) {
+    solvers[i] = buildSolver(workers[i % workers.size()], constraints,
+                             exprs[i], timeout);
+  }
+
+  pthread_mutex_lock(&mutex);
+  outcomes.assign(size, Z3_L_UNDEF);
+  firstValid = size;
+  finishedWorkers = 0;
+  for (std::vector<Worker *>::iterator it = workers.begin(),
+                                       ie = workers.end();
+       it != ie; ++it) {
+    (*it)->current = size;
+  }
+  ++generation;
+  pthread_cond_broadcast(&workReady);
+  while (finishedWorkers < workers.size())
+    pthread_cond_wait(&workDone, &mutex);
+  unsigned result = firstValid;
+  pthread_mutex_unlock(&mutex);
+
+  // All queries before the first valid one have been solved. As the queries
+  // after it may have been cancelled, they are not reported, so that the
+  // result and the statistics do not depend on the thread schedule.
+  for (unsigned i = 0; i < size && i <= result; ++i) {
+    success[i] = (outcomes[i] != Z3_L_UNDEF);
+    ++stats::subsumptionQueryCount;
+    if (i != result)
+      ++stats::subsumptionQueryFailureCount;
+  }
+
+  if (result < size) {
+    Worker *worker = workers[result % workers.size()];
+    Z3_context ctx = worker->builder->ctx;
+    Z3_ast_vector core = Z3_solver_get_unsat_core(ctx, solvers[result]);
+    Z3_ast_vector_inc_ref(ctx, core);
+    for (unsigned i = 0, n = Z3_ast_vector_size(ctx, core); i < n; ++i) {
+      Z3_ast literal = Z3_ast_vector_get(ctx, core, i);
+      unsigned position = 0;
+      for (ConstraintManager::const_iterator it = constraints.begin(),
+                                             ie = constraints.end();
+           it != ie; ++it, ++position) {
+        if (literal == (Z3_ast)worker->trackingLiterals[position]) {
+          unsatCore.push_back(*it);
+          break;
+        }
+      }
+    }
+    Z3_ast_vector_dec_ref(ctx, core);
+  }
+
+  for (unsigned i = 0; i < size; ++i) {
+    Z3_solver_dec_ref(workers[i % workers.size()]->builder->ctx, solvers[i]);
+  }
+  solvers.clear();
+  for (std::vector<Worker *>::iterator it = workers.begin(),
+                                       ie = workers.end();
+       it != ie; ++it) {
+    (*it)->builder->retireConstructCache(Z3ConstructCacheSize);
+  }
+  return result;
+}
+
+/***/
+
+Z3ParallelSolver::Z3ParallelSolver(unsigned threads)
+    : impl(new Z3ParallelSolverImpl(threads)) {}
+
+Z3ParallelSolver::~Z3ParallelSolver() { delete impl; }
+
+unsigned Z3ParallelSolver::computeFirstValid(
+    const ConstraintManager &constraints, const std::vector<ref<Expr> > &exprs,
+    double timeout, std::vector<bool> &success,
+    std::vector<ref<Expr> > &unsatCore) {
+  return impl->computeFirstValid(constraints, exprs, timeout, success,
+                                 unsatCore);
+}
+}
+#endif // ENABLE_Z3
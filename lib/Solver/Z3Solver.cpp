@@ -29,11 +29,43 @@ private:
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
 
+  /// keepConstructCache - Whether the builder's cache of Z3 ASTs is kept
+  /// across queries even with -z3-construct-cache-size=0, up to
+  /// maxKeptConstructCacheSize entries.
+  bool keepConstructCache;
+
+  static const size_t maxKeptConstructCacheSize = 65536;
+
+  /// trackingLiterals - The Boolean constant tracking the constraint at each
+  /// position of the constraint list. The constant at position i is named
+  /// i + 1, which getUnsatCoreVector relies on. As a position holds one
+  /// constraint at a time in any solver, the constants are created once and
+  /// reused across queries.
+  std::vector<Z3ASTHandle> trackingLiterals;
+
+  /// incrementalSolver - The solver kept across queries with -z3-incremental,
+  /// with one scope per asserted constraint.
+  ::Z3_solver incrementalSolver;
+
+  /// assertedConstraints - The constraints asserted in incrementalSolver, in
+  /// the order of their scopes.
+  std::vector<ref<Expr> > assertedConstraints;
+
   bool internalRunSolver(const Query &,
                          const std::vector<const Array *> *objects,
                          std::vector<std::vector<unsigned char> > *values,
                          bool &hasSolution, std::vector<ref<Expr> > &unsatCore);
 
+  Z3ASTHandle getTrackingLiteral(unsigned position);
+
+  /// getIncrementalSolver - Bring incrementalSolver to assert exactly the
+  /// query constraints. Scopes of the longest common prefix with the
+  /// previous query are kept, the rest are popped, and the remaining query
+  /// constraints are pushed.
+  ::Z3_solver getIncrementalSolver(const Query &query);
+
+  void resetIncrementalSolver();
+
   /// getUnsatCoreVector - Declare the routine to extract the unsatisfiability
   /// core vector. The resulting vector is the fourth argument.
   static void getUnsatCoreVector(const Query &query, const Z3Builder *builder,
@@ -41,7 +73,7 @@ private:
                                  std::vector<ref<Expr> > &unsatCore);
 
 public:
-  Z3SolverImpl();
+  Z3SolverImpl(bool _keepConstructCache);
   ~Z3SolverImpl();
 
   char *getConstraintLog(const Query &);
@@ -72,9 +104,10 @@ public:
   SolverRunStatus getOperationStatusCode();
 };
 
-Z3SolverImpl::Z3SolverImpl()
+Z3SolverImpl::Z3SolverImpl(bool _keepConstructCache)
     : builder(new Z3Builder(/*autoClearConstructCache=*/false)), timeout(0.0),
-      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE),
+      keepConstructCache(_keepConstructCache), incrementalSolver(NULL) {
   assert(builder && "unable to create Z3Builder");
   solverParameters = Z3_mk_params(builder->ctx);
   Z3_params_inc_ref(builder->ctx, solverParameters);
@@ -83,15 +116,76 @@ Z3SolverImpl::Z3SolverImpl()
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  resetIncrementalSolver();
+  trackingLiterals.clear();
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
 
+Z3ASTHandle Z3SolverImpl::getTrackingLiteral(unsigned position) {
+  while (trackingLiterals.size() <= position) {
+    std::ostringstream stringStream;
+    stringStream << (trackingLiterals.size() + 1);
+
+    Z3_symbol symbol =
+        Z3_mk_string_symbol(builder->ctx, stringStream.str().c_str());
+    trackingLiterals.push_back(Z3ASTHandle(
+        Z3_mk_const(builder->ctx, symbol, Z3_mk_bool_sort(builder->ctx)),
+        builder->ctx));
+  }
+  return trackingLiterals[position];
+}
+
+::Z3_solver Z3SolverImpl::getIncrementalSolver(const Query &query) {
+  if (!incrementalSolver) {
+    incrementalSolver = Z3_mk_simple_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, incrementalSolver);
+  }
+  // The timeout may have changed since the previous query
+  Z3_solver_set_params(builder->ctx, incrementalSolver, solverParameters);
+
+  ConstraintManager::const_iterator it = query.constraints.begin(),
+                                    ie = query.constraints.end();
+  unsigned common = 0;
+  while (common < assertedConstraints.size() && it != ie &&
+         *it == assertedConstraints[common]) {
+    ++common;
+    ++it;
+  }
+  stats::incrementalReusedAssertions += common;
+
+  if (common < assertedConstraints.size()) {
+    Z3_solver_pop(builder->ctx, incrementalSolver,
+                  assertedConstraints.size() - common);
+    assertedConstraints.resize(common);
+  }
+
+  for (; it != ie; ++it) {
+    Z3_solver_push(builder->ctx, incrementalSolver);
+    Z3_solver_assert_and_track(
+        builder->ctx, incrementalSolver, builder->construct(*it),
+        getTrackingLiteral(assertedConstraints.size()));
+    assertedConstraints.push_back(*it);
+    ++stats::incrementalAssertions;
+  }
+
+  return incrementalSolver;
+}
+
+void Z3SolverImpl::resetIncrementalSolver() {
+  if (incrementalSolver) {
+    Z3_solver_dec_ref(builder->ctx, incrementalSolver);
+    incrementalSolver = NULL;
+  }
+  assertedConstraints.clear();
+}
+
 /**/
 
 bool Z3Solver::subsumptionCheck = false;
 
-Z3Solver::Z3Solver() : Solver(new Z3SolverImpl()) {}
+Z3Solver::Z3Solver(bool keepConstructCache)
+    : Solver(new Z3SolverImpl(keepConstructCache)) {}
 
 char *Z3Solver::getConstraintLog(const Query &query) {
   return impl->getConstraintLog(query);
@@ -111,8 +205,8 @@ bool Z3Solver::directComputeValidity(const Query &query,
 
 char *Z3SolverImpl::getConstraintLog(const Query &query) {
   std::vector<Z3ASTHandle> assumptions;
-  for (std::vector<ref<Expr> >::const_iterator it = query.constraints.begin(),
-                                               ie = query.constraints.end();
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                         ie = query.constraints.end();
        it != ie; ++it) {
     assumptions.push_back(builder->construct(*it));
   }
@@ -203,41 +297,43 @@ bool Z3SolverImpl::internalRunSolver(
     return result;
   }
   TimerStatIncrementer t(stats::queryTime);
-  // TODO: Does making a new solver for each query have a performance
-  // impact vs making one global solver and using push and pop?
   // TODO: is the "simple_solver" the right solver to use for
   // best performance?
-  Z3_solver theSolver = Z3_mk_simple_solver(builder->ctx);
-  if (INTERPOLATION_ENABLED) {
-    if (llvm::isa<ExistsExpr>(query.expr) ||
-        (llvm::isa<EqExpr>(query.expr) &&
-         llvm::isa<ExistsExpr>(query.expr->getKid(1)))) {
-      Z3_symbol abv = Z3_mk_string_symbol(builder->ctx, "ABV");
-      theSolver = Z3_mk_solver_for_logic(builder->ctx, abv);
-    }
-  }
-  Z3_solver_inc_ref(builder->ctx, theSolver);
-  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+  bool existential =
+      INTERPOLATION_ENABLED &&
+      (llvm::isa<ExistsExpr>(query.expr) ||
+       (llvm::isa<EqExpr>(query.expr) &&
+        llvm::isa<ExistsExpr>(query.expr->getKid(1))));
+  // Existentially-quantified queries need their own solver for the ABV logic
+  bool incremental = Z3Incremental && !existential;
 
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
 
-  Z3_sort sort = Z3_mk_bool_sort(builder->ctx);
-  unsigned constraintIdCtr = 1;
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
-       it != ie; ++it) {
-    std::ostringstream stringStream;
-    stringStream << constraintIdCtr;
+  Z3_solver theSolver;
+  if (incremental) {
+    theSolver = getIncrementalSolver(query);
+    Z3_solver_inc_ref(builder->ctx, theSolver);
 
-    Z3_symbol symbol =
-        Z3_mk_string_symbol(builder->ctx, stringStream.str().c_str());
-    Z3ASTHandle constraintId(Z3_mk_const(builder->ctx, symbol, sort),
-                             builder->ctx);
-
-    Z3_solver_assert_and_track(builder->ctx, theSolver, builder->construct(*it),
-                               constraintId);
+    // The query expression is asserted in its own scope, popped below
+    Z3_solver_push(builder->ctx, theSolver);
+  } else {
+    if (existential) {
+      Z3_symbol abv = Z3_mk_string_symbol(builder->ctx, "ABV");
+      theSolver = Z3_mk_solver_for_logic(builder->ctx, abv);
+    } else {
+      theSolver = Z3_mk_simple_solver(builder->ctx);
+    }
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+    Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
 
-    constraintIdCtr++;
+    unsigned position = 0;
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                           ie = query.constraints.end();
+         it != ie; ++it) {
+      Z3_solver_assert_and_track(builder->ctx, theSolver,
+                                 builder->construct(*it),
+                                 getTrackingLiteral(position++));
+    }
   }
   ++stats::queries;
   if (objects)
@@ -263,13 +359,29 @@ bool Z3SolverImpl::internalRunSolver(
     getUnsatCoreVector(query, builder, theSolver, unsatCore);
   }
 
+  if (incremental) {
+    Z3_solver_pop(builder->ctx, theSolver, 1);
+  }
   Z3_solver_dec_ref(builder->ctx, theSolver);
-  // Clear the builder's cache to prevent memory usage exploding.
-  // By using ``autoClearConstructCache=false`` and clearning now
+
+  // Do not keep a solver whose state may be unreliable after a failure
+  if (incremental &&
+      runStatusCode != SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE &&
+      runStatusCode != SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
+    resetIncrementalSolver();
+  }
+  // Bound the builder's cache to prevent memory usage exploding.
+  // By using ``autoClearConstructCache=false`` and retiring now
   // we allow Z3_ast expressions to be shared from an entire
   // ``Query`` rather than only sharing within a single call to
-  // ``builder->construct()``.
-  builder->clearConstructCache();
+  // ``builder->construct()``. The expressions still in use, such as the
+  // path-condition prefix shared by consecutive queries or the interpolant
+  // of a subsumption table entry, are also shared with the following
+  // queries.
+  size_t maxConstructCacheSize = Z3ConstructCacheSize;
+  if (keepConstructCache && maxConstructCacheSize == 0)
+    maxConstructCacheSize = maxKeptConstructCacheSize;
+  builder->retireConstructCache(maxConstructCacheSize);
 
   if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
       runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
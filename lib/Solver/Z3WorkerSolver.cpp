@@ -0,0 +1,461 @@
+//===-- Z3WorkerSolver.cpp --------------------------------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementation of the Z3 core solver running in a
+/// pool of worker processes, so that a crash or a runaway memory use of Z3
+/// only costs the query.
+///
+/// A query is sent to a worker as KQuery text, parsed by the worker into its
+/// own expressions, and solved with the Z3 context of the worker, created
+/// when the worker is forked and kept across queries. The reply carries the
+/// model or the unsatisfiability core, see SolverReply.
+///
+//===----------------------------------------------------------------------===//
+#include "klee/Config/config.h"
+#ifdef ENABLE_Z3
+#include "SolverProcess.h"
+
+#include "expr/Parser.h"
+#include "klee/CommandLine.h"
+#include "klee/Config/Version.h"
+#include "klee/Constraints.h"
+#include "klee/ExprBuilder.h"
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/TimerStatIncrementer.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/util/ExprPPrinter.h"
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
+#include <memory>
+#else
+#include "llvm/ADT/OwningPtr.h"
+#endif
+
+#include <errno.h>
+#include <fstream>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace klee {
+
+class Z3WorkerSolverImpl : public SolverImpl {
+  /// Worker - A process solving queries, with pid -1 when not running
+  struct Worker {
+    pid_t pid;
+    int fd;
+
+    Worker() : pid(-1), fd(-1) {}
+  };
+
+  std::vector<Worker> workers;
+
+  /// nextWorker - The index of the worker of the next query
+  unsigned nextWorker;
+
+  unsigned memoryLimitMB;
+
+  double timeout;
+
+  SolverRunStatus runStatusCode;
+
+  /// local - The solver in KLEE's process, for the queries that cannot be
+  /// written as KQuery, created on first use
+  Solver *local;
+
+  /// A worker is killed when it has not replied this many seconds after the
+  /// timeout, which Z3 enforces by itself
+  static const double killDelay;
+
+  Solver *getLocalSolver();
+
+  bool spawn(Worker &worker);
+
+  void stop(Worker &worker, bool kill);
+
+  /// serve - Solve the queries received on the socket until it is closed,
+  /// in the worker process.
+  static void serve(int fd, unsigned memoryLimitMB);
+
+  /// solveRequest - Solve a query received from KLEE, in the worker process.
+  static void solveRequest(Solver *solver, const std::string &request,
+                           SolverReply &reply);
+
+  /// run - Solve the query with a worker. The reply is empty if the worker
+  /// could not read the query.
+  bool run(const Query &query, SolverReply::Operation operation,
+           const std::vector<const Array *> *objects, SolverReply &reply);
+
+  bool solve(const Query &query, SolverReply::Operation operation,
+             const std::vector<const Array *> *objects, SolverReply &reply);
+
+public:
+  Z3WorkerSolverImpl(unsigned workerCount, unsigned _memoryLimitMB);
+  ~Z3WorkerSolverImpl();
+
+  bool computeTruth(const Query &, bool &isValid,
+                    std::vector<ref<Expr> > &unsatCore);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution,
+                            std::vector<ref<Expr> > &unsatCore);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(double _timeout);
+};
+
+const double Z3WorkerSolverImpl::killDelay = 1.0;
+
+Z3WorkerSolverImpl::Z3WorkerSolverImpl(unsigned workerCount,
+                                       unsigned _memoryLimitMB)
+    : workers(workerCount), nextWorker(0), memoryLimitMB(_memoryLimitMB),
+      timeout(0.0),
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE), local(0) {
+  assert(workerCount > 0 && "no worker processes");
+  for (std::vector<Worker>::iterator it = workers.begin(),
+                                     ie = workers.end();
+       it != ie; ++it)
+    spawn(*it);
+}
+
+Z3WorkerSolverImpl::~Z3WorkerSolverImpl() {
+  for (std::vector<Worker>::iterator it = workers.begin(),
+                                     ie = workers.end();
+       it != ie; ++it)
+    stop(*it, false);
+  delete local;
+}
+
+Solver *Z3WorkerSolverImpl::getLocalSolver() {
+  if (!local) {
+    local = new Z3Solver();
+    local->setCoreSolverTimeout(timeout);
+  }
+  return local;
+}
+
+bool Z3WorkerSolverImpl::spawn(Worker &worker) {
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == -1) {
+    klee_warning("socketpair failed (for Z3 worker)");
+    return false;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for Z3 worker)");
+    close(sockets[0]);
+    close(sockets[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    for (std::vector<Worker>::iterator it = workers.begin(),
+                                       ie = workers.end();
+         it != ie; ++it) {
+      if (it->fd != -1)
+        close(it->fd);
+    }
+    close(sockets[0]);
+    serve(sockets[1], memoryLimitMB);
+  }
+
+  close(sockets[1]);
+  worker.pid = pid;
+  worker.fd = sockets[0];
+  return true;
+}
+
+void Z3WorkerSolverImpl::stop(Worker &worker, bool kill) {
+  if (worker.pid == -1)
+    return;
+
+  // An idle worker exits when its socket is closed
+  if (kill)
+    ::kill(worker.pid, SIGKILL);
+  close(worker.fd);
+  int status;
+  while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR)
+    ;
+  worker.pid = -1;
+  worker.fd = -1;
+}
+
+void Z3WorkerSolverImpl::serve(int fd, unsigned memoryLimitMB) {
+  if (memoryLimitMB) {
+    // The limit is on top of the address space inherited from KLEE
+    rlim_t size = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> size;
+    struct rlimit limit;
+    limit.rlim_cur = limit.rlim_max =
+        size * sysconf(_SC_PAGESIZE) + ((rlim_t)memoryLimitMB << 20);
+    setrlimit(RLIMIT_AS, &limit);
+  }
+
+  // The expressions of a query are deleted after it is solved, hence Z3
+  // must not keep them across queries
+  Z3Incremental = false;
+  Solver *solver = new Z3Solver();
+
+  std::string request;
+  while (receiveMessage(fd, request)) {
+    SolverReply reply;
+    solveRequest(solver, request, reply);
+    if (!sendMessage(fd, reply.getData()))
+      break;
+  }
+  _exit(0);
+}
+
+void Z3WorkerSolverImpl::solveRequest(Solver *solver,
+                                      const std::string &request,
+                                      SolverReply &reply) {
+  // A request is the operation, the timeout and the KQuery text
+  uint64_t operation;
+  double timeout;
+  if (request.size() < sizeof(operation) + sizeof(timeout))
+    return;
+  request.copy(reinterpret_cast<char *>(&operation), sizeof(operation));
+  request.copy(reinterpret_cast<char *>(&timeout), sizeof(timeout),
+               sizeof(operation));
+  std::string text = request.substr(sizeof(operation) + sizeof(timeout));
+  solver->setCoreSolverTimeout(timeout);
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
+  std::unique_ptr<llvm::MemoryBuffer> buffer(
+      llvm::MemoryBuffer::getMemBuffer(text));
+#else
+  llvm::OwningPtr<llvm::MemoryBuffer> buffer(
+      llvm::MemoryBuffer::getMemBuffer(text));
+#endif
+  ExprBuilder *builder = createDefaultExprBuilder();
+  expr::Parser *parser =
+      expr::Parser::Create("query", buffer.get(), builder, false);
+
+  // The declarations are deleted last, as the parser refers to the array
+  // declarations
+  std::vector<expr::Decl *> decls;
+  expr::QueryCommand *command = 0;
+  while (expr::Decl *decl = parser->ParseTopLevelDecl()) {
+    if (expr::QueryCommand *qc = llvm::dyn_cast<expr::QueryCommand>(decl))
+      command = qc;
+    decls.push_back(decl);
+  }
+
+  if (command && !parser->GetNumErrors()) {
+    ConstraintManager constraints(command->Constraints);
+    if (operation == SolverReply::Value && command->Values.size() == 1) {
+      reply.solve(solver, Query(constraints, command->Values.front()),
+                  SolverReply::Value, 0);
+    } else if (operation == SolverReply::Truth ||
+               operation == SolverReply::InitialValues) {
+      reply.solve(solver, Query(constraints, command->Query),
+                  (SolverReply::Operation)operation, &command->Objects);
+    }
+  }
+
+  for (std::vector<expr::Decl *>::iterator it = decls.begin(),
+                                           ie = decls.end();
+       it != ie; ++it)
+    delete *it;
+  delete parser;
+  delete builder;
+}
+
+bool Z3WorkerSolverImpl::run(const Query &query,
+                             SolverReply::Operation operation,
+                             const std::vector<const Array *> *objects,
+                             SolverReply &reply) {
+  uint64_t code = operation;
+  std::string request(reinterpret_cast<const char *>(&code), sizeof(code));
+  request.append(reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+  llvm::raw_string_ostream os(request);
+  // KQuery queries are Boolean, hence the expression of a value is written
+  // as an expression to evaluate
+  const Array *const *arrays =
+      objects && !objects->empty() ? &(*objects)[0] : 0;
+  if (operation == SolverReply::Value)
+    ExprPPrinter::printQuery(os, query.constraints,
+                             ConstantExpr::alloc(0, Expr::Bool), &query.expr,
+                             &query.expr + 1);
+  else
+    ExprPPrinter::printQuery(os, query.constraints, query.expr, 0, 0, arrays,
+                             arrays ? arrays + objects->size() : 0);
+  os.flush();
+
+  // The queries go to the workers in turn, so that the memory grown by the
+  // Z3 context of a worker is spread over the workers. The executor solves
+  // one query at a time, and a worker not replying is killed, hence the
+  // worker is idle here. A worker whose restart failed is started again.
+  Worker *worker = &workers[nextWorker];
+  nextWorker = (nextWorker + 1) % workers.size();
+  if (worker->pid == -1 && !spawn(*worker)) {
+    runStatusCode = SOLVER_RUN_STATUS_FORK_FAILED;
+    return false;
+  }
+
+  bool received = false;
+  if (sendMessage(worker->fd, request)) {
+    struct pollfd p;
+    p.fd = worker->fd;
+    p.events = POLLIN;
+    p.revents = 0;
+    double deadline = util::getWallTime() + timeout + killDelay;
+    int n;
+    do {
+      int milliseconds = -1;
+      if (timeout)
+        milliseconds =
+            std::max(0, (int)((deadline - util::getWallTime()) * 1000));
+      n = poll(&p, 1, milliseconds);
+    } while (n < 0 && errno == EINTR);
+
+    if (n == 0) {
+      klee_warning("Z3 worker did not reply in time, restarted");
+      stop(*worker, true);
+      spawn(*worker);
+      runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+      return false;
+    }
+    received = n > 0 && receiveMessage(worker->fd, reply.getData());
+  }
+
+  if (!received) {
+    klee_warning("Z3 worker terminated, e.g., by exceeding its memory limit, "
+                 "restarted");
+    stop(*worker, true);
+    spawn(*worker);
+    runStatusCode = SOLVER_RUN_STATUS_INTERRUPTED;
+    return false;
+  }
+  return true;
+}
+
+bool Z3WorkerSolverImpl::solve(const Query &query,
+                               SolverReply::Operation operation,
+                               const std::vector<const Array *> *objects,
+                               SolverReply &reply) {
+  // The queries of subsumption checks are counted as by Z3SolverImpl
+  bool subsumptionCheck = Z3Solver::subsumptionCheck;
+  TimerStatIncrementer t(subsumptionCheck ? stats::subsumptionQueryTime
+                                          : stats::queryTime);
+  if (subsumptionCheck)
+    ++stats::subsumptionQueryCount;
+  ++stats::queries;
+  if (operation != SolverReply::Truth)
+    ++stats::queryCounterexamples;
+
+  if (!run(query, operation, objects, reply)) {
+    if (subsumptionCheck)
+      ++stats::subsumptionQueryFailureCount;
+    return false;
+  }
+
+  // The queries the worker could not parse, e.g., with array names that are
+  // not KQuery identifiers, are solved in KLEE's process
+  if (reply.getData().empty())
+    reply.solve(getLocalSolver(), query, operation, objects);
+
+  bool unsat;
+  bool success = reply.isSuccess(unsat);
+  if (subsumptionCheck && (!success || !unsat))
+    ++stats::subsumptionQueryFailureCount;
+  if (!success) {
+    runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+    return false;
+  }
+  runStatusCode = unsat ? SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE
+                        : SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  return true;
+}
+
+bool Z3WorkerSolverImpl::computeTruth(const Query &query, bool &isValid,
+                                      std::vector<ref<Expr> > &unsatCore) {
+  // Existentially-quantified expressions cannot be written as KQuery
+  if (isExistentialQuery(query)) {
+    Solver *solver = getLocalSolver();
+    bool success = solver->impl->computeTruth(query, isValid, unsatCore);
+    runStatusCode = solver->impl->getOperationStatusCode();
+    return success;
+  }
+
+  SolverReply reply;
+  return solve(query, SolverReply::Truth, 0, reply) &&
+         reply.getTruth(query, isValid, unsatCore);
+}
+
+bool Z3WorkerSolverImpl::computeValue(const Query &query, ref<Expr> &result) {
+  SolverReply reply;
+  return solve(query, SolverReply::Value, 0, reply) && reply.getValue(result);
+}
+
+bool Z3WorkerSolverImpl::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution,
+    std::vector<ref<Expr> > &unsatCore) {
+  if (isExistentialQuery(query)) {
+    Solver *solver = getLocalSolver();
+    bool success = solver->impl->computeInitialValues(
+        query, objects, values, hasSolution, unsatCore);
+    runStatusCode = solver->impl->getOperationStatusCode();
+    return success;
+  }
+
+  SolverReply reply;
+  return solve(query, SolverReply::InitialValues, &objects, reply) &&
+         reply.getInitialValues(query, objects, values, hasSolution,
+                                unsatCore);
+}
+
+SolverImpl::SolverRunStatus Z3WorkerSolverImpl::getOperationStatusCode() {
+  return runStatusCode;
+}
+
+char *Z3WorkerSolverImpl::getConstraintLog(const Query &query) {
+  return getLocalSolver()->getConstraintLog(query);
+}
+
+void Z3WorkerSolverImpl::setCoreSolverTimeout(double _timeout) {
+  timeout = _timeout;
+  if (local)
+    local->setCoreSolverTimeout(_timeout);
+}
+
+/***/
+
+Z3WorkerSolver::Z3WorkerSolver(unsigned workers, unsigned memoryLimitMB)
+    : Solver(new Z3WorkerSolverImpl(workers, memoryLimitMB)) {}
+
+char *Z3WorkerSolver::getConstraintLog(const Query &query) {
+  return impl->getConstraintLog(query);
+}
+
+void Z3WorkerSolver::setCoreSolverTimeout(double timeout) {
+  impl->setCoreSolverTimeout(timeout);
+}
+}
+#endif // ENABLE_Z3
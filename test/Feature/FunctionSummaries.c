@@ -0,0 +1,35 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -search=dfs -function-summaries %t1.bc 2>&1 | FileCheck %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -search=dfs %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-OFF %s
+// REQUIRES: z3
+
+// CHECK: KLEE: done:     Function summary checks from other call histories (successful) = {{[1-9][0-9]*}} ({{[1-9][0-9]*}})
+// CHECK-OFF: KLEE: done:     Function summary checks from other call histories (successful) = 0 (0)
+
+#include <klee/klee.h>
+#include <stdlib.h>
+
+// Every path ends within the function, and the branch on the local variable
+// puts its frame-local cell in the interpolant stores
+static void finish(int x) {
+  int local = x;
+
+  if (x > 0) {
+    if (local > 10)
+      exit(2);
+    exit(1);
+  }
+  exit(0);
+}
+
+int main() {
+  int a = klee_int("a");
+
+  if (klee_int("b") > 0)
+    finish(a);
+  finish(a);
+
+  return 0;
+}
@@ -0,0 +1,41 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.table
+// RUN: %klee --output-dir=%t.klee-out -store-relevance-analysis -write-subsumption-table=%t.table %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-WRITE %s
+// RUN: rm -rf %t.klee-out
+// RUN: cp %t1.bc %t2.bc
+// RUN: %klee --output-dir=%t.klee-out -store-relevance-analysis -read-subsumption-table=%t.table -output-tree %t2.bc 2>&1 | FileCheck --check-prefix=CHECK-READ %s
+// RUN: test -f %t.klee-out/tree.dot
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out -store-relevance-analysis -no-existential -read-subsumption-table=%t.table %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-OPTIONS %s
+// REQUIRES: z3
+
+// CHECK-WRITE: KLEE: done:     Table entries saved to file = {{[1-9][0-9]*}}
+// CHECK-READ: KLEE: done:     Table entries loaded from file = {{[1-9][0-9]*}}
+// CHECK-READ: KLEE: done:     Subsumptions by table entries loaded from file = {{[1-9][0-9]*}}
+// CHECK-OPTIONS: ignoring subsumption table file {{.*}} written for another module or other interpolation options
+// CHECK-OPTIONS: KLEE: done:     Table entries loaded from file = 0
+
+#include <klee/klee.h>
+
+// The symbolic value of the global is in the interpolant stores
+static int total;
+
+static int check(int x) {
+  if (x > 0)
+    return 1;
+  return 0;
+}
+
+int main() {
+  int count = 0;
+
+  total = klee_int("t");
+  if (klee_int("a") > 0)
+    count += check(1);
+  if (klee_int("b") > 0)
+    count += check(2);
+  if (klee_int("c") > 0)
+    count += check(3);
+
+  return count > 3 || total > 0;
+}
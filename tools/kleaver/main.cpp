@@ -214,7 +214,10 @@ static bool EvaluateInputAST(const char *Filename,
   if (!success)
     return false;
 
-  Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
+  Solver *coreSolver =
+      SolverPortfolio.empty()
+          ? klee::createCoreSolver(CoreSolverToUse)
+          : klee::createPortfolioSolver(CoreSolverToUse, SolverPortfolio);
 
   if (CoreSolverToUse != DUMMY_SOLVER) {
     if (0 != MaxCoreSolverTime) {
@@ -13,6 +13,7 @@
 #include "klee/ExecutionState.h"
 #include "klee/Expr.h"
 #include "klee/Interpreter.h"
+#include "klee/SolverStats.h"
 #include "klee/Statistics.h"
 #include "klee/Config/Version.h"
 #include "klee/Internal/ADT/KTest.h"
@@ -1688,6 +1689,34 @@ int main(int argc, char **argv, char **envp) {
     << "KLEE: done: valid queries = " << queriesValid << "\n"
     << "KLEE: done: invalid queries = " << queriesInvalid << "\n"
     << "KLEE: done: query cex = " << queryCounterexamples << "\n";
+  if (!SolverPortfolio.empty()) {
+    handler->getInfoStream()
+        << "KLEE: done: portfolio wins (stp, metasmt, z3) = "
+        << *theStatisticManager->getStatisticByName("PortfolioSTPWins")
+        << ", "
+        << *theStatisticManager->getStatisticByName("PortfolioMetaSMTWins")
+        << ", " << *theStatisticManager->getStatisticByName("PortfolioZ3Wins")
+        << "\n"
+        << "KLEE: done: portfolio races = "
+        << *theStatisticManager->getStatisticByName("PortfolioRaces") << "\n";
+  }
+  uint64_t z3ConstructCacheHits =
+      *theStatisticManager->getStatisticByName("Z3ConstructCacheHits");
+  uint64_t z3ConstructCacheMisses =
+      *theStatisticManager->getStatisticByName("Z3ConstructCacheMisses");
+  if (z3ConstructCacheHits + z3ConstructCacheMisses) {
+    handler->getInfoStream()
+        << "KLEE: done: z3 construct cache hit rate = "
+        << (100 * z3ConstructCacheHits) /
+               (z3ConstructCacheHits + z3ConstructCacheMisses)
+        << "% (" << z3ConstructCacheHits << " hits, "
+        << z3ConstructCacheMisses << " misses)\n"
+        << "KLEE: done: z3 construct cache size = "
+        << stats::z3ConstructCacheSize << " (peak "
+        << stats::z3ConstructCachePeakSize << ", "
+        << *theStatisticManager->getStatisticByName(
+               "Z3ConstructCacheEvictions") << " evictions)\n";
+  }
 
   std::stringstream stats;
   if (INTERPOLATION_ENABLED) {
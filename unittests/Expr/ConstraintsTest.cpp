@@ -0,0 +1,535 @@
+//===-- ConstraintsTest.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/util/ArrayCache.h"
+#include "klee/util/ExprVisitor.h"
+#include "klee/util/IndependentElementSet.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+const unsigned numArrays = 4;
+const unsigned arraySize = 8;
+
+/// The independent slice of the constraints computed by the fixpoint of the
+/// old IndependentSolver, in the order in which it was found.
+void getFixpointSlice(const std::vector<ref<Expr> > &constraints,
+                      ref<Expr> e, std::vector<ref<Expr> > &result) {
+  IndependentElementSet eltsClosure(e);
+  std::vector<std::pair<ref<Expr>, IndependentElementSet> > worklist;
+  for (std::vector<ref<Expr> >::const_iterator it = constraints.begin(),
+                                               ie = constraints.end();
+       it != ie; ++it)
+    worklist.push_back(std::make_pair(*it, IndependentElementSet(*it)));
+
+  bool done = false;
+  do {
+    done = true;
+    std::vector<std::pair<ref<Expr>, IndependentElementSet> > newWorklist;
+    for (std::vector<std::pair<ref<Expr>, IndependentElementSet> >::iterator
+             it = worklist.begin(),
+             ie = worklist.end();
+         it != ie; ++it) {
+      if (it->second.intersects(eltsClosure)) {
+        if (eltsClosure.add(it->second))
+          done = false;
+        result.push_back(it->first);
+      } else {
+        newWorklist.push_back(*it);
+      }
+    }
+    worklist.swap(newWorklist);
+  } while (!done);
+}
+
+/// Generates constraints over a few arrays. The element 0 of each array is
+/// only constrained by equalities with constants, at most once, so that
+/// -rewrite-equalities rewrites the other constraints without making any of
+/// them constant. The other constraints read at least one other element,
+/// possibly at a symbolic index.
+class ConstraintGenerator {
+  std::vector<const Array *> arrays;
+
+  std::set<unsigned> fixedArrays;
+
+  ref<Expr> read(unsigned array, ref<Expr> index) {
+    return ReadExpr::create(UpdateList(arrays[array], 0), index);
+  }
+
+  ref<Expr> readElement(unsigned array, unsigned index) {
+    return read(array, ConstantExpr::alloc(index, Expr::Int32));
+  }
+
+  ref<Expr> readFree() {
+    unsigned array = std::rand() % numArrays;
+    if (std::rand() % 8 == 0) {
+      // A symbolic index makes the whole array part of the factor
+      ref<Expr> index = ZExtExpr::create(
+          readElement(std::rand() % numArrays, 1 + std::rand() % 2),
+          Expr::Int32);
+      return read(array,
+                  URemExpr::create(index, ConstantExpr::alloc(arraySize,
+                                                              Expr::Int32)));
+    }
+    return readElement(array, 1 + std::rand() % (arraySize - 1));
+  }
+
+  ref<Expr> readAny() {
+    if (std::rand() % 3 == 0)
+      return readElement(std::rand() % numArrays, 0);
+    return readFree();
+  }
+
+public:
+  ConstraintGenerator(ArrayCache &ac) {
+    const char *names[numArrays] = { "a", "b", "c", "d" };
+    for (unsigned i = 0; i < numArrays; ++i)
+      arrays.push_back(ac.CreateArray(names[i], arraySize));
+  }
+
+  ref<Expr> constraint() {
+    unsigned array = std::rand() % numArrays;
+    if (std::rand() % 6 == 0 && fixedArrays.insert(array).second)
+      return EqExpr::create(ConstantExpr::alloc(std::rand() % 256, Expr::Int8),
+                            readElement(array, 0));
+
+    ref<Expr> left = readFree();
+    ref<Expr> right = AddExpr::create(
+        readAny(), ConstantExpr::alloc(1 + std::rand() % 4, Expr::Int8));
+    switch (std::rand() % 3) {
+    case 0:
+      return UltExpr::create(left, right);
+    case 1:
+      return NeExpr::create(left, right);
+    default:
+      return OrExpr::create(UleExpr::create(left, right),
+                            EqExpr::create(readAny(), readFree()));
+    }
+  }
+
+  ref<Expr> query() {
+    if (std::rand() % 2)
+      return EqExpr::create(readAny(), readAny());
+    return UltExpr::create(readAny(), ConstantExpr::alloc(100, Expr::Int8));
+  }
+
+  /// An equality fixing the element 0 of an array not fixed yet, or null if
+  /// all the arrays are fixed
+  ref<Expr> equality() {
+    for (unsigned array = 0; array < numArrays; ++array) {
+      if (fixedArrays.insert(array).second)
+        return EqExpr::create(
+            ConstantExpr::alloc(std::rand() % 256, Expr::Int8),
+            readElement(array, 0));
+    }
+    return ref<Expr>();
+  }
+
+  void clear() { fixedArrays.clear(); }
+};
+
+/// The constraint set kept in a vector, as by ConstraintManager before its
+/// constraints were shared, with the rewriting of the constraints on the
+/// addition of an equality with a constant.
+class VectorConstraints {
+  class ReplaceVisitor : public ExprVisitor {
+    ref<Expr> src, dst;
+
+  public:
+    ReplaceVisitor(ref<Expr> _src, ref<Expr> _dst) : src(_src), dst(_dst) {}
+
+    Action visitExpr(const Expr &e) {
+      if (e == *src.get())
+        return Action::changeTo(dst);
+      return Action::doChildren();
+    }
+
+    Action visitExprPost(const Expr &e) {
+      if (e == *src.get())
+        return Action::changeTo(dst);
+      return Action::doChildren();
+    }
+  };
+
+  class EqualitiesVisitor : public ExprVisitor {
+    const std::map<ref<Expr>, ref<Expr> > &equalities;
+
+  public:
+    EqualitiesVisitor(const std::map<ref<Expr>, ref<Expr> > &_equalities)
+        : ExprVisitor(true), equalities(_equalities) {}
+
+    Action visitExprPost(const Expr &e) {
+      std::map<ref<Expr>, ref<Expr> >::const_iterator it =
+          equalities.find(ref<Expr>(const_cast<Expr *>(&e)));
+      if (it != equalities.end())
+        return Action::changeTo(it->second);
+      return Action::doChildren();
+    }
+  };
+
+  void rewriteConstraints(ExprVisitor &visitor) {
+    std::vector<ref<Expr> > old;
+    constraints.swap(old);
+    for (std::vector<ref<Expr> >::iterator it = old.begin(), ie = old.end();
+         it != ie; ++it) {
+      ref<Expr> e = visitor.visit(*it);
+      if (e != *it)
+        addConstraintInternal(e);
+      else
+        constraints.push_back(*it);
+    }
+  }
+
+  void addConstraintInternal(ref<Expr> e) {
+    switch (e->getKind()) {
+    case Expr::Constant:
+      break;
+    case Expr::And: {
+      BinaryExpr *be = cast<BinaryExpr>(e);
+      addConstraintInternal(be->left);
+      addConstraintInternal(be->right);
+      break;
+    }
+    case Expr::Eq: {
+      BinaryExpr *be = cast<BinaryExpr>(e);
+      if (isa<ConstantExpr>(be->left)) {
+        ReplaceVisitor visitor(be->right, be->left);
+        rewriteConstraints(visitor);
+      }
+      constraints.push_back(e);
+      break;
+    }
+    default:
+      constraints.push_back(e);
+      break;
+    }
+  }
+
+public:
+  std::vector<ref<Expr> > constraints;
+
+  ref<Expr> simplifyExpr(ref<Expr> e) const {
+    if (isa<ConstantExpr>(e))
+      return e;
+
+    std::map<ref<Expr>, ref<Expr> > equalities;
+    for (std::vector<ref<Expr> >::const_iterator it = constraints.begin(),
+                                                 ie = constraints.end();
+         it != ie; ++it) {
+      const EqExpr *ee = dyn_cast<EqExpr>(*it);
+      if (ee && isa<ConstantExpr>(ee->left))
+        equalities[ee->right] = ee->left;
+      else
+        equalities[*it] = ConstantExpr::alloc(1, Expr::Bool);
+    }
+
+    EqualitiesVisitor visitor(equalities);
+    return visitor.visit(e);
+  }
+
+  void addConstraint(ref<Expr> e) { addConstraintInternal(simplifyExpr(e)); }
+};
+
+/// Checks the slice of the constraint manager for a query against the old
+/// fixpoint, and that it is in the order of the constraint set.
+void checkSlice(const ConstraintManager &cm, ref<Expr> query) {
+  const std::vector<ref<Expr> > constraints(cm.begin(), cm.end());
+
+  std::vector<ref<Expr> > expected;
+  getFixpointSlice(constraints, query, expected);
+
+  std::vector<ref<Expr> > actual;
+  cm.getIndependentConstraints(query, actual);
+
+  std::multiset<ref<Expr> > expectedSet(expected.begin(), expected.end());
+  std::multiset<ref<Expr> > actualSet(actual.begin(), actual.end());
+  EXPECT_TRUE(expectedSet == actualSet);
+
+  std::vector<ref<Expr> >::const_iterator position = constraints.begin();
+  for (std::vector<ref<Expr> >::iterator it = actual.begin(),
+                                         ie = actual.end();
+       it != ie; ++it) {
+    position = std::find(position, constraints.end(), *it);
+    ASSERT_TRUE(position != constraints.end()) << "slice out of order";
+    ++position;
+  }
+}
+
+TEST(ConstraintsTest, IndependentConstraintsMatchFixpoint) {
+  std::srand(1);
+  ArrayCache ac;
+  ConstraintGenerator generator(ac);
+
+  for (unsigned round = 0; round < 50; ++round) {
+    generator.clear();
+    ConstraintManager cm;
+    std::vector<ConstraintManager> copies;
+
+    for (unsigned i = 0; i < 40; ++i) {
+      cm.addConstraint(generator.constraint());
+
+      // The factors are computed on a first query, then maintained
+      if (std::rand() % 4 == 0)
+        checkSlice(cm, generator.query());
+
+      // Copies share the factors, and are extended apart from the original
+      if (std::rand() % 8 == 0)
+        copies.push_back(cm);
+    }
+    checkSlice(cm, generator.query());
+
+    for (std::vector<ConstraintManager>::iterator it = copies.begin(),
+                                                  ie = copies.end();
+         it != ie; ++it) {
+      checkSlice(*it, generator.query());
+      it->addConstraint(generator.constraint());
+      checkSlice(*it, generator.query());
+    }
+    checkSlice(cm, generator.query());
+  }
+}
+
+TEST(ConstraintsTest, RewriteLeavesCopy) {
+  std::srand(2);
+  ArrayCache ac;
+  ConstraintGenerator generator(ac);
+  unsigned rewritten = 0;
+
+  for (unsigned round = 0; round < 50; ++round) {
+    generator.clear();
+    ConstraintManager cm;
+    VectorConstraints reference;
+    for (unsigned i = 0; i < 20; ++i) {
+      ref<Expr> constraint = generator.constraint();
+      cm.addConstraint(constraint);
+      reference.addConstraint(constraint);
+    }
+    ASSERT_TRUE(reference.constraints ==
+                std::vector<ref<Expr> >(cm.begin(), cm.end()));
+
+    // The copy shares the constraints and the factors of the original
+    std::vector<ref<Expr> > queries;
+    std::vector<ref<Expr> > simplified;
+    for (unsigned i = 0; i < 8; ++i) {
+      queries.push_back(generator.query());
+      simplified.push_back(cm.simplifyExpr(queries.back()));
+      checkSlice(cm, queries.back());
+    }
+    std::vector<ref<Expr> > original(cm.begin(), cm.end());
+    ConstraintManager copy(cm);
+
+    ref<Expr> equality = generator.equality();
+    if (equality.isNull())
+      continue;
+    copy.addConstraint(equality);
+    reference.addConstraint(equality);
+    if (copy.size() != original.size() + 1 ||
+        !std::equal(original.begin(), original.end(), copy.begin()))
+      ++rewritten;
+
+    // The rewriting of the copy leaves the original unchanged
+    EXPECT_TRUE(original == std::vector<ref<Expr> >(cm.begin(), cm.end()));
+    for (unsigned i = 0; i < queries.size(); ++i) {
+      EXPECT_EQ(simplified[i], cm.simplifyExpr(queries[i]));
+      checkSlice(cm, queries[i]);
+    }
+
+    // The rewritten copy matches the vector implementation
+    EXPECT_TRUE(reference.constraints ==
+                std::vector<ref<Expr> >(copy.begin(), copy.end()));
+    for (unsigned i = 0; i < queries.size(); ++i) {
+      EXPECT_EQ(reference.simplifyExpr(queries[i]),
+                copy.simplifyExpr(queries[i]));
+      checkSlice(copy, queries[i]);
+    }
+  }
+  EXPECT_LT(0u, rewritten);
+}
+
+TEST(ConstraintsTest, RewriteKeepsSharedPrefix) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 1);
+  const Array *b = ac.CreateArray("b", 1);
+  const Array *c = ac.CreateArray("c", 1);
+  ref<Expr> readA =
+      ReadExpr::create(UpdateList(a, 0), ConstantExpr::alloc(0, 32));
+  ref<Expr> readB =
+      ReadExpr::create(UpdateList(b, 0), ConstantExpr::alloc(0, 32));
+  ref<Expr> readC =
+      ReadExpr::create(UpdateList(c, 0), ConstantExpr::alloc(0, 32));
+  ref<Expr> three = ConstantExpr::alloc(3, Expr::Int8);
+  ref<Expr> ten = ConstantExpr::alloc(10, Expr::Int8);
+
+  ConstraintManager cm;
+  cm.addConstraint(UltExpr::create(readA, ten));
+  cm.addConstraint(UltExpr::create(readB, ten));
+  ref<ConstraintNode> first = cm.getLastNode()->parent;
+
+  // An equality rewriting no constraint leaves the list shared
+  ConstraintManager unchanged(cm);
+  unchanged.addConstraint(EqExpr::create(three, readC));
+  ASSERT_EQ(3u, unchanged.size());
+  EXPECT_EQ(cm.getLastNode().get(), unchanged.getLastNode()->parent.get());
+
+  // An equality rewriting the last constraint keeps the nodes before it
+  ConstraintManager rewritten(cm);
+  rewritten.addConstraint(EqExpr::create(three, readB));
+  ASSERT_EQ(2u, rewritten.size());
+  EXPECT_EQ(first.get(), rewritten.getLastNode()->parent.get());
+  EXPECT_EQ(UltExpr::create(readA, ten), *rewritten.begin());
+  EXPECT_EQ(2u, cm.size());
+}
+
+TEST(ConstraintsTest, CopiesExtendSharedSegments) {
+  std::srand(3);
+  ArrayCache ac;
+  ConstraintGenerator generator(ac);
+
+  for (unsigned round = 0; round < 20; ++round) {
+    generator.clear();
+
+    // Forked sets extended in turn, so that the copies extend the segments
+    // of each other in place or start their own
+    std::vector<ConstraintManager> sets(1);
+    std::vector<VectorConstraints> references(1);
+    for (unsigned i = 0; i < 60; ++i) {
+      unsigned forked = std::rand() % sets.size();
+      if (std::rand() % 3 == 0) {
+        sets.push_back(sets[forked]);
+        references.push_back(references[forked]);
+      }
+
+      unsigned extended = std::rand() % sets.size();
+      ref<Expr> constraint = generator.constraint();
+      sets[extended].addConstraint(constraint);
+      references[extended].addConstraint(constraint);
+
+      for (unsigned j = 0; j < sets.size(); ++j) {
+        ASSERT_EQ(references[j].constraints.size(), sets[j].size());
+        ASSERT_TRUE(references[j].constraints ==
+                    std::vector<ref<Expr> >(sets[j].begin(), sets[j].end()));
+      }
+    }
+  }
+}
+
+/// The constraints of a path of examples/deep_path, each on its own input,
+/// with a query on the last input and x at every depth. Compares the
+/// maintained factors with the old fixpoint; run with
+/// --gtest_also_run_disabled_tests, and --gtest_output=xml for the recorded
+/// properties.
+TEST(ConstraintsTest, DISABLED_IndependentConstraintsDeepPath) {
+  const unsigned depth = 2000;
+  ArrayCache ac;
+  const Array *input = ac.CreateArray("input", depth * 4);
+  const Array *x = ac.CreateArray("x", 4);
+  ref<Expr> xValue = ConcatExpr::create4(
+      ReadExpr::create(UpdateList(x, 0), ConstantExpr::alloc(3, Expr::Int32)),
+      ReadExpr::create(UpdateList(x, 0), ConstantExpr::alloc(2, Expr::Int32)),
+      ReadExpr::create(UpdateList(x, 0), ConstantExpr::alloc(1, Expr::Int32)),
+      ReadExpr::create(UpdateList(x, 0), ConstantExpr::alloc(0, Expr::Int32)));
+
+  std::vector<ref<Expr> > constraints;
+  std::vector<ref<Expr> > queries;
+  for (unsigned i = 0; i < depth; ++i) {
+    UpdateList ul(input, 0);
+    ref<Expr> value = ConcatExpr::create4(
+        ReadExpr::create(ul, ConstantExpr::alloc(4 * i + 3, Expr::Int32)),
+        ReadExpr::create(ul, ConstantExpr::alloc(4 * i + 2, Expr::Int32)),
+        ReadExpr::create(ul, ConstantExpr::alloc(4 * i + 1, Expr::Int32)),
+        ReadExpr::create(ul, ConstantExpr::alloc(4 * i, Expr::Int32)));
+    constraints.push_back(
+        SltExpr::create(ConstantExpr::alloc(0, Expr::Int32), value));
+    queries.push_back(EqExpr::create(AddExpr::create(value, xValue),
+                                     ConstantExpr::alloc(0, Expr::Int32)));
+  }
+
+  size_t fixpointSize = 0;
+  std::clock_t start = std::clock();
+  for (unsigned i = 0; i < depth; ++i) {
+    std::vector<ref<Expr> > prefix(constraints.begin(),
+                                   constraints.begin() + i);
+    std::vector<ref<Expr> > result;
+    getFixpointSlice(prefix, queries[i], result);
+    fixpointSize += result.size();
+  }
+  double fixpointTime = (double)(std::clock() - start) / CLOCKS_PER_SEC;
+
+  size_t factorsSize = 0;
+  start = std::clock();
+  ConstraintManager cm;
+  for (unsigned i = 0; i < depth; ++i) {
+    std::vector<ref<Expr> > result;
+    cm.getIndependentConstraints(queries[i], result);
+    factorsSize += result.size();
+    cm.addConstraint(constraints[i]);
+  }
+  double factorsTime = (double)(std::clock() - start) / CLOCKS_PER_SEC;
+
+  EXPECT_EQ(fixpointSize, factorsSize);
+  RecordProperty("Depth", depth);
+  RecordProperty("FixpointMicroseconds", (int)(fixpointTime * 1000000));
+  RecordProperty("FactorsMicroseconds", (int)(factorsTime * 1000000));
+}
+
+/// A path whose constraints all share one array, forking at every branch,
+/// so that a single factor grows while the copies share it. The path is
+/// also run without queries, which never computes the factors. Run with
+/// --gtest_also_run_disabled_tests, and --gtest_output=xml for the recorded
+/// properties.
+TEST(ConstraintsTest, DISABLED_IndependentConstraintsOneFactor) {
+  const unsigned depth = 2000;
+  ArrayCache ac;
+  const Array *input = ac.CreateArray("input", depth + 1);
+  std::vector<ref<Expr> > values;
+  for (unsigned i = 0; i <= depth; ++i)
+    values.push_back(ReadExpr::create(UpdateList(input, 0),
+                                      ConstantExpr::alloc(i, Expr::Int32)));
+
+  double times[2];
+  size_t factorsSize = 0;
+  for (unsigned queried = 0; queried < 2; ++queried) {
+    std::clock_t start = std::clock();
+    ConstraintManager cm;
+    std::vector<ConstraintManager> forks;
+    for (unsigned i = 0; i < depth; ++i) {
+      ref<Expr> branch = UleExpr::create(values[i], values[i + 1]);
+      forks.push_back(cm);
+      forks.back().addConstraint(Expr::createIsZero(branch));
+      cm.addConstraint(branch);
+
+      if (queried) {
+        std::vector<ref<Expr> > result;
+        cm.getIndependentConstraints(
+            EqExpr::create(values[i + 1], ConstantExpr::alloc(0, Expr::Int8)),
+            result);
+        factorsSize += result.size();
+      }
+    }
+    times[queried] = (double)(std::clock() - start) / CLOCKS_PER_SEC;
+  }
+
+  EXPECT_EQ((size_t)depth * (depth + 1) / 2, factorsSize);
+  RecordProperty("Depth", depth);
+  RecordProperty("UnqueriedMicroseconds", (int)(times[0] * 1000000));
+  RecordProperty("QueriedMicroseconds", (int)(times[1] * 1000000));
+}
+}
@@ -7,11 +7,14 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <ctime>
 #include <iostream>
 #include "gtest/gtest.h"
 
 #include "klee/Expr.h"
+#include "klee/Internal/System/MemoryUsage.h"
 #include "klee/util/ArrayCache.h"
+#include "klee/util/ExprVisitor.h"
 
 using namespace klee;
 
@@ -113,4 +116,184 @@ TEST(ExprTest, ExtractConcat) {
   EXPECT_EQ(Expr::Extract, concat2->getKid(1)->getKind());
 }
 
+TEST(ExprTest, HashConsing) {
+  Expr::hashConsing = true;
+  {
+    ArrayCache ac;
+    const Array *array = ac.CreateArray("arr4", 256);
+    ref<Expr> sum1 =
+        AddExpr::create(Expr::createTempRead(array, 32), getConstant(1, 32));
+    unsigned count = Expr::count;
+
+    // Building the expression again allocates no node
+    ref<Expr> sum2 =
+        AddExpr::create(Expr::createTempRead(array, 32), getConstant(1, 32));
+    EXPECT_EQ(sum1.get(), sum2.get());
+    EXPECT_EQ(count, Expr::count);
+
+    ref<Expr> sum3 =
+        AddExpr::create(Expr::createTempRead(array, 32), getConstant(2, 32));
+    EXPECT_NE(sum1.get(), sum3.get());
+    EXPECT_EQ(Expr::createTempRead(array, 32).get(),
+              Expr::createTempRead(array, 32).get());
+
+    // Every kind of expression is found before it is allocated again
+    ref<Expr> read = Expr::createTempRead(array, 8);
+    ref<Expr> bit = Expr::createTempRead(array, 1);
+    ref<Expr> exprs[] = {
+      NotOptimizedExpr::alloc(sum1),
+      SelectExpr::alloc(bit, sum1, sum3),
+      ConcatExpr::alloc(read, read),
+      ExtractExpr::alloc(sum1, 3, 8),
+      NotExpr::alloc(sum1),
+      ZExtExpr::alloc(read, 32),
+      SExtExpr::alloc(read, 32),
+      UltExpr::alloc(sum1, sum3),
+      ReadExpr::alloc(UpdateList(array, 0), sum1)
+    };
+    count = Expr::count;
+    EXPECT_EQ(exprs[0].get(), NotOptimizedExpr::alloc(sum1).get());
+    EXPECT_EQ(exprs[1].get(), SelectExpr::alloc(bit, sum1, sum3).get());
+    EXPECT_EQ(exprs[2].get(), ConcatExpr::alloc(read, read).get());
+    EXPECT_EQ(exprs[3].get(), ExtractExpr::alloc(sum1, 3, 8).get());
+    EXPECT_NE(exprs[3].get(), ExtractExpr::alloc(sum1, 4, 8).get());
+    EXPECT_EQ(exprs[4].get(), NotExpr::alloc(sum1).get());
+    EXPECT_EQ(exprs[5].get(), ZExtExpr::alloc(read, 32).get());
+    EXPECT_EQ(exprs[6].get(), SExtExpr::alloc(read, 32).get());
+    EXPECT_NE(exprs[5].get(), SExtExpr::alloc(read, 16).get());
+    EXPECT_EQ(exprs[7].get(), UltExpr::alloc(sum1, sum3).get());
+    EXPECT_EQ(exprs[8].get(),
+              ReadExpr::alloc(UpdateList(array, 0), sum1).get());
+    EXPECT_EQ(count, Expr::count);
+
+    // Distinct unique expressions are ordered consistently with the
+    // structurally equal expressions that are not unique
+    EXPECT_EQ(0, sum1->compare(*sum2));
+    int order = sum1->compare(*sum3);
+    EXPECT_NE(0, order);
+    EXPECT_EQ(-order, sum3->compare(*sum1));
+
+    Expr::hashConsing = false;
+    ref<Expr> copy3 =
+        AddExpr::create(Expr::createTempRead(array, 32), getConstant(2, 32));
+    Expr::hashConsing = true;
+    EXPECT_FALSE(copy3->isUnique);
+    EXPECT_EQ(0, sum3->compare(*copy3));
+    EXPECT_EQ(order, sum1->compare(*copy3));
+    EXPECT_EQ(-order, copy3->compare(*sum1));
+  }
+  // The released expressions are removed from the table
+  EXPECT_EQ(0U, Expr::uniqueCount);
+  Expr::hashConsing = false;
+}
+
+/// Rebuilds an expression on the shadow arrays, as the interpolants are
+/// built by TxShadowArray::getShadowExpression.
+class ShadowVisitor : public ExprVisitor {
+  const Array *array, *shadow;
+
+public:
+  ShadowVisitor(const Array *_array, const Array *_shadow)
+      : array(_array), shadow(_shadow) {}
+
+  Action visitRead(const ReadExpr &re) {
+    if (re.updates.root != array)
+      return Action::doChildren();
+    return Action::changeTo(
+        ReadExpr::create(UpdateList(shadow, 0), visit(re.index)));
+  }
+};
+
+/// Replaces a subexpression, as the interpolants are specialized by
+/// TxTree::replaceExpr.
+class ReplaceVisitor : public ExprVisitor {
+  ref<Expr> src, dst;
+
+public:
+  ReplaceVisitor(ref<Expr> _src, ref<Expr> _dst) : src(_src), dst(_dst) {}
+
+  Action visitExpr(const Expr &e) {
+    if (e == *src.get())
+      return Action::changeTo(dst);
+    return Action::doChildren();
+  }
+};
+
+/// Builds an interpolant at every node of a path, each the conjunction of
+/// the constraints of the path so far on the shadow arrays, and each with x
+/// replaced by a constant. Returns the number of nodes allocated to keep
+/// the interpolants, and sets the time taken, the heap memory taken by the
+/// interpolants, and the size of the hash-consing table.
+unsigned buildInterpolants(ArrayCache &ac, unsigned depth, double &time,
+                           size_t &memory, unsigned &unique) {
+  const Array *array = ac.CreateArray("path", depth);
+  const Array *shadow = ac.CreateArray("path_shadow", depth);
+  const Array *x = ac.CreateArray("x", 4);
+  ref<Expr> xValue = Expr::createTempRead(x, 32);
+
+  std::vector<ref<Expr> > constraints;
+  for (unsigned i = 0; i < depth; ++i) {
+    ref<Expr> element =
+        ZExtExpr::create(ReadExpr::create(UpdateList(array, 0),
+                                          getConstant(i, 32)),
+                         32);
+    constraints.push_back(
+        SltExpr::create(getConstant(0, 32), AddExpr::create(element, xValue)));
+  }
+
+  unsigned count = Expr::count;
+  size_t usage = util::GetTotalMallocUsage();
+  std::clock_t start = std::clock();
+  std::vector<ref<Expr> > interpolants;
+  for (unsigned i = 0; i < depth; ++i) {
+    ref<Expr> interpolant = ConstantExpr::alloc(1, Expr::Bool);
+    for (unsigned j = 0; j <= i; ++j) {
+      ShadowVisitor shadowVisitor(array, shadow);
+      interpolant =
+          AndExpr::create(interpolant, shadowVisitor.visit(constraints[j]));
+    }
+    interpolants.push_back(interpolant);
+
+    ReplaceVisitor replaceVisitor(xValue, getConstant(i % 4, 32));
+    interpolants.push_back(replaceVisitor.visit(interpolant));
+  }
+  time = (double)(std::clock() - start) / CLOCKS_PER_SEC;
+  memory = util::GetTotalMallocUsage() - usage;
+  unique = Expr::uniqueCount;
+  return Expr::count - count;
+}
+
+TEST(ExprTest, HashConsingInterpolants) {
+  const unsigned depth = 100;
+  double time, hashConsingTime;
+  size_t memory, hashConsingMemory;
+  unsigned allocated, hashConsingAllocated, unique;
+  {
+    ArrayCache ac;
+    allocated = buildInterpolants(ac, depth, time, memory, unique);
+  }
+
+  Expr::hashConsing = true;
+  {
+    ArrayCache ac;
+    hashConsingAllocated = buildInterpolants(ac, depth, hashConsingTime,
+                                             hashConsingMemory, unique);
+  }
+  Expr::hashConsing = false;
+
+  // Without hash-consing, the shadow and replaced expressions are
+  // allocated again for every interpolant
+  EXPECT_LT(hashConsingAllocated * 10, allocated);
+  EXPECT_LE(hashConsingAllocated, unique);
+  EXPECT_EQ(0U, Expr::uniqueCount);
+  EXPECT_LT(hashConsingMemory, memory);
+
+  RecordProperty("AllocatedExprs", allocated);
+  RecordProperty("HashConsedAllocatedExprs", hashConsingAllocated);
+  RecordProperty("Microseconds", (int)(time * 1000000));
+  RecordProperty("HashConsedMicroseconds", (int)(hashConsingTime * 1000000));
+  RecordProperty("Bytes", (int)memory);
+  RecordProperty("HashConsedBytes", (int)hashConsingMemory);
+}
+
 }
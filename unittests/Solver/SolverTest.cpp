@@ -166,4 +166,53 @@ TEST(SolverTest, Evaluation) {
   delete solver;
 }
 
+#ifdef ENABLE_Z3
+// The construct cache of the Z3 builder persists across queries. A read of a
+// shadow array is a free array outside of an existential quantification, and
+// a bound variable inside, so its translation outside is not to be used
+// inside, nor the other way around.
+TEST(SolverTest, Z3ShadowArrayTranslation) {
+  Z3Solver solver(/*keepConstructCache=*/true);
+
+  const Array *state = ac.CreateArray("state", 1);
+  const Array *shadow = ac.CreateArray("__shadow__state", 1);
+  ref<Expr> stateRead =
+      ReadExpr::create(UpdateList(state, 0), ConstantExpr::alloc(0, 32));
+  ref<Expr> shadowRead =
+      ReadExpr::create(UpdateList(shadow, 0), ConstantExpr::alloc(0, 32));
+  ref<Expr> five = ConstantExpr::alloc(5, Expr::Int8);
+
+  std::set<const Array *> existentials;
+  existentials.insert(shadow);
+  ref<Expr> exists =
+      ExistsExpr::create(existentials, EqExpr::create(shadowRead, stateRead));
+
+  std::vector<ref<Expr> > constraints;
+  constraints.push_back(EqExpr::create(stateRead, five));
+  ConstraintManager cm(constraints);
+
+  Solver::Validity result;
+  std::vector<ref<Expr> > unsatCore;
+
+  // The shadow array is free: its value is not known
+  ASSERT_TRUE(solver.directComputeValidity(
+      Query(cm, EqExpr::create(shadowRead, five)), result, unsatCore));
+  EXPECT_EQ(Solver::Unknown, result);
+
+  // The shadow array is bound: there is a value equal to that of the state
+  ASSERT_TRUE(solver.directComputeValidity(Query(cm, exists), result,
+                                           unsatCore));
+  EXPECT_EQ(Solver::True, result);
+
+  // The shadow array is free again
+  ASSERT_TRUE(solver.directComputeValidity(
+      Query(cm, EqExpr::create(shadowRead, stateRead)), result, unsatCore));
+  EXPECT_EQ(Solver::Unknown, result);
+
+  ASSERT_TRUE(solver.directComputeValidity(Query(cm, exists), result,
+                                           unsatCore));
+  EXPECT_EQ(Solver::True, result);
+}
+#endif
+
 }
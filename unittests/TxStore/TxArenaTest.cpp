@@ -0,0 +1,55 @@
+//===-- TxArenaTest.cpp -----------------------------------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Tests of the release of the chunks of an arena once their blocks are all
+/// freed.
+///
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "TxPathCondition.h"
+
+#include "klee/Internal/Module/TxArena.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+TEST(TxArenaTest, ReleasesFreedChunks) {
+  TxArena &arena = TxArena::get(TxArena::PCConstraint);
+  const size_t size = sizeof(TxPCConstraint);
+  uint64_t before = arena.getChunkBytes();
+
+  std::vector<void *> blocks;
+  for (unsigned i = 0; i < 10000; ++i)
+    blocks.push_back(arena.allocate(size));
+  uint64_t grown = arena.getChunkBytes() - before;
+  EXPECT_LE(10000 * size, grown);
+
+  // Freeing every other block releases no chunk
+  for (unsigned i = 0; i < blocks.size(); i += 2)
+    arena.deallocate(blocks[i], size);
+  EXPECT_EQ(before + grown, arena.getChunkBytes());
+
+  // The freed blocks are allocated again before a new chunk is
+  for (unsigned i = 0; i < blocks.size(); i += 2)
+    blocks[i] = arena.allocate(size);
+  EXPECT_EQ(before + grown, arena.getChunkBytes());
+
+  // Once all blocks are freed, at most one empty chunk is kept
+  for (unsigned i = 0; i < blocks.size(); ++i)
+    arena.deallocate(blocks[i], size);
+  EXPECT_LT((arena.getChunkBytes() - before) * 20, grown);
+  EXPECT_EQ(0u, arena.getLiveBytes());
+}
+}
@@ -0,0 +1,235 @@
+//===-- TxStoreTest.cpp -----------------------------------------*- C++ -*-===//
+//
+//               The Tracer-X KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Tests of the sharing of the persistent maps of TxStore between a parent
+/// store and the child stores created from it, and a disabled split-cost
+/// benchmark. The allocations are global variables of a module built by the
+/// test.
+///
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Context.h"
+#include "TxStore.h"
+
+#include "klee/Config/Version.h"
+#include "klee/Expr.h"
+#include "klee/Internal/Module/TxValues.h"
+#include "klee/Internal/System/Time.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Type.h"
+#else
+#include "llvm/Constants.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Type.h"
+#endif
+
+#include <map>
+#include <sstream>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// \brief Number of variables per allocation
+const unsigned VariablesPerAllocation = 16;
+
+/// \brief The size of a variable, in bytes
+const unsigned VariableSize = 4;
+
+class TxStoreTest : public ::testing::Test {
+protected:
+  llvm::LLVMContext context;
+
+  llvm::Module *module;
+
+  /// \brief The loaded value of all the stored values
+  llvm::Value *loadedValue;
+
+  std::vector<llvm::GlobalVariable *> allocations;
+
+  std::map<llvm::Value *, std::vector<ref<TxStateValue> > > valuesMap;
+
+  TxStoreTest() : module(new llvm::Module("TxStoreTest", context)) {
+    loadedValue = llvm::ConstantInt::get(llvm::Type::getInt32Ty(context), 0);
+  }
+
+  /// \brief The addresses are built with Expr::createPointer
+  static void SetUpTestCase() { Context::initialize(true, Expr::Int64); }
+
+  ~TxStoreTest() { delete module; }
+
+  llvm::GlobalVariable *getAllocation(unsigned allocation) {
+    while (allocations.size() <= allocation) {
+      llvm::Type *type = llvm::ArrayType::get(
+          llvm::Type::getInt32Ty(context), VariablesPerAllocation);
+      allocations.push_back(new llvm::GlobalVariable(
+          *module, type, false, llvm::GlobalValue::ExternalLinkage, 0,
+          "allocation"));
+    }
+    return allocations[allocation];
+  }
+
+  /// \brief The address of a variable of an allocation
+  ref<TxStateAddress> getLocation(unsigned allocation, unsigned variable) {
+    uint64_t base = 0x10000 * (allocation + 1);
+    ref<Expr> baseAddress = Expr::createPointer(base);
+    ref<TxStateAddress> loc = TxStateAddress::create(
+        getAllocation(allocation), TxCallHistory::getEmpty(), baseAddress,
+        VariablesPerAllocation * VariableSize);
+    ref<Expr> address = Expr::createPointer(base + variable * VariableSize);
+    ref<Expr> offset = Expr::createPointer(variable * VariableSize);
+    return TxStateAddress::create(loc, address, offset);
+  }
+
+  void update(TxStore *store, unsigned allocation, unsigned variable,
+              unsigned value) {
+    ref<TxStateAddress> loc = getLocation(allocation, variable);
+    ref<TxStateValue> address = TxStateValue::create(
+        store->getDepth(), getAllocation(allocation), TxCallHistory::getEmpty(),
+        loc->getAddress());
+    ref<TxStateValue> content =
+        TxStateValue::create(store->getDepth(), loadedValue,
+                             TxCallHistory::getEmpty(),
+                             ConstantExpr::create(value, Expr::Int32));
+    store->updateStore(valuesMap, loc, address, content);
+  }
+
+  /// \brief The stored value of a variable, or -1 if none
+  int64_t lookup(TxStore *store, unsigned allocation, unsigned variable) {
+    ref<TxStoreEntry> entry = store->find(getLocation(allocation, variable));
+    if (entry.isNull())
+      return -1;
+    ConstantExpr *ce =
+        llvm::dyn_cast<ConstantExpr>(entry->getContent()->getExpression());
+    return ce ? (int64_t)ce->getZExtValue() : -1;
+  }
+
+  TxStore *buildStore(unsigned size) {
+    TxStore *store = TxStore::create(0);
+    for (unsigned a = 0; a < size / VariablesPerAllocation; ++a) {
+      for (unsigned v = 0; v < VariablesPerAllocation; ++v)
+        update(store, a, v, a + v);
+    }
+    return store;
+  }
+};
+
+TEST_F(TxStoreTest, CreateSharesParent) {
+  TxStore *parent = buildStore(256);
+
+  size_t topBefore = TxStore::TopStateStore::getAllocated();
+  size_t lowerBefore = TxStore::LowerStateStore::getAllocated();
+  TxStore *child = TxStore::create(parent);
+  EXPECT_EQ(topBefore, TxStore::TopStateStore::getAllocated());
+  EXPECT_EQ(lowerBefore, TxStore::LowerStateStore::getAllocated());
+
+  EXPECT_EQ(parent->getDepth() + 1, child->getDepth());
+  EXPECT_EQ(parent->getContextSignature(), child->getContextSignature());
+
+  // All the entries are the same objects in both stores
+  for (unsigned a = 0; a < 256 / VariablesPerAllocation; ++a) {
+    for (unsigned v = 0; v < VariablesPerAllocation; ++v) {
+      ref<TxStateAddress> loc = getLocation(a, v);
+      EXPECT_EQ(parent->find(loc).get(), child->find(loc).get());
+    }
+  }
+
+  delete child;
+  delete parent;
+}
+
+TEST_F(TxStoreTest, ChildUpdateLeavesParent) {
+  TxStore *parent = buildStore(256);
+  TxStore *child = TxStore::create(parent);
+
+  ref<TxStoreEntry> sibling = parent->find(getLocation(3, 4));
+  ref<TxStoreEntry> other = parent->find(getLocation(7, 5));
+
+  size_t topBefore = TxStore::TopStateStore::getAllocated();
+  size_t lowerBefore = TxStore::LowerStateStore::getAllocated();
+  update(child, 3, 5, 1000);
+
+  // An update only copies the paths to the updated entries
+  EXPECT_GE(32u, TxStore::TopStateStore::getAllocated() - topBefore);
+  EXPECT_GE(32u, TxStore::LowerStateStore::getAllocated() - lowerBefore);
+
+  // The update is only visible in the child
+  EXPECT_EQ(3 + 5, lookup(parent, 3, 5));
+  EXPECT_EQ(1000, lookup(child, 3, 5));
+
+  // The other entries are still shared
+  EXPECT_EQ(sibling.get(), child->find(getLocation(3, 4)).get());
+  EXPECT_EQ(other.get(), child->find(getLocation(7, 5)).get());
+
+  // A variable of a new allocation is only stored in the child
+  update(child, 100, 0, 2000);
+  EXPECT_EQ(-1, lookup(parent, 100, 0));
+  EXPECT_EQ(2000, lookup(child, 100, 0));
+
+  delete child;
+  delete parent;
+}
+
+TEST_F(TxStoreTest, SiblingsAreIndependent) {
+  TxStore *parent = buildStore(64);
+  TxStore *left = TxStore::create(parent);
+  TxStore *right = TxStore::create(parent);
+  parent->setLeftChild(left);
+  parent->setRightChild(right);
+
+  update(left, 1, 2, 1000);
+  update(right, 1, 2, 2000);
+
+  EXPECT_EQ(1 + 2, lookup(parent, 1, 2));
+  EXPECT_EQ(1000, lookup(left, 1, 2));
+  EXPECT_EQ(2000, lookup(right, 1, 2));
+
+  delete right;
+  delete left;
+  delete parent;
+}
+
+/// \brief Records the cost of TxStore::create followed by a single store
+/// update, as done by TxTreeNode::split and the first store of the new node,
+/// against the number of store entries. Run with
+/// --gtest_also_run_disabled_tests, and --gtest_output=xml for the recorded
+/// properties.
+TEST_F(TxStoreTest, DISABLED_SplitCostBenchmark) {
+  const unsigned splits = 256;
+
+  for (unsigned size = 256; size <= 65536; size *= 4) {
+    unsigned allocationCount = size / VariablesPerAllocation;
+    TxStore *parent = buildStore(size);
+
+    double start = util::getUserTime();
+    for (unsigned i = 0; i < splits; ++i) {
+      TxStore *child = TxStore::create(parent);
+      update(child, i % allocationCount, i % VariablesPerAllocation, i);
+      delete child;
+    }
+    double time = util::getUserTime() - start;
+
+    std::ostringstream key;
+    key << "Microseconds" << size << "Entries";
+    RecordProperty(key.str(), (int)(time * 1000000));
+    delete parent;
+  }
+}
+}